@@ -41,6 +41,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <memory>
 #include <vector>
 
 using namespace config;
@@ -135,6 +136,15 @@ void AddA2DVariableComboDialog::accept()
                   Calib6Text->text().toStdString() + "\n";
 
    try {
+      // Taking the variable out and adding it back is one edit: one undo
+      // step, and if the add fails the variable is put back.
+      std::unique_ptr<EditJournal::Transaction> tx;
+      if (_document) {
+         tx.reset(new EditJournal::Transaction(_document->getJournal(),
+                  editMode ? "Edit A2D Variable" : "Add A2D Variable"));
+         tx->touch(_model->getCurrentRootItem());
+      }
+
       // If we're in edit mode, we need to delete the A2DVariableItem
       // from the model first and then we can add it back in.
       if (editMode)  {
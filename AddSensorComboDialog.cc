@@ -34,7 +34,8 @@
 #include "exceptions/InternalProcessingException.h"
 #include <nidas/util/InvalidParameterException.h>
 #include "DeviceValidator.h"
-#include <dirent.h>
+#include "CalFileCatalog.h"
+#include <QFileInfo>
 #include <set>
 #include <sys/stat.h>
 #include <sstream>
@@ -51,7 +52,7 @@ QRegExp _idRegEx("\\d+");
 
 AddSensorComboDialog::AddSensorComboDialog(QString a2dCalDir,
                                   QString pmsSpecsFile, QWidget *parent):
-    QDialog(parent)
+    QDialog(parent), _document(0)
 {
   setupUi(this);
   connect(SensorBox, SIGNAL(currentIndexChanged(const QString &)), this,
@@ -62,6 +63,15 @@ AddSensorComboDialog::AddSensorComboDialog(QString a2dCalDir,
 
   IdText->setValidator( new QRegExpValidator ( _idRegEx, this));
 
+  // keep the serial number list current as cal files come and go
+  _a2dCalWatcher = new CalDirWatcher(this);
+  connect(_a2dCalWatcher, SIGNAL(fileAdded(const QString &)), this,
+           SLOT(a2dCalFileAdded(const QString &)));
+  connect(_a2dCalWatcher, SIGNAL(fileRemoved(const QString &)), this,
+           SLOT(a2dCalFileRemoved(const QString &)));
+  connect(_a2dCalWatcher, SIGNAL(directoryStale(const QString &)), this,
+           SLOT(a2dCalDirStale(const QString &)));
+
   setupA2DSerNums(a2dCalDir+"/DMMAT/");
   setupA2DSerNums(a2dCalDir);
 
@@ -126,39 +136,65 @@ void AddSensorComboDialog::setupA2DSerNums(QString a2dCalDir)
 {
 
   // Get listing of A2D calibration files to allow selection by  user
-  DIR *dir;
-  char *tmp_dir = (char*) malloc(a2dCalDir.size()+1);
-
-  strcpy(tmp_dir, a2dCalDir.toStdString().c_str());
-  //char *directory = dirname(tmp_dir);
-
-  if ((dir = opendir(tmp_dir)) == 0)
+  CalFileCatalog a2dCalFiles;
+  if (!a2dCalFiles.scan(a2dCalDir.toStdString(), "A2D"))
   {
     QMessageBox *errorMessage = new QMessageBox(this);
     errorMessage->setText("Could not open A2D calibrations directory: " +
                           a2dCalDir +
                           "\n Can't provide serial numbers for A2D Cards.");
     errorMessage->exec();
-    free(tmp_dir);
     return;
   }
 
-  struct dirent *entry;
-
-  // Read directory entries and get files with matching A2D cal file form
-  QStringList a2dCalFiles;
-  while ( (entry = readdir(dir)) )
-    if ( strstr(entry->d_name, "A2D") &&
-         strstr(entry->d_name, ".dat"))
-    {
-      a2dCalFiles << QString(entry->d_name);
-      //A2DSNBox->addItem(QString(entry->d_name));
-      //cerr<<"found A2D cal file "<< entry->d_name << "\n";
-    }
-  a2dCalFiles.sort();
-  A2DSNBox->addItems(a2dCalFiles);
+  const vector<std::string> & names = a2dCalFiles.getFileNames();
+  for (size_t i = 0; i < names.size(); i++)
+    A2DSNBox->addItem(QString::fromStdString(names[i]));
+
+  _a2dCalDirs << a2dCalDir;
+  _a2dCalWatcher->addDirectory(a2dCalDir);
+}
 
-  free(tmp_dir);
+bool AddSensorComboDialog::isA2DCalFile(const QString & fileName)
+{
+  return fileName.contains("A2D") && fileName.contains(".dat");
+}
+
+void AddSensorComboDialog::a2dCalFileAdded(const QString & path)
+{
+  QString fileName = QFileInfo(path).fileName();
+  if (!isA2DCalFile(fileName) || A2DSNBox->findText(fileName) >= 0) return;
+
+  int i = 0;
+  while (i < A2DSNBox->count() && A2DSNBox->itemText(i) < fileName) i++;
+  A2DSNBox->insertItem(i, fileName);
+}
+
+void AddSensorComboDialog::a2dCalFileRemoved(const QString & path)
+{
+  int i = A2DSNBox->findText(QFileInfo(path).fileName());
+  if (i >= 0) A2DSNBox->removeItem(i);
+}
+
+/**
+ * The watcher missed changes to one of the A2D cal dirs, so list them
+ * all again, keeping the serial number that was selected.
+ */
+void AddSensorComboDialog::a2dCalDirStale(const QString & dir)
+{
+  QString selected = A2DSNBox->currentText();
+  A2DSNBox->clear();
+
+  for (int d = 0; d < _a2dCalDirs.size(); d++) {
+    CalFileCatalog a2dCalFiles;
+    if (!a2dCalFiles.scan(_a2dCalDirs[d].toStdString(), "A2D")) continue;
+    const vector<std::string> & names = a2dCalFiles.getFileNames();
+    for (size_t i = 0; i < names.size(); i++)
+      A2DSNBox->addItem(QString::fromStdString(names[i]));
+  }
+
+  int i = A2DSNBox->findText(selected);
+  if (i >= 0) A2DSNBox->setCurrentIndex(i);
 }
 
 void AddSensorComboDialog::dialogSetup(const QString & sensor)
@@ -351,14 +387,23 @@ void AddSensorComboDialog::newSensor(QString sensor)
    if (ChannelBox->value() == min) setDevice(min);
    ChannelBox->setValue(min);
 
+   // suffix and device name defaults come from the sensor catalog
+   std::string sSuffix, sDevice;
+   const SensorCatalogIndex::Entry * catEntry = 0;
+   if (_document)
+     catEntry = _document->getSensorCatalogIndex().find(stdSensor);
+   if (catEntry) {
+     sSuffix = catEntry->suffix;
+     sDevice = catEntry->deviceName;
+   }
+
    SuffixText->clear();
-   SuffixText->insert(_sfxMap[sensor]);
-   if (_devMap[sensor].size()) {
+   SuffixText->insert(QString::fromStdString(sSuffix));
+   if (sDevice.size()) {
      DeviceText->clear();
-     DeviceText->setText(_devMap[sensor]);
+     DeviceText->setText(QString::fromStdString(sDevice));
 
      // Find the beginning of the port or device number
-     std::string sDevice = _devMap[sensor].toStdString();
      size_t numStart = sDevice.find_first_of("0123456789");
      if (numStart != std::string::npos) {
        std::string sDevNum = sDevice.substr(numStart);
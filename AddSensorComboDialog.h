@@ -31,6 +31,7 @@
 #include <map>
 #include <QMessageBox>
 #include "Document.h"
+#include "CalDirWatcher.h"
 #include <raf/PMSspex.h>
 
 namespace config
@@ -57,6 +58,11 @@ public slots:
     bool setUpDialog();
     void dialogSetup(const QString & sensor);
 
+        // A2D cal files appearing in or leaving the A2D cal dirs
+    void a2dCalFileAdded(const QString & path);
+    void a2dCalFileRemoved(const QString & path);
+    void a2dCalDirStale(const QString & dir);
+
 public:
 
     //AddSensorComboDialog(QWidget * parent = 0);
@@ -65,10 +71,6 @@ public:
     ~AddSensorComboDialog() {}
 
     void setDocument(Document * document) {_document = document;}
-    void clearSfxMap() {_sfxMap.clear();}
-    void addSensorSfx(QString sensor, QString sfx) {_sfxMap[sensor]=sfx;}
-    void clearDevMap() {_devMap.clear();}
-    void addSensorDev(QString sensor, QString dev) {_devMap[sensor]=dev;}
 
 protected:
 
@@ -79,10 +81,11 @@ private:
     void setupPMSSerNums(QString pmsSpecsFile);
     std::map<std::string, std::string> _pmsResltn;  // for RESOLUTION indicator
     void setupA2DSerNums(QString a2dCalDir);
+    static bool isA2DCalFile(const QString & fileName);
+    CalDirWatcher * _a2dCalWatcher;
+    QStringList _a2dCalDirs;
     QModelIndexList _indexList;
     NidasModel* _model;
-    map<QString, QString> _sfxMap;
-    map<QString, QString> _devMap;
 };
 
 }
@@ -0,0 +1,506 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+/*
+ * This file is part of configedit:
+ * A Qt based application that allows visualization of a nidas/nimbus
+ * configuration (e.g. default.xml) file.
+ */
+
+#include "BatchEditor.h"
+#include "exceptions/InternalProcessingException.h"
+#include "Profiler.h"
+#include <nidas/util/InvalidParameterException.h>
+
+#include <xercesc/util/PlatformUtils.hpp>
+
+#include <QUndoStack>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+using namespace xercesc;
+using namespace nidas::core;
+namespace n_u = nidas::util;
+
+
+
+BatchEditor::BatchEditor() :
+    _doc(0), _model(0),
+    // Directory paths are relative to $PROJ_DIR
+    _engCalDirRoot("/Configuration/cal_files/Engineering/")
+{
+    XMLPlatformUtils::Initialize(); //xercesc class
+
+    char * tmpStr = getenv("PROJ_DIR");
+    if (tmpStr)
+       _projDir.append(tmpStr);
+    else {
+       cerr << "No $PROJ_DIR Environment Variable Defined.\n"
+            << "Proceeding using current working directory.\n";
+       tmpStr = getenv("PWD");
+       if (tmpStr) _projDir.append(tmpStr);
+    }
+}
+
+BatchEditor::~BatchEditor()
+{
+    delete _model;
+    delete _doc;
+    XMLPlatformUtils::Terminate();
+}
+
+int BatchEditor::run(const std::string & scriptFile)
+{
+    ifstream script(scriptFile.c_str());
+    if (!script) {
+        cerr << "Could not open batch script: " << scriptFile << "\n";
+        return 1;
+    }
+
+    std::string line;
+    int lineNum = 0;
+    while (getline(script, line)) {
+        lineNum++;
+        vector<std::string> args = tokenize(line);
+        if (args.empty()) continue;
+
+        try {
+            execute(args);
+        }
+        catch (const n_u::Exception & e) {
+            cerr << scriptFile << ":" << lineNum << ": " << e.toString()
+                 << "\n";
+            return 1;
+        }
+        catch (const std::exception & e) {
+            cerr << scriptFile << ":" << lineNum << ": " << e.what() << "\n";
+            return 1;
+        }
+        catch (...) {
+            cerr << scriptFile << ":" << lineNum
+                 << ": Caught Unspecified error\n";
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*!
+ * \brief Split a script line into arguments.
+ *
+ * White space separates arguments except within double quotes, and
+ * a '#' outside of quotes starts a comment.
+ */
+vector<std::string> BatchEditor::tokenize(const std::string & line)
+{
+    vector<std::string> args;
+    std::string arg;
+    bool inQuote = false;
+    bool haveArg = false;
+
+    for (size_t i = 0; i < line.size(); i++) {
+        char c = line[i];
+        if (c == '"') {
+            inQuote = !inQuote;
+            haveArg = true;
+        } else if (!inQuote && c == '#') {
+            break;
+        } else if (!inQuote && isspace(c)) {
+            if (haveArg) args.push_back(arg);
+            arg.clear();
+            haveArg = false;
+        } else {
+            arg += c;
+            haveArg = true;
+        }
+    }
+    if (haveArg) args.push_back(arg);
+
+    return args;
+}
+
+/*!
+ * \brief Convert the script's short voltage range names into the strings
+ *        used by Document (and the AddA2DVariableComboDialog).
+ */
+std::string BatchEditor::a2dVoltsString(const std::string & volts)
+{
+    if (volts == "0to5")    return "  0 to  5 Volts";
+    if (volts == "0to10")   return "  0 to 10 Volts";
+    if (volts == "-5to5")   return " -5 to  5 Volts";
+    if (volts == "-10to10") return "-10 to 10 Volts";
+    throw n_u::InvalidParameterException("a2d variable", "volts", volts);
+}
+
+void BatchEditor::requireArgs(const vector<std::string> & args, size_t nargs,
+                              const std::string & usage)
+{
+    if (args.size() < nargs)
+        throw n_u::InvalidParameterException(args[0], "usage", usage);
+    if (!_doc && args[0] != "open")
+        throw InternalProcessingException(args[0] +
+                                          ": no configuration file open");
+}
+
+std::string BatchEditor::option(const std::string & key,
+                                const std::string & dflt)
+{
+    map<std::string, std::string>::const_iterator mi = _options.find(key);
+    if (mi == _options.end()) return dflt;
+    return mi->second;
+}
+
+void BatchEditor::execute(const vector<std::string> & tokens)
+{
+    // Separate the positional arguments from the key=value options
+    vector<std::string> args;
+    _options.clear();
+    for (size_t i = 0; i < tokens.size(); i++) {
+        size_t eq = tokens[i].find('=');
+        if (i > 0 && eq != std::string::npos && eq > 0)
+            _options[tokens[i].substr(0, eq)] = tokens[i].substr(eq+1);
+        else
+            args.push_back(tokens[i]);
+    }
+
+    const std::string & cmd = args[0];
+
+    if (cmd == "open") {
+        requireArgs(args, 2, "open <file.xml>");
+        openFile(args[1]);
+    }
+    else if (cmd == "save") {
+        requireArgs(args, 1, "save [file.xml]");
+        saveFile(args.size() > 1 ? args[1] : std::string());
+    }
+    else if (cmd == "project") {
+        requireArgs(args, 2, "project <name>");
+        _doc->setProjectName(args[1]);
+        _doc->setIsChanged(true);
+    }
+    else if (cmd == "add-dsm") {
+        requireArgs(args, 4, "add-dsm <site> <dsmName> <id> [location=]");
+        _doc->addDSM(findSite(args[1]), args[2], args[3],
+                     option("location"));
+        _doc->setIsChanged(true);
+    }
+    else if (cmd == "update-dsm") {
+        requireArgs(args, 2,
+                    "update-dsm <dsmName> [name=] [id=] [location=]");
+        DSMItem * dsmItem = findDSM(args[1]);
+        DSMConfig * dsm = dsmItem->getDSMConfig();
+        ostringstream ost;
+        ost << dsm->getId();
+        _doc->updateDSM(dsmItem, option("name", dsm->getName()),
+                        option("id", ost.str()),
+                        option("location", dsm->getLocation()));
+        _doc->setIsChanged(true);
+    }
+    else if (cmd == "delete-dsm") {
+        requireArgs(args, 2, "delete-dsm <dsmName>");
+        _doc->removeItem(findDSM(args[1]));
+    }
+    else if (cmd == "add-sensor") {
+        requireArgs(args, 5, "add-sensor <dsmName> <catalogName> <device>"
+                             " <id> [suffix=] [a2dtempsfx=] [a2dcal=]"
+                             " [pmssn=] [resolution=]");
+        DSMItem * dsmItem = findDSM(args[1]);
+
+        // Same clean up of the suffixes that AddSensorComboDialog does -
+        //   one and exactly one underscore at the beginning
+        std::string sfx = option("suffix");
+        std::string a2dTempSfx = option("a2dtempsfx");
+        if (sfx.size()) {
+            sfx.erase(std::remove(sfx.begin(), sfx.end(), '_'), sfx.end());
+            sfx.insert(0, "_");
+        }
+        if (a2dTempSfx.size()) {
+            a2dTempSfx.erase(std::remove(a2dTempSfx.begin(),
+                                         a2dTempSfx.end(), '_'),
+                             a2dTempSfx.end());
+            a2dTempSfx.insert(0, "_");
+        }
+        if (args[2] == "ANALOG_NCAR" && a2dTempSfx.empty())
+            throw n_u::InvalidParameterException(args[2], "a2dtempsfx",
+                    "A2D Temp Suffix must be set for an ANALOG_NCAR sensor");
+
+        _doc->addSensor(dsmItem, args[2], args[3], args[4], sfx, a2dTempSfx,
+                        option("a2dcal"), option("pmssn"),
+                        option("resolution"));
+        _doc->setIsChanged(true);
+    }
+    else if (cmd == "delete-sensor") {
+        requireArgs(args, 3, "delete-sensor <dsmName> <sensorId>");
+        _doc->removeItem(findSensor(findDSM(args[1]), args[2]));
+    }
+    else if (cmd == "add-a2dvar") {
+        requireArgs(args, 7, "add-a2dvar <dsmName> <sensorId> <varPrefix>"
+                             " <channel> <rate> <volts> [suffix=]"
+                             " [longname=] [units=]");
+        SensorItem * sensorItem = findSensor(findDSM(args[1]), args[2]);
+
+        // AddA2DVariableComboDialog always hands over six calibration
+        // coefficients, empty ones included
+        vector<std::string> cals(6);
+        _doc->addA2DVariable(sensorItem, args[3], option("suffix"), option("longname"),
+                             a2dVoltsString(args[6]), args[4], args[5],
+                             option("units", "V"), cals);
+        _doc->setIsChanged(true);
+    }
+    else if (cmd == "update-var") {
+        requireArgs(args, 4, "update-var <dsmName> <sensorId> <varName>"
+                             " [longname=] [units=] [rate=] [calfile=yes|no]"
+                             " [cals=c0,c1,...]");
+        SensorItem * sensorItem = findSensor(findDSM(args[1]), args[2]);
+        VariableItem * varItem =
+                dynamic_cast<VariableItem*>(findVariable(sensorItem, args[3]));
+        if (!varItem)
+            throw InternalProcessingException(args[3] +
+                         " is an analog variable - use add/delete-a2dvar");
+
+        // Default to whatever the variable has now, as VariableComboDialog
+        QString calSrc = varItem->getCalSrc();
+        std::string dfltCalfile =
+                (calSrc != "XML" && calSrc != "N/A") ? "yes" : "no";
+        bool useCalfile = (option("calfile", dfltCalfile) == "yes");
+
+        vector<std::string> calInfo = varItem->getCalibrationInfo();
+        std::string dfltUnits = varItem->getVariable()->getUnits();
+        if (calInfo.size() > 2 && calInfo.back().size())
+            dfltUnits = calInfo.back();
+
+        vector<std::string> cals;
+        if (!useCalfile) {
+            std::string calStr = option("cals");
+            if (calStr.size()) {
+                istringstream ist(calStr);
+                std::string cal;
+                while (getline(ist, cal, ',')) cals.push_back(cal);
+            } else if (calSrc == "XML" && calInfo.size() > 2) {
+                cals = calInfo;
+                cals.pop_back();   // units
+            }
+            cals.resize(6);
+        }
+
+        ostringstream ost;
+        ost << varItem->getRate();
+        _doc->updateVariable(varItem, varItem->getBaseName(),
+                             option("longname",
+                                    varItem->getLongName().toStdString()),
+                             option("rate", ost.str()),
+                             option("units", dfltUnits),
+                             cals, useCalfile);
+        _doc->setIsChanged(true);
+    }
+    else if (cmd == "delete-a2dvar") {
+        requireArgs(args, 4, "delete-a2dvar <dsmName> <sensorId> <varName>");
+        SensorItem * sensorItem = findSensor(findDSM(args[1]), args[2]);
+        NidasItem * varItem = findVariable(sensorItem, args[3]);
+        if (dynamic_cast<VariableItem*>(varItem))
+            throw InternalProcessingException(args[3] +
+                                              " is not an analog variable");
+        _doc->removeItem(varItem);
+    }
+    else if (cmd == "set-a2drate") {
+        requireArgs(args, 5, "set-a2drate <dsmName> <sensorId> <rate>"
+                             " <varName> [<varName>...]");
+        SensorItem * sensorItem = findSensor(findDSM(args[1]), args[2]);
+        QList<A2DVariableItem*> varItems;
+        for (size_t i = 4; i < args.size(); i++) {
+            A2DVariableItem * a2dvItem = dynamic_cast<A2DVariableItem*>(
+                                    findVariable(sensorItem, args[i]));
+            if (!a2dvItem)
+                throw InternalProcessingException(args[i] +
+                              " is not a variable on an ANALOG_NCAR card");
+            varItems.append(a2dvItem);
+        }
+        _doc->setA2DVariableRates(sensorItem, varItems, args[3]);
+    }
+    else if (cmd == "move-sensors") {
+        requireArgs(args, 4, "move-sensors <dsmName> <toDsmName> <sensorId>"
+                             " [<sensorId>...]");
+        DSMItem * dsmItem = findDSM(args[1]);
+        QList<SensorItem*> sensorItems;
+        for (size_t i = 3; i < args.size(); i++)
+            sensorItems.append(findSensor(dsmItem, args[i]));
+        _doc->moveSensors(sensorItems, findDSM(args[2]));
+    }
+    else if (cmd == "begin") {
+        requireArgs(args, 1, "begin [description]");
+        _doc->getJournal().begin(QString::fromStdString(
+                        args.size() > 1 ? args[1] : std::string("batch")));
+    }
+    else if (cmd == "commit") {
+        requireArgs(args, 1, "commit");
+        if (!_doc->getJournal().isOpen())
+            throw InternalProcessingException("commit: no begin");
+        _doc->getJournal().commit();
+    }
+    else if (cmd == "rollback") {
+        requireArgs(args, 1, "rollback");
+        if (!_doc->getJournal().isOpen())
+            throw InternalProcessingException("rollback: no begin");
+        _doc->getJournal().rollback();
+    }
+    else if (cmd == "undo") {
+        requireArgs(args, 1, "undo");
+        if (!_doc->getUndoStack()->canUndo())
+            throw InternalProcessingException("undo: nothing to undo");
+        _doc->getUndoStack()->undo();
+    }
+    else if (cmd == "redo") {
+        requireArgs(args, 1, "redo");
+        if (!_doc->getUndoStack()->canRedo())
+            throw InternalProcessingException("redo: nothing to redo");
+        _doc->getUndoStack()->redo();
+    }
+    else
+        throw n_u::InvalidParameterException("batch", "command", cmd);
+}
+
+void BatchEditor::openFile(const std::string & file)
+{
+    ProfileScope profile("BatchEditor::openFile");
+
+    delete _model;
+    _model = 0;
+    delete _doc;
+
+    _doc = new Document(_projDir+_engCalDirRoot, 0);
+    _doc->setFilename(file);
+    _doc->parseFile();
+
+    // Aircraft XML files should have only one site
+    vector <std::string> siteNames = _doc->getSiteNames();
+    if (siteNames.size() > 1 &&
+        (siteNames[0]=="GV_N677F" || siteNames[0]=="C130_N130AR"))
+        throw InternalProcessingException(file +
+                               ":: ERROR: XML is for aircraft but has multiple sites");
+
+    // Without Engineering Calibrations directory we'd be guessing
+    // at calfile names
+    if (!_doc->engCalDirExists())
+        throw InternalProcessingException("Could not open Engineering Cal dir:"
+                             + _doc->getEngCalDir().toStdString() +
+                             " - would be guessing cal file names");
+
+    _model = new NidasModel(Project::getInstance(), _doc->getDomDocument());
+    _doc->setModel(_model);
+}
+
+void BatchEditor::saveFile(const std::string & file)
+{
+    std::string origFile;
+    if (file.size() && file != _doc->getFilename()) {
+        origFile = _doc->getFilename();
+        _doc->setFilename(file);
+    }
+
+    if (!_doc->saveFileCopy(origFile))
+        cerr << "FAILED to write copy of file. No backups\n";
+    if (!_doc->writeDocument())
+        throw InternalProcessingException("FAILED TO WRITE FILE " +
+                                          _doc->getFilename());
+
+    vector<QString> missingEngCalFiles = _doc->getMissingEngCalFiles();
+    for (size_t i=0; i<missingEngCalFiles.size(); i++)
+        cerr << "Missing Cal File: " << missingEngCalFiles[i].toStdString()
+             << "\n";
+
+    _doc->setIsChanged(false);
+    _doc->setIsChangedBig(false);
+}
+
+SiteItem * BatchEditor::findSite(const std::string & siteName)
+{
+    NidasItem * projectItem = _model->getRootItem();
+    for (int i = 0; i < projectItem->childCount(); i++) {
+        SiteItem * siteItem = dynamic_cast<SiteItem*>(projectItem->child(i));
+        if (siteItem && siteItem->getSite()->getName() == siteName)
+            return siteItem;
+    }
+    throw n_u::InvalidParameterException("site", siteName, "not found");
+}
+
+DSMItem * BatchEditor::findDSM(const std::string & dsmName)
+{
+    NidasItem * projectItem = _model->getRootItem();
+    for (int i = 0; i < projectItem->childCount(); i++) {
+        NidasItem * siteItem = projectItem->child(i);
+        for (int j = 0; j < siteItem->childCount(); j++) {
+            DSMItem * dsmItem = dynamic_cast<DSMItem*>(siteItem->child(j));
+            if (dsmItem && dsmItem->getDSMConfig()->getName() == dsmName)
+                return dsmItem;
+        }
+    }
+    throw n_u::InvalidParameterException("dsm", dsmName, "not found");
+}
+
+SensorItem * BatchEditor::findSensor(DSMItem * dsmItem,
+                                     const std::string & sensorId)
+{
+    unsigned int id;
+    istringstream ist(sensorId);
+    ist >> id;
+    if (ist.fail())
+        throw n_u::InvalidParameterException("sensor", "id", sensorId);
+
+    for (int i = 0; i < dsmItem->childCount(); i++) {
+        SensorItem * sensorItem = dynamic_cast<SensorItem*>(dsmItem->child(i));
+        if (sensorItem && sensorItem->getDSMSensor()->getSensorId() == id)
+            return sensorItem;
+    }
+    throw n_u::InvalidParameterException(
+              dsmItem->getDSMConfig()->getName() + " sensor", sensorId,
+              "not found");
+}
+
+NidasItem * BatchEditor::findVariable(SensorItem * sensorItem,
+                                      const std::string & varName)
+{
+    for (int i = 0; i < sensorItem->childCount(); i++) {
+        NidasItem * item = sensorItem->child(i);
+        VariableItem * varItem = dynamic_cast<VariableItem*>(item);
+        if (varItem && (varItem->getBaseName() == varName ||
+                        varItem->getVariable()->getName() == varName))
+            return item;
+        A2DVariableItem * a2dVarItem = dynamic_cast<A2DVariableItem*>(item);
+        if (a2dVarItem && a2dVarItem->variableName() == varName)
+            return item;
+        DSC_A2DVariableItem * dscVarItem =
+                dynamic_cast<DSC_A2DVariableItem*>(item);
+        if (dscVarItem && dscVarItem->variableName() == varName)
+            return item;
+    }
+    throw n_u::InvalidParameterException(sensorItem->devicename() +
+                                         " variable", varName, "not found");
+}
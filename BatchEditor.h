@@ -0,0 +1,129 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+/*
+ * BatchEditor.h
+ *  Apply a script of edit operations to a nidas config xml document
+ *  without bringing up any of the configedit GUI.
+ *
+ *  Invoked as:  configedit --batch <script>
+ *
+ *  The script is line oriented.  Blank lines and anything following a '#'
+ *  are ignored.  Arguments are separated by white space; use double quotes
+ *  around arguments containing spaces.  Optional arguments are given as
+ *  key=value after the required ones.
+ *
+ *    open <file.xml>
+ *    save [file.xml]
+ *    project <name>
+ *    add-dsm <site> <dsmName> <id> [location=<loc>]
+ *    update-dsm <dsmName> [name=<name>] [id=<id>] [location=<loc>]
+ *    delete-dsm <dsmName>
+ *    add-sensor <dsmName> <catalogName> <device> <id> [suffix=<sfx>]
+ *               [a2dtempsfx=<sfx>] [a2dcal=<calfile>] [pmssn=<serNum>]
+ *               [resolution=<res>]
+ *    delete-sensor <dsmName> <sensorId>
+ *    add-a2dvar <dsmName> <sensorId> <varPrefix> <channel> <rate> <volts>
+ *               [suffix=<sfx>] [longname=<text>] [units=<units>]
+ *    update-var <dsmName> <sensorId> <varName> [longname=<text>]
+ *               [units=<units>] [rate=<rate>] [calfile=yes|no]
+ *               [cals=<c0,c1,...>]
+ *    delete-a2dvar <dsmName> <sensorId> <varName>
+ *    set-a2drate <dsmName> <sensorId> <rate> <varName> [<varName>...]
+ *    move-sensors <dsmName> <toDsmName> <sensorId> [<sensorId>...]
+ *    begin [description]
+ *    commit
+ *    rollback
+ *    undo
+ *    redo
+ *
+ *  Each edit is one undo step; edits between begin and commit are one
+ *  together, and rollback puts back everything since the begin.
+ *  <volts> is one of 0to5, 0to10, -5to5 or -10to10.
+ *
+ *  Processing stops at the first line that fails; nothing is written
+ *  unless the script reaches a save.
+ */
+
+#ifndef _BatchEditor_h
+#define _BatchEditor_h
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include <QString>
+
+#include "Document.h"
+#include "nidas_qmv/NidasModel.h"
+#include "nidas_qmv/SiteItem.h"
+
+class BatchEditor {
+
+public:
+
+    BatchEditor();
+    ~BatchEditor();
+
+    /*!
+     * \brief Run each line of \a scriptFile in turn.
+     *
+     * \return 0 if every line succeeded, 1 otherwise (suitable as an
+     *         exit status).
+     */
+    int run(const std::string & scriptFile);
+
+private:
+
+    void execute(const std::vector<std::string> & args);
+
+    void openFile(const std::string & file);
+    void saveFile(const std::string & file);
+
+    SiteItem * findSite(const std::string & siteName);
+    DSMItem * findDSM(const std::string & dsmName);
+    SensorItem * findSensor(DSMItem * dsmItem, const std::string & sensorId);
+    NidasItem * findVariable(SensorItem * sensorItem,
+                             const std::string & varName);
+
+    static std::vector<std::string> tokenize(const std::string & line);
+    static std::string a2dVoltsString(const std::string & volts);
+
+    void requireArgs(const std::vector<std::string> & args, size_t nargs,
+                     const std::string & usage);
+    std::string option(const std::string & key,
+                       const std::string & dflt = std::string());
+
+    Document * _doc;
+    NidasModel * _model;
+
+    // key=value options for the line being executed
+    std::map<std::string, std::string> _options;
+
+    QString _projDir;
+    const QString _engCalDirRoot;
+};
+
+#endif
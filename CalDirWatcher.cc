@@ -0,0 +1,126 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+
+#include "CalDirWatcher.h"
+
+#include <QSocketNotifier>
+
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+static const uint32_t CAL_DIR_EVENTS = IN_CREATE | IN_CLOSE_WRITE |
+                IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+
+
+CalDirWatcher::CalDirWatcher(QObject * parent) :
+    QObject(parent), _fd(-1), _notifier(0)
+{
+  _fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (_fd < 0) {
+    cerr << "inotify_init1: " << strerror(errno)
+         << ", cal directories won't be watched for changes\n";
+    return;
+  }
+  _notifier = new QSocketNotifier(_fd, QSocketNotifier::Read, this);
+  connect(_notifier, SIGNAL(activated(int)), this, SLOT(readEvents()));
+}
+
+CalDirWatcher::~CalDirWatcher()
+{
+  if (_fd >= 0) ::close(_fd);
+}
+
+bool CalDirWatcher::addDirectory(const QString & dir)
+{
+  if (_fd < 0) return false;
+
+  QString d = dir;
+  if (!d.endsWith('/')) d.append('/');
+
+  int wd = inotify_add_watch(_fd, d.toStdString().c_str(), CAL_DIR_EVENTS);
+  if (wd < 0) {
+    cerr << "Can't watch " << d.toStdString() << ": " << strerror(errno)
+         << "\n";
+    return false;
+  }
+  _dirs[wd] = d;
+  return true;
+}
+
+void CalDirWatcher::clear()
+{
+  QMap<int, QString>::const_iterator it;
+  for (it = _dirs.constBegin(); it != _dirs.constEnd(); ++it)
+    inotify_rm_watch(_fd, it.key());
+  _dirs.clear();
+}
+
+void CalDirWatcher::readEvents()
+{
+  char buf[4096]
+      __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+  for (;;) {
+    ssize_t len = ::read(_fd, buf, sizeof(buf));
+    if (len <= 0) break;        // EAGAIN: read them all
+
+    for (char * p = buf; p < buf + len; ) {
+      const struct inotify_event * ev = (const struct inotify_event *) p;
+      p += sizeof(struct inotify_event) + ev->len;
+
+      if (ev->mask & IN_Q_OVERFLOW) {
+        QMap<int, QString>::const_iterator it;
+        for (it = _dirs.constBegin(); it != _dirs.constEnd(); ++it)
+          emit directoryStale(it.value());
+        continue;
+      }
+      if (ev->mask & IN_IGNORED) {      // directory went away
+        _dirs.remove(ev->wd);
+        continue;
+      }
+      if (!_dirs.contains(ev->wd) || ev->len == 0 || (ev->mask & IN_ISDIR))
+        continue;
+
+      QString path = _dirs[ev->wd] + QString::fromLocal8Bit(ev->name);
+
+      if (ev->mask & IN_CREATE)
+        emit fileAdded(path);
+      if (ev->mask & IN_MOVED_TO) {
+        emit fileAdded(path);
+        emit fileChanged(path);
+      }
+      if (ev->mask & IN_CLOSE_WRITE)
+        emit fileChanged(path);
+      if (ev->mask & (IN_DELETE | IN_MOVED_FROM))
+        emit fileRemoved(path);
+    }
+  }
+}
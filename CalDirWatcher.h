@@ -0,0 +1,84 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+#ifndef _CAL_DIR_WATCHER_H
+#define _CAL_DIR_WATCHER_H
+
+#include <QObject>
+#include <QMap>
+#include <QString>
+
+class QSocketNotifier;
+
+
+/**
+ * Watches calibration directories with inotify so that cal files techs
+ * drop in (or edit, or remove) while configedit is open are picked up
+ * without rescanning the directories or restarting.
+ *
+ * Signals carry the full path of the file.  Renaming a file into a
+ * directory (as editors and rsync do) is reported as both added and
+ * changed, since it may replace a file that was already there.
+ */
+class CalDirWatcher : public QObject {
+
+  Q_OBJECT
+
+public:
+
+  CalDirWatcher(QObject * parent = 0);
+  ~CalDirWatcher();
+
+  /// Start watching \a dir.  \return false if it can't be watched.
+  bool addDirectory(const QString & dir);
+
+  /// Stop watching everything.
+  void clear();
+
+signals:
+
+  void fileAdded(const QString & path);
+  void fileChanged(const QString & path);
+  void fileRemoved(const QString & path);
+
+  /// Events were lost: \a dir has to be read again to be up to date.
+  void directoryStale(const QString & dir);
+
+private slots:
+
+  void readEvents();
+
+private:
+
+  int _fd;
+  QSocketNotifier * _notifier;
+  QMap<int, QString> _dirs;     // watch descriptor -> dir, ending in '/'
+
+  // No copying
+  CalDirWatcher(const CalDirWatcher &);
+  CalDirWatcher & operator=(const CalDirWatcher &);
+};
+
+#endif
@@ -0,0 +1,114 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+
+#include "CalFileCatalog.h"
+#include "Profiler.h"
+
+#include <dirent.h>
+#include <algorithm>
+
+using namespace std;
+
+
+bool CalFileCatalog::scan(const std::string & dir,
+                          const std::string & mustContain)
+{
+  _dir = dir;
+  _mustContain = mustContain;
+  _files.clear();
+  _names.clear();
+
+  DIR * dp = opendir(dir.c_str());
+  if (!dp) return false;
+
+  ProfileScope ps("CalFileCatalog::scan");
+
+  struct dirent * entry;
+  while ((entry = readdir(dp))) {
+    string name(entry->d_name);
+    if (!accepts(name)) continue;
+    _files.insert(name);
+    _names.push_back(name);
+  }
+  closedir(dp);
+
+  sort(_names.begin(), _names.end());
+  Profiler::getInstance()->count("cal files indexed", _names.size());
+  return true;
+}
+
+void CalFileCatalog::restore(const std::string & dir,
+                             const std::vector<std::string> & fileNames)
+{
+  _dir = dir;
+  _mustContain.clear();
+  _names = fileNames;
+  _files.clear();
+  _files.insert(_names.begin(), _names.end());
+}
+
+bool CalFileCatalog::accepts(const std::string & fileName) const
+{
+  if (fileName.find(".dat") == string::npos) return false;
+  return _mustContain.empty() || fileName.find(_mustContain) != string::npos;
+}
+
+bool CalFileCatalog::add(const std::string & fileName)
+{
+  if (!accepts(fileName) || !_files.insert(fileName).second) return false;
+  _names.insert(lower_bound(_names.begin(), _names.end(), fileName),
+                fileName);
+  return true;
+}
+
+bool CalFileCatalog::remove(const std::string & fileName)
+{
+  if (_files.erase(fileName) == 0) return false;
+  vector<string>::iterator it =
+      lower_bound(_names.begin(), _names.end(), fileName);
+  if (it != _names.end() && *it == fileName) _names.erase(it);
+  return true;
+}
+
+std::string CalFileCatalog::findVariableCalFile(const std::string & varPfx,
+                                                const std::string & varName)
+                                                const
+{
+  string varFile = varName + ".dat";
+  string pfxFile = varPfx + ".dat";
+  bool haveVar = contains(varFile);
+  bool havePfx = contains(pfxFile);
+
+  if (haveVar && havePfx) {
+    // files with "_" in them are the more specific ones
+    if (varFile.find('_') == string::npos && pfxFile.find('_') != string::npos)
+      return pfxFile;
+    return varFile;
+  }
+  if (haveVar) return varFile;
+  if (havePfx) return pfxFile;
+  return string();
+}
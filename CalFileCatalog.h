@@ -0,0 +1,103 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+#ifndef _CAL_FILE_CATALOG_H
+#define _CAL_FILE_CATALOG_H
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+
+
+/**
+ * Index of the calibration (.dat) files in a directory.
+ *
+ * Read once when a configuration is opened (the engineering cal dir) or
+ * a dialog is set up (the A2D cal dirs) so that looking up the cal file
+ * for a variable is a hash lookup on its name rather than a walk of the
+ * directory listing.  add() and remove() keep it current as files come
+ * and go (see CalDirWatcher).
+ */
+class CalFileCatalog {
+
+public:
+
+  CalFileCatalog() {}
+
+  /**
+   * Replace the catalog contents with the names in directory \a dir
+   * that contain ".dat" and, if given, \a mustContain.
+   *
+   * \return false, leaving the catalog empty, if \a dir can't be read.
+   */
+  bool scan(const std::string & dir, const std::string & mustContain = "");
+
+  /**
+   * Replace the catalog contents with \a fileNames, sorted as
+   * getFileNames() returns them, from an earlier scan() of \a dir.
+   */
+  void restore(const std::string & dir,
+               const std::vector<std::string> & fileNames);
+
+  /**
+   * Add \a fileName, e.g. one just created in the directory, if it is a
+   * cal file of the kind scan() keeps.  \return true if it was added.
+   */
+  bool add(const std::string & fileName);
+
+  /// Remove \a fileName.  \return true if it was in the catalog.
+  bool remove(const std::string & fileName);
+
+  bool contains(const std::string & fileName) const
+    { return _files.count(fileName) != 0; }
+
+  /**
+   * The engineering cal file for variable \a varName (prefix \a varPfx):
+   * varName.dat or varPfx.dat, whichever is in the catalog.  Where both
+   * are, a name with an underscore in it is preferred, then varName.dat.
+   *
+   * \return the file name, or an empty string if neither is there.
+   */
+  std::string findVariableCalFile(const std::string & varPfx,
+                                  const std::string & varName) const;
+
+  /// File names in sorted order.
+  const std::vector<std::string> & getFileNames() const { return _names; }
+
+  const std::string & getDirectory() const { return _dir; }
+
+  size_t size() const { return _names.size(); }
+
+private:
+
+  bool accepts(const std::string & fileName) const;
+
+  std::string _dir;
+  std::string _mustContain;
+  std::unordered_set<std::string> _files;
+  std::vector<std::string> _names;
+};
+
+#endif
@@ -0,0 +1,296 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+/*
+ * This file is part of configedit:
+ * A Qt based application that allows visualization of a nidas/nimbus
+ * configuration (e.g. default.xml) file.
+ */
+
+#include "ConfigDiff.h"
+#include "GrammarCache.h"
+#include "Profiler.h"
+
+#include <nidas/core/XDOM.h>
+#include <nidas/util/Exception.h>
+
+#include <xercesc/dom/DOMNamedNodeMap.hpp>
+#include <xercesc/util/PlatformUtils.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+using namespace std;
+using namespace xercesc;
+using nidas::core::XMLStringConverter;
+namespace n_u = nidas::util;
+
+
+namespace {
+
+string nodeName(const DOMNode *node)
+{
+    string name = (string) XMLStringConverter(node->getNodeName());
+    size_t colon = name.find(':');
+    if (colon != string::npos) name = name.substr(colon+1);
+    return name;
+}
+
+bool isSensor(const string & tag)
+{
+    return tag == "sensor" ||
+           (tag.size() > 6 && tag.compare(tag.size()-6, 6, "Sensor") == 0);
+}
+
+}
+
+string ConfigDiff::value(const DOMElement *elem, const string & attribute)
+{
+    if (attribute != "#text")
+        return (string) XMLStringConverter(
+            elem->getAttribute((const XMLCh*) XMLStringConverter(attribute)));
+
+    string text;
+    for (const DOMNode *child = elem->getFirstChild(); child;
+         child = child->getNextSibling())
+        if (child->getNodeType() == DOMNode::TEXT_NODE ||
+            child->getNodeType() == DOMNode::CDATA_SECTION_NODE)
+            text += (string) XMLStringConverter(child->getNodeValue());
+
+    // only indentation between child elements isn't content
+    size_t first = text.find_first_not_of(" \t\r\n");
+    if (first == string::npos) return string();
+    size_t last = text.find_last_not_of(" \t\r\n");
+    return text.substr(first, last - first + 1);
+}
+
+vector<string> ConfigDiff::attributes(const DOMElement *elem)
+{
+    vector<string> names;
+    const DOMNamedNodeMap *attrs = elem->getAttributes();
+    for (XMLSize_t i = 0; attrs && i < attrs->getLength(); i++)
+        names.push_back((string) XMLStringConverter(attrs->item(i)->getNodeName()));
+    sort(names.begin(), names.end());
+    if (!value(elem, "#text").empty()) names.push_back("#text");
+    return names;
+}
+
+string ConfigDiff::key(const DOMElement *elem)
+{
+    string tag = nodeName(elem);
+
+    const char *keyAttrs[3] = { 0, 0, 0 };
+    if (tag == "dsm" || tag == "sample")
+        keyAttrs[0] = "id";
+    else if (isSensor(tag)) {
+        keyAttrs[0] = "id";
+        keyAttrs[1] = "devicename";
+    }
+    else {
+        // catalog entries, then named things (sites, variables, parameters)
+        keyAttrs[0] = "ID";
+        keyAttrs[1] = "name";
+        keyAttrs[2] = "id";
+    }
+
+    for (int i = 0; i < 3 && keyAttrs[i]; i++) {
+        string val = value(elem, keyAttrs[i]);
+        if (!val.empty()) return tag + " " + val;
+    }
+    return tag;
+}
+
+string ConfigDiff::label(const DOMElement *elem)
+{
+    string k = key(elem);
+    string tag = nodeName(elem);
+
+    string name;
+    if (tag == "dsm") name = value(elem, "name");
+    else if (isSensor(tag)) name = value(elem, "devicename");
+
+    if (!name.empty() && k != tag + " " + name) k += " (" + name + ")";
+    return k;
+}
+
+vector<pair<string, DOMElement*> >
+ConfigDiff::keyedChildren(const DOMElement *elem)
+{
+    vector<pair<string, DOMElement*> > children;
+    map<string, int> seen;
+
+    for (DOMNode *child = elem->getFirstChild(); child;
+         child = child->getNextSibling()) {
+        if (child->getNodeType() != DOMNode::ELEMENT_NODE) continue;
+        DOMElement *childElem = (DOMElement*) child;
+        string k = key(childElem);
+        int n = ++seen[k];
+        if (n > 1) {
+            ostringstream ost;
+            ost << k << " #" << n;
+            k = ost.str();
+        }
+        children.push_back(make_pair(k, childElem));
+    }
+    return children;
+}
+
+const vector<ConfigDiff::Change> &
+ConfigDiff::compare(const xercesc::DOMDocument *before,
+                    const xercesc::DOMDocument *after)
+{
+    ProfileScope ps("ConfigDiff::compare");
+
+    _changes.clear();
+    const DOMElement *b = before->getDocumentElement();
+    const DOMElement *a = after->getDocumentElement();
+    if (key(b) != key(a)) {
+        Change removed = { Removed, label(b), "", "", "" };
+        Change added = { Added, label(a), "", "", "" };
+        _changes.push_back(removed);
+        _changes.push_back(added);
+        return _changes;
+    }
+    compare(b, a, label(a));
+    return _changes;
+}
+
+void ConfigDiff::compare(const DOMElement *before, const DOMElement *after,
+                         const string & path)
+{
+    if (before->isEqualNode(after)) return;
+    Profiler::getInstance()->count("ConfigDiff elements walked");
+
+    compareAttributes(before, after, path);
+
+    vector<pair<string, DOMElement*> > bChildren = keyedChildren(before);
+    vector<pair<string, DOMElement*> > aChildren = keyedChildren(after);
+
+    map<string, DOMElement*> aByKey;
+    for (size_t i = 0; i < aChildren.size(); i++)
+        aByKey[aChildren[i].first] = aChildren[i].second;
+
+    map<string, DOMElement*> bByKey;
+    for (size_t i = 0; i < bChildren.size(); i++) {
+        DOMElement *b = bChildren[i].second;
+        bByKey[bChildren[i].first] = b;
+        string childPath = path + " / " + label(b);
+        map<string, DOMElement*>::const_iterator ai =
+            aByKey.find(bChildren[i].first);
+        if (ai == aByKey.end()) {
+            Change c = { Removed, childPath, "", "", "" };
+            _changes.push_back(c);
+        }
+        else compare(b, ai->second, path + " / " + label(ai->second));
+    }
+
+    for (size_t i = 0; i < aChildren.size(); i++) {
+        if (bByKey.count(aChildren[i].first)) continue;
+        Change c = { Added, path + " / " + label(aChildren[i].second),
+                     "", "", "" };
+        _changes.push_back(c);
+    }
+}
+
+void ConfigDiff::compareAttributes(const DOMElement *before,
+                                   const DOMElement *after,
+                                   const string & path)
+{
+    vector<string> names = attributes(before);
+    vector<string> aNames = attributes(after);
+    names.insert(names.end(), aNames.begin(), aNames.end());
+    sort(names.begin(), names.end());
+    names.erase(unique(names.begin(), names.end()), names.end());
+
+    for (size_t i = 0; i < names.size(); i++) {
+        string b = value(before, names[i]);
+        string a = value(after, names[i]);
+        if (a == b) continue;
+        Change c = { Changed, path, names[i], b, a };
+        _changes.push_back(c);
+    }
+}
+
+void ConfigDiff::print(ostream & out) const
+{
+    for (size_t i = 0; i < _changes.size(); i++) {
+        const Change & c = _changes[i];
+        switch (c.kind) {
+        case Added:
+            out << "+ " << c.path << "\n";
+            break;
+        case Removed:
+            out << "- " << c.path << "\n";
+            break;
+        case Changed:
+            out << "~ " << c.path << ": " << c.attribute << " \""
+                << c.before << "\" -> \"" << c.after << "\"\n";
+            break;
+        }
+    }
+}
+
+int ConfigDiff::run(const vector<string> & files)
+{
+    XMLPlatformUtils::Initialize();
+
+    int status = 0;
+    ConfigDiff diff;
+    xercesc::DOMDocument *prev = 0;
+
+    // each file is parsed once, and only two are held at a time
+    for (size_t i = 0; i < files.size(); i++) {
+        xercesc::DOMDocument *doc = 0;
+        try {
+            doc = GrammarCache::getInstance()->parse(files[i], false);
+        }
+        catch (const n_u::Exception & e) {
+            cerr << files[i] << ": " << e.what() << "\n";
+            status = 2;
+        }
+        catch (...) {
+            cerr << files[i] << ": Caught Unspecified error\n";
+            status = 2;
+        }
+
+        if (prev && doc) {
+            diff.compare(prev, doc);
+            if (!diff.changes().empty()) {
+                cout << "--- " << files[i-1] << "\n"
+                     << "+++ " << files[i] << "\n";
+                diff.print(cout);
+                if (status == 0) status = 1;
+            }
+        }
+        if (prev) prev->release();
+        prev = doc;
+    }
+    if (prev) prev->release();
+
+    XMLPlatformUtils::Terminate();
+    return status;
+}
@@ -0,0 +1,124 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+/*
+ * ConfigDiff.h
+ *  structural differences between two nidas configurations
+ */
+
+#ifndef _ConfigDiff_h
+#define _ConfigDiff_h
+
+#include <xercesc/dom/DOMDocument.hpp>
+#include <xercesc/dom/DOMElement.hpp>
+
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+/*!
+ * \brief Differences between two configuration documents by what they
+ *        configure rather than by line.
+ *
+ * Elements are matched with the siblings they replace by the ids the
+ * Project tree keys them on - sites and variables by name, DSMs, sensors
+ * and samples by id, catalog entries by ID - so reordering, reindenting
+ * or a sensor moved within its DSM is not a difference, and a changed
+ * attribute is reported against the sensor or variable it belongs to.
+ * Calibrations, parameters and anything else without an id are matched
+ * by element name and order.
+ *
+ * Subtrees that are identical are skipped without being walked, which is
+ * most of a configuration from one saved copy to the next.
+ */
+class ConfigDiff {
+
+public:
+
+    enum Kind { Added, Removed, Changed };
+
+    struct Change {
+        Kind kind;
+        std::string path;       // e.g. "site GV_N677F / dsm 1 / sensor 200"
+        std::string attribute;  // Changed only; "#text" for element content
+        std::string before;
+        std::string after;
+    };
+
+    /// Compare \a before with \a after, replacing any earlier changes.
+    const std::vector<Change> & compare(const xercesc::DOMDocument *before,
+                                        const xercesc::DOMDocument *after);
+
+    const std::vector<Change> & changes() const { return _changes; }
+
+    /// Write the changes one per line: '+' added, '-' removed, '~' changed.
+    void print(std::ostream & out) const;
+
+    /*!
+     * \brief Which sibling \a elem is, e.g. "dsm 3" or "variable TTHR1".
+     *        Not unique among siblings: see keyedChildren().
+     */
+    static std::string key(const xercesc::DOMElement *elem);
+
+    /// key() with a readable name added where the key is a number.
+    static std::string label(const xercesc::DOMElement *elem);
+
+    /*!
+     * \brief The element children of \a elem with their keys, in order.
+     *        Repeated keys get "#2", "#3", ... so every key is unique.
+     */
+    static std::vector<std::pair<std::string, xercesc::DOMElement*> >
+        keyedChildren(const xercesc::DOMElement *elem);
+
+    /// An attribute's value, or its element's own text for "#text".
+    static std::string value(const xercesc::DOMElement *elem,
+                             const std::string & attribute);
+
+    /// The attribute names of \a elem, plus "#text" if it has any text.
+    static std::vector<std::string> attributes(const xercesc::DOMElement *elem);
+
+    /*!
+     * \brief configedit --diff: each file against the one before it.
+     *
+     * \return 0 if no differences, 1 if some, 2 if a file couldn't be
+     *         read (as diff(1) does).
+     */
+    static int run(const std::vector<std::string> & files);
+
+private:
+
+    void compare(const xercesc::DOMElement *before,
+                 const xercesc::DOMElement *after, const std::string & path);
+
+    void compareAttributes(const xercesc::DOMElement *before,
+                           const xercesc::DOMElement *after,
+                           const std::string & path);
+
+    std::vector<Change> _changes;
+};
+
+#endif
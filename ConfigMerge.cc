@@ -0,0 +1,320 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+/*
+ * This file is part of configedit:
+ * A Qt based application that allows visualization of a nidas/nimbus
+ * configuration (e.g. default.xml) file.
+ */
+
+#include "ConfigMerge.h"
+#include "ConfigDiff.h"
+#include "Document.h"
+#include "GrammarCache.h"
+#include "Profiler.h"
+
+#include <nidas/core/XDOM.h>
+#include <nidas/util/Exception.h>
+
+#include <xercesc/util/PlatformUtils.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+
+using namespace std;
+using namespace xercesc;
+using nidas::core::XMLStringConverter;
+namespace n_u = nidas::util;
+
+
+namespace {
+
+typedef vector<pair<string, DOMElement*> > KeyedChildren;
+
+bool has(const DOMElement *elem, const string & name)
+{
+    if (!elem) return false;
+    if (name == "#text") return !ConfigDiff::value(elem, name).empty();
+    return elem->hasAttribute((const XMLCh*) XMLStringConverter(name));
+}
+
+// an attribute as shown in a conflict: absent isn't the same as empty
+string shown(const DOMElement *elem, const string & name)
+{
+    if (!has(elem, name)) return "(none)";
+    return ConfigDiff::value(elem, name);
+}
+
+bool same(const DOMElement *a, const DOMElement *b, const string & name)
+{
+    if (has(a, name) != has(b, name)) return false;
+    // an element that isn't there (no base when both sides added it) has
+    // no value to compare
+    if (!a || !b) return true;
+    return ConfigDiff::value(a, name) == ConfigDiff::value(b, name);
+}
+
+/// Give \a elem's attribute (or text) \a name the value it has in \a from.
+void copyValue(DOMElement *elem, const DOMElement *from, const string & name)
+{
+    if (name != "#text") {
+        XMLStringConverter xname(name);
+        if (has(from, name))
+            elem->setAttribute((const XMLCh*) xname,
+                (const XMLCh*) XMLStringConverter(ConfigDiff::value(from, name)));
+        else
+            elem->removeAttribute((const XMLCh*) xname);
+        return;
+    }
+
+    DOMNode *child = elem->getFirstChild();
+    while (child) {
+        DOMNode *next = child->getNextSibling();
+        if (child->getNodeType() == DOMNode::TEXT_NODE ||
+            child->getNodeType() == DOMNode::CDATA_SECTION_NODE) {
+            elem->removeChild(child);
+            child->release();
+        }
+        child = next;
+    }
+    if (has(from, name))
+        elem->appendChild(elem->getOwnerDocument()->createTextNode(
+            (const XMLCh*) XMLStringConverter(ConfigDiff::value(from, name))));
+}
+
+map<string, DOMElement*> byKey(const KeyedChildren & children)
+{
+    map<string, DOMElement*> keyed;
+    for (size_t i = 0; i < children.size(); i++)
+        keyed[children[i].first] = children[i].second;
+    return keyed;
+}
+
+DOMElement *find(const map<string, DOMElement*> & keyed, const string & key)
+{
+    map<string, DOMElement*>::const_iterator mi = keyed.find(key);
+    return mi == keyed.end() ? 0 : mi->second;
+}
+
+}
+
+const vector<ConfigMerge::Conflict> &
+ConfigMerge::merge(const xercesc::DOMDocument *base,
+                   xercesc::DOMDocument *ours,
+                   const xercesc::DOMDocument *theirs)
+{
+    ProfileScope ps("ConfigMerge::merge");
+
+    _conflicts.clear();
+    const DOMElement *b = base->getDocumentElement();
+    DOMElement *o = ours->getDocumentElement();
+    const DOMElement *t = theirs->getDocumentElement();
+
+    if (ConfigDiff::key(o) != ConfigDiff::key(t)) {
+        conflict(ConfigDiff::label(o), "", ConfigDiff::label(b),
+                 ConfigDiff::label(o), ConfigDiff::label(t),
+                 "not the same configuration");
+        return _conflicts;
+    }
+    if (ConfigDiff::key(b) != ConfigDiff::key(o)) b = 0;
+    merge(b, o, t, ConfigDiff::label(o));
+    return _conflicts;
+}
+
+/*
+ * Bring theirs' changes since base into ours.  \a base is 0 where
+ * both sides added the element.  Returns the element now in ours' place,
+ * which is a copy of theirs if only theirs changed.
+ */
+DOMElement *ConfigMerge::merge(const DOMElement *base, DOMElement *ours,
+                        const DOMElement *theirs, const string & path)
+{
+    if (ours->isEqualNode(theirs)) return ours;
+    if (base && base->isEqualNode(theirs)) return ours; // only ours changed
+
+    // only theirs changed: take theirs whole
+    DOMNode *parent = ours->getParentNode();
+    if (base && base->isEqualNode(ours) && parent &&
+        parent->getNodeType() == DOMNode::ELEMENT_NODE) {
+        DOMNode *theirsCopy =
+            ours->getOwnerDocument()->importNode(theirs, true);
+        parent->replaceChild(theirsCopy, ours);
+        ours->release();
+        return (DOMElement*) theirsCopy;
+    }
+    Profiler::getInstance()->count("ConfigMerge elements merged");
+
+    mergeAttributes(base, ours, theirs, path);
+
+    KeyedChildren bChildren;
+    if (base) bChildren = ConfigDiff::keyedChildren(base);
+    KeyedChildren oChildren = ConfigDiff::keyedChildren(ours);
+    KeyedChildren tChildren = ConfigDiff::keyedChildren(theirs);
+    map<string, DOMElement*> bByKey = byKey(bChildren);
+    map<string, DOMElement*> oByKey = byKey(oChildren);
+    map<string, DOMElement*> tByKey = byKey(tChildren);
+
+    // removed at the end, so they can still place what theirs added
+    vector<DOMElement*> removals;
+
+    for (size_t i = 0; i < oChildren.size(); i++) {
+        const string & key = oChildren[i].first;
+        DOMElement *o = oChildren[i].second;
+        DOMElement *b = find(bByKey, key);
+        DOMElement *t = find(tByKey, key);
+        string childPath = path + " / " + ConfigDiff::label(o);
+
+        if (t) oByKey[key] = merge(b, o, t, childPath);
+        else if (b) {                   // theirs removed it
+            if (b->isEqualNode(o)) removals.push_back(o);
+            else conflict(childPath, "", "present", "changed", "removed",
+                          "changed in ours, removed in theirs");
+        }
+        // else ours added it
+    }
+
+    for (size_t i = 0; i < tChildren.size(); i++) {
+        const string & key = tChildren[i].first;
+        if (oByKey.count(key)) continue;
+        DOMElement *t = tChildren[i].second;
+        DOMElement *b = find(bByKey, key);
+
+        if (b) {                        // ours removed it
+            if (b->isEqualNode(t)) continue;
+            conflict(path + " / " + ConfigDiff::label(t), "", "present",
+                     "removed", "changed", "removed in ours, changed in theirs");
+        }
+
+        // place it before whatever follows it in theirs that ours has too
+        DOMNode *before = 0;
+        for (size_t j = i + 1; j < tChildren.size() && !before; j++)
+            before = find(oByKey, tChildren[j].first);
+        DOMNode *theirsCopy = ours->getOwnerDocument()->importNode(t, true);
+        if (before && before->getParentNode() == ours)
+            ours->insertBefore(theirsCopy, before);
+        else
+            ours->appendChild(theirsCopy);
+    }
+
+    for (size_t i = 0; i < removals.size(); i++) {
+        ours->removeChild(removals[i]);
+        removals[i]->release();
+    }
+    return ours;
+}
+
+void ConfigMerge::mergeAttributes(const DOMElement *base, DOMElement *ours,
+                                  const DOMElement *theirs,
+                                  const string & path)
+{
+    vector<string> names = ConfigDiff::attributes(ours);
+    vector<string> tNames = ConfigDiff::attributes(theirs);
+    names.insert(names.end(), tNames.begin(), tNames.end());
+    if (base) {
+        vector<string> bNames = ConfigDiff::attributes(base);
+        names.insert(names.end(), bNames.begin(), bNames.end());
+    }
+    sort(names.begin(), names.end());
+    names.erase(unique(names.begin(), names.end()), names.end());
+
+    for (size_t i = 0; i < names.size(); i++) {
+        const string & name = names[i];
+        if (same(ours, theirs, name)) continue;
+        if (same(base, theirs, name)) continue;         // ours changed it
+        if (same(base, ours, name)) {                   // theirs changed it
+            copyValue(ours, theirs, name);
+            continue;
+        }
+        conflict(path, name, shown(base, name), shown(ours, name),
+                 shown(theirs, name),
+                 base ? "changed in both" : "added in both");
+    }
+}
+
+void ConfigMerge::conflict(const string & path, const string & attribute,
+                           const string & base, const string & ours,
+                           const string & theirs, const string & reason)
+{
+    Conflict c = { path, attribute, base, ours, theirs, reason };
+    _conflicts.push_back(c);
+}
+
+void ConfigMerge::print(ostream & out) const
+{
+    for (size_t i = 0; i < _conflicts.size(); i++) {
+        const Conflict & c = _conflicts[i];
+        out << "CONFLICT " << c.path;
+        if (!c.attribute.empty()) out << ": " << c.attribute;
+        out << " (" << c.reason << "): base \"" << c.base << "\", ours \""
+            << c.ours << "\", theirs \"" << c.theirs << "\"\n";
+    }
+}
+
+int ConfigMerge::run(const string & base, const string & ours,
+                     const string & theirs, const string & output)
+{
+    XMLPlatformUtils::Initialize();
+
+    const string files[3] = { base, ours, theirs };
+    xercesc::DOMDocument *docs[3] = { 0, 0, 0 };
+    int status = 0;
+
+    for (int i = 0; i < 3 && status == 0; i++) {
+        try {
+            docs[i] = GrammarCache::getInstance()->parse(files[i], false);
+        }
+        catch (const n_u::Exception & e) {
+            cerr << files[i] << ": " << e.what() << "\n";
+            status = 2;
+        }
+        catch (...) {
+            cerr << files[i] << ": Caught Unspecified error\n";
+            status = 2;
+        }
+    }
+
+    if (status == 0) {
+        ConfigMerge merger;
+        merger.merge(docs[0], docs[1], docs[2]);
+        merger.print(cout);
+        if (!merger.conflicts().empty()) status = 1;
+
+        // written as configedit saves, tidied and replaced atomically
+        Document doc("", 0);
+        doc.setDomDocument(docs[1]);
+        doc.setFilename(output);
+        if (!doc.writeDocument()) {
+            cerr << output << ": could not write merged configuration\n";
+            status = 2;
+        }
+    }
+
+    for (int i = 0; i < 3; i++)
+        if (docs[i]) docs[i]->release();
+
+    XMLPlatformUtils::Terminate();
+    return status;
+}
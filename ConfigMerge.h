@@ -0,0 +1,128 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+/*
+ * ConfigMerge.h
+ *  three-way structural merge of nidas configurations
+ */
+
+#ifndef _ConfigMerge_h
+#define _ConfigMerge_h
+
+#include <xercesc/dom/DOMDocument.hpp>
+#include <xercesc/dom/DOMElement.hpp>
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+/*!
+ * \brief Merge two edited copies of a configuration with the copy they
+ *        both started from, by what they configure rather than by line.
+ *
+ * Elements are matched as ConfigDiff matches them: DSMs, sensors and
+ * samples by id, sites and variables by name.  Whatever only one side
+ * changed since the base is taken from that side - an attribute, a
+ * variable added to a sample, a sensor removed - so two people editing
+ * different sensors, or different attributes of the same variable,
+ * merge cleanly however the files were reordered or reindented.
+ *
+ * Where both sides changed the same attribute differently, or both added
+ * the same element differently, ours is kept and a Conflict recorded.
+ * Where one side removed what the other changed, the changed element is
+ * kept, so nothing is silently lost.
+ */
+class ConfigMerge {
+
+public:
+
+    struct Conflict {
+        std::string path;       // as in ConfigDiff::Change
+        std::string attribute;  // empty if the whole element conflicts
+        std::string base;
+        std::string ours;
+        std::string theirs;
+        std::string reason;
+    };
+
+    /*!
+     * \brief Apply to \a ours the changes \a theirs made since \a base.
+     *        \a ours becomes the merged document.
+     */
+    const std::vector<Conflict> & merge(const xercesc::DOMDocument *base,
+                                        xercesc::DOMDocument *ours,
+                                        const xercesc::DOMDocument *theirs);
+
+    const std::vector<Conflict> & conflicts() const { return _conflicts; }
+
+    /// One line per conflict, with the base, ours and theirs values.
+    void print(std::ostream & out) const;
+
+    /*!
+     * \brief configedit --merge <base> <ours> <theirs> <output>
+     *
+     * Writes the merged configuration to \a output (which may be \a ours)
+     * and lists any conflicts.  As a git mergetool:
+     *
+     *   git config mergetool.configedit.cmd \
+     *     'configedit --merge "$BASE" "$LOCAL" "$REMOTE" "$MERGED"'
+     *   git config mergetool.configedit.trustExitCode true
+     *
+     * or as a merge driver for default.xml files ("merge=configedit" in
+     * .gitattributes):
+     *
+     *   git config merge.configedit.driver 'configedit --merge %O %A %B %A'
+     *
+     * The files are parsed as configedit opens them, so XIncludes are
+     * written out expanded, as a save from the editor would.
+     *
+     * \return 0 if merged cleanly, 1 if there were conflicts (the output
+     *         is still written, with ours at each), 2 if a file couldn't
+     *         be read or the output couldn't be written.
+     */
+    static int run(const std::string & base, const std::string & ours,
+                   const std::string & theirs, const std::string & output);
+
+private:
+
+    xercesc::DOMElement *merge(const xercesc::DOMElement *base,
+                               xercesc::DOMElement *ours,
+                               const xercesc::DOMElement *theirs,
+                               const std::string & path);
+
+    void mergeAttributes(const xercesc::DOMElement *base,
+                         xercesc::DOMElement *ours,
+                         const xercesc::DOMElement *theirs,
+                         const std::string & path);
+
+    void conflict(const std::string & path, const std::string & attribute,
+                  const std::string & base, const std::string & ours,
+                  const std::string & theirs, const std::string & reason);
+
+    std::vector<Conflict> _conflicts;
+};
+
+#endif
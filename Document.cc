@@ -33,11 +33,20 @@
 #include "Document.h"
 #include "configwindow.h"
 #include "exceptions/InternalProcessingException.h"
+#include "TidyFileFormatTarget.h"
+#include "GrammarCache.h"
+#include "Profiler.h"
+#include "SessionSnapshot.h"
+#include "nidas_qmv/ProjectSync.h"
 #include <nidas/util/InvalidParameterException.h>
 
 #include <sys/param.h>
+#include <sys/stat.h>
 #include <libgen.h>
-#include <dirent.h>
+#include <ctime>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
 
 #include <xercesc/util/XMLUniDefs.hpp>
 
@@ -57,6 +66,7 @@
 #include <nidas/core/DSMSensor.h>
 
 #include <iostream>
+#include <algorithm>
 #include <set>
 #include <vector>
 
@@ -69,6 +79,22 @@ using namespace nidas::core;
 static const XMLCh gLS[] = { chLatin_L, chLatin_S, chNull };
 static const XMLCh gNull[] = { chNull };
 
+namespace {
+
+// Releases a DOM node that is in no document tree (e.g. a clone) on
+// the way out of a scope, however it is left.
+class NodeReleaser {
+public:
+  NodeReleaser(DOMNode *node) : _node(node) {}
+  ~NodeReleaser() { _node->release(); }
+private:
+  DOMNode *_node;
+  NodeReleaser(const NodeReleaser &);
+  NodeReleaser & operator=(const NodeReleaser &);
+};
+
+}
+
 
 
 const char *Document::getDirectory() const
@@ -81,25 +107,215 @@ const char *Document::getDirectory() const
 
 
 
+NidasModel *Document::getModel() const
+{
+    if (_configWindow) return _configWindow->getModel();
+    if (!_model)
+      throw InternalProcessingException("Document has no NidasModel");
+    return _model;
+}
+
+DSMItem *Document::currentDSMItem() const
+{
+    DSMItem* dsmItem = dynamic_cast<DSMItem*>(getModel()->getCurrentRootItem());
+    if (!dsmItem)
+      throw InternalProcessingException("Current root index is not a DSM.");
+    return dsmItem;
+}
+
+SiteItem *Document::currentSiteItem() const
+{
+    SiteItem* siteItem =
+               dynamic_cast<SiteItem*>(getModel()->getCurrentRootItem());
+    if (!siteItem)
+      throw InternalProcessingException("Current root index is not a Site.");
+    return siteItem;
+}
+
+SensorItem *Document::currentSensorItem() const
+{
+    SensorItem* sensorItem =
+               dynamic_cast<SensorItem*>(getModel()->getCurrentRootItem());
+    if (!sensorItem)
+      throw InternalProcessingException(
+                       "Current root index is not an A2D SensorItem.");
+    return sensorItem;
+}
+
+/*!
+ * \brief The NidasItem for the (last) selected row in \a indexList, or 0.
+ */
+NidasItem *Document::selectedItem(const QModelIndexList & indexList) const
+{
+  NidasModel *model = getModel();
+  NidasItem *item = 0;
+  for (int i=0; i<indexList.size(); i++) {
+    QModelIndex index = indexList[i];
+    // the NidasItem for the selected row resides in column 0
+    if (index.column() != 0) continue;
+    if (!index.isValid()) continue;
+    item = model->getItem(index);
+  }
+  return item;
+}
+
+/*!
+ * \brief Remove \a item (a DSM, sensor or A2D variable) and everything
+ *        under it from the Project, the DOM and the Qt model.
+ */
+void Document::removeItem(NidasItem *item)
+{
+  if (!item || !item->getParentItem())
+    throw InternalProcessingException("Document::removeItem - nothing to remove");
+  EditJournal::Transaction tx(_journal, "Delete");
+  tx.touch(item);
+  QModelIndexList indexList;
+  indexList.append(item->createIndex());
+  if (!getModel()->removeIndexes(indexList))
+    throw InternalProcessingException("Document::removeItem - remove failed");
+  setIsChangedBig(true);
+}
+
+/*!
+ * \brief Remove all of \a items (DSMs, sensors or A2D variables, as
+ *        selected together in the table) in one pass.
+ */
+void Document::removeItems(const QList<NidasItem*> & items)
+{
+  EditJournal::Transaction tx(_journal, "Delete");
+  QModelIndexList indexList;
+  for (int i = 0; i < items.size(); i++) {
+    if (!items[i] || !items[i]->getParentItem())
+      throw InternalProcessingException("Document::removeItems - nothing to remove");
+    tx.touch(items[i]);
+    indexList.append(items[i]->createIndex());
+  }
+  if (indexList.isEmpty()) return;
+  if (!getModel()->removeIndexes(indexList))
+    throw InternalProcessingException("Document::removeItems - remove failed");
+  setIsChangedBig(true);
+}
+
+
+
 bool Document::writeDocument()
 {
-    LocalFileFormatTarget *target;
+    cerr<<__func__ << " : filename = "<<filename->c_str()<<"\n";
 
-    try {
-        cerr<<__func__ << " : filename = "<<filename->c_str()<<"\n";
-        target = new LocalFileFormatTarget(filename->c_str());
-        if (!target) {
-            cerr << "target is null" << endl;
-            return false;
-            }
-    } catch (...) {
-        cerr << "LocalFileFormatTarget new exception" << endl;
+    // Serialize through the tidying target into a temporary file, which
+    // only replaces the real one once the whole document is written.
+    TidyFileFormatTarget target(*filename);
+
+    if (!writeDOM(&target,domdoc)) {
+        cerr << "writeDOM failed, " << *filename << " left unchanged\n";
         return false;
     }
+    return target.commit();
+}
+
 
-    writeDOM(target,domdoc);
-    delete target;
+
+/**
+ * \brief Save a time stamped copy of the file about to be overwritten
+ *        into the .confedit directory next to it.
+ *
+ * Call before writeDocument(), so the backup exists before the new
+ * version replaces the file.
+ *
+ * If \a origFile is empty the current filename is copied, otherwise
+ * \a origFile is (i.e. the file we're doing a "Save As" from).
+ */
+bool Document::saveFileCopy(const std::string & origFile)
+{
+  std::string saveFileName = *filename;
+  size_t fn = saveFileName.rfind("/");
+  std::string saveFname = saveFileName.substr(fn+1);
+  std::string saveDir = saveFileName.substr(0, fn+1);
+  std::string copyDir = saveDir + ".confedit";
+  std::string copyFname;
+  std::string copyFile;
+  std::string fromFile;
+
+  // Make copy directory if it doesn't already exist
+  umask(0);
+  struct stat st;
+  if (stat(copyDir.c_str(), &st) != 0) { // create copy dir
+    if (mkdir(copyDir.c_str(), S_IRWXU|S_IRWXG|S_IROTH|S_IXOTH) == -1) {
+      cerr << "Could not create directory " << copyDir << " to save copies\n";
+      return false;
+    }
+  }
+
+  // set up the copy filename
+  time_t now;
+  char dateTime[64];
+  dateTime[0] = '\0';
+  now = time(NULL);
+  if (now != -1)
+    strftime(dateTime, 64, "%Y%m%d-%H%M%S", gmtime(&now));
+  else
+    cerr << "couldn't get timestamp for copy filename\n";
+  copyFname = saveFname+"."+std::string(dateTime);
+  copyFile = copyDir + "/" +copyFname;
+
+  if (origFile.length() == 0)
+    fromFile = saveFileName;
+  else
+    fromFile = origFile;
+
+  if (stat(fromFile.c_str(), &st) != 0) {
+    // see if a .xml was added by configwindow
+    size_t found;
+    found = fromFile.rfind(".xml");
+    if (found!=string::npos) {
+      string::iterator it;
+      it = fromFile.begin()+found;
+      fromFile.erase(it,fromFile.end());
+    }
+    else
+      return false;
+
+    if (stat(fromFile.c_str(), &st) != 0) {
+      cerr << "Could not open source file : " << fromFile << "\n";
+      return false;
+    }
+  }
+
+  // Hard link the previous version into the copy directory: nothing has
+  // to be read or written, and since writeDocument() renames the new
+  // version into place rather than overwriting, the link keeps the old
+  // contents.  Fall back to copying where links can't be made.
+  if (link(fromFile.c_str(), copyFile.c_str()) == 0) {
+    cerr << "linked from: \n" << fromFile <<
+            "\n to: \n" << copyFile << "\n";
     return true;
+  }
+  cerr << "Could not link " << fromFile << " to " << copyFile << " : "
+       << strerror(errno) << ", copying\n";
+
+  ifstream src(fromFile.c_str(), ifstream::in);
+  if (!src) {
+    cerr << "Could not open source file : " << fromFile << "\n";
+    return false;
+  }
+  ofstream dest(copyFile.c_str(), ifstream::out);
+  if (!dest) {
+    cerr << "Could not open destination file: " << copyFile << "\n";
+    return false;
+  }
+
+  dest << src.rdbuf();
+  if (!dest)
+  {
+     cerr << "Error while copying from: \n" << fromFile <<
+             "\n to: \n" << copyFile << "\n";
+     return false;
+  }
+
+  cerr << "copied from: \n" << fromFile <<
+          "\n to: \n" << copyFile << "\n";
+
+  return true;
 }
 
 
@@ -249,29 +465,34 @@ void Document::parseFile()
     cerr << "Document::parseFile()" << endl;
     if (!filename) return;
 
-    XMLParser * parser = new XMLParser();
-
-    // turn on validation
-    parser->setDOMValidation(true);
-    parser->setDOMValidateIfSchema(true);
-    parser->setDOMNamespaces(true);
-    parser->setXercesSchema(true);
-    parser->setXercesSchemaFullChecking(true);
-    parser->setDOMDatatypeNormalization(false);
-    parser->setXercesHandleMultipleImports(true);
-    parser->setXercesDoXInclude(true);
-    parser->setXercesUserAdoptsDOMDocument(true);
-
-    cerr << "parsing: " << *filename << endl;
-    // build Document Object Model (DOM) tree
-    domdoc = parser->parse(*filename);
-    cerr << "parsed" << endl;
-    delete parser;
+    ProfileScope profile("Document::parseFile");
+
+    // an unchanged configuration comes back from its snapshot unparsed
+    SessionSnapshot snapshot(*filename);
+    _fromSnapshot = snapshot.load();
+    if (_fromSnapshot)
+        domdoc = snapshot.takeDocument();
+    else {
+        cerr << "parsing: " << *filename
+             << (_fastOpen ? " (without schema full checking)" : "") << endl;
+        // build Document Object Model (DOM) tree, against the schema
+        // grammar compiled by the first file opened this session
+        ProfileScope ps("XMLParser::parse");
+        domdoc = GrammarCache::getInstance()->parse(*filename, !_fastOpen);
+        cerr << "parsed" << endl;
+    }
 
     _project = new Project(); // start anew
 
     // build Project tree
-    _project->fromDOMElement(domdoc->getDocumentElement());
+    {
+        ProfileScope ps("Project::fromDOMElement");
+        _project->fromDOMElement(domdoc->getDocumentElement());
+    }
+
+    // the catalog doesn't change while we edit, so index it once here
+    _sensorCatalog.build(_project->getSensorCatalog());
+    _ids.build();
 
     vector <std::string> siteNames;
     siteNames=getSiteNames();
@@ -282,37 +503,47 @@ void Document::parseFile()
     cerr<<_engCalDir.toStdString();
     cerr<<"\n";
 
-    DIR *dir;
-    char *temp_dir = (char*) malloc(_engCalDir.size()+1);
+    // Index the .dat (Engineering cal) files so variables find theirs
+    // with a lookup (see CalFileCatalog::findVariableCalFile)
+    _engCalDirExists =
+        snapshot.restoreCalFiles(_engCalFiles, _engCalDir.toStdString()) ||
+        _engCalFiles.scan(_engCalDir.toStdString());
 
-    strcpy(temp_dir, _engCalDir.toStdString().c_str());
+    // Only a fully checked parse is worth keeping.  Without a cal dir the
+    // catalog saved is empty, and is scanned for again on the next open.
+    if (!_fromSnapshot && !_fastOpen) snapshot.save(domdoc, _engCalFiles);
 
-    if ((dir = opendir(temp_dir)) == 0) {
-       _engCalDirExists = false;
-       return;
-    } else {
-       _engCalDirExists = true;
-    }
-
-    // Read filenames and keep those that are .dat (Engineering cal files)
-    // Put files with "_" in them in the front of the list so that they
-    // are preferentially found when looking for engineering cal files.
-    struct dirent *entry;
-    std::vector<QString>::iterator it;
-    cerr<<"Found Engineering CalFiles: ";
-    while ( (entry = readdir(dir)) )
-        if (strstr(entry->d_name, ".dat")) {
-            if (strstr(entry->d_name, "_")) {
-                it = _engCalFiles.begin();
-                _engCalFiles.insert(it,QString(entry->d_name));
-            } else {
-                _engCalFiles.push_back(QString(entry->d_name));
-            }
-            cerr<<entry->d_name<<" ";
-        }
-    cerr<<"\n";
+    if (!_engCalDirExists) return;
 
-    free(temp_dir);
+    Profiler::getInstance()->count("eng cal files", _engCalFiles.size());
+    cerr<<"Found "<<_engCalFiles.size()<<" Engineering CalFiles\n";
+}
+
+/**
+ * \brief Parse \a file as parseFile() does with full schema checking,
+ *        throwing the result away.
+ *
+ * Touches no Document state, so may be run on a worker thread while the
+ * GUI uses a fast opened copy of the same file.
+ */
+std::string Document::validateFile(const std::string & file)
+{
+    ProfileScope profile("Document::validateFile");
+    try {
+        xercesc::DOMDocument * doc =
+            GrammarCache::getInstance()->parse(file, true);
+        if (doc) doc->release();
+    }
+    catch (const nidas::util::Exception & e) {
+        return e.what();
+    }
+    catch (const xercesc::DOMException & e) {
+        return (std::string)XMLStringConverter(e.getMessage());
+    }
+    catch (...) {
+        return "unknown error while validating";
+    }
+    return std::string();
 }
 
 /**
@@ -325,7 +556,8 @@ string Document::getProjectName() const
 
 void Document::setProjectName(string projectName)
 {
-  NidasModel *model = _configWindow->getModel();
+  EditJournal::Transaction tx(_journal, "Edit Project Name");
+  NidasModel *model = getModel();
   ProjectItem * projectItem = dynamic_cast<ProjectItem*>(model->getRootItem());
   if (!projectItem)
     throw InternalProcessingException("Model root index is not a Project.");
@@ -370,14 +602,9 @@ const xercesc::DOMElement* Document::findSensor(const std::string & sensorIdName
         cerr<<"Configuration file doesn't contain a catalog!!"<<endl;
         return(0);
     }
-    map<string,xercesc::DOMElement*>::const_iterator mi;
-    const map<std::string,xercesc::DOMElement*>& scMap = _project->getSensorCatalog()->getMap();
-    for (mi = scMap.begin(); mi != scMap.end(); mi++) {
-        if (mi->first == sensorIdName) {
-           return mi->second;
-        }
-    }
-    return(NULL);
+    const SensorCatalogIndex::Entry * entry = _sensorCatalog.find(sensorIdName);
+    if (!entry) return(NULL);
+    return entry->element;
 }
 
 void Document::updateSensor(const std::string & sensorIdName,
@@ -390,33 +617,34 @@ void Document::updateSensor(const std::string & sensorIdName,
                             const std::string & resltn,
                             QModelIndexList indexList)
 {
-cerr<<"entering Document::updateSensor\n";
+  currentDSMItem(); // sensors are only edited from a DSM's table
 
-  // Gather together all the elements we'll need to update the Sensor
-  // in both the DOM model and the Nidas Model
-  NidasModel *model = _configWindow->getModel();
-  DSMItem* dsmItem = dynamic_cast<DSMItem*>(model->getCurrentRootItem());
-  if (!dsmItem)
-    throw InternalProcessingException("Current root index is not a DSM.");
+  NidasItem *item = selectedItem(indexList);
+  if (!item) throw InternalProcessingException("null DSMConfig");
+  SensorItem* sItem = dynamic_cast<SensorItem*>(item);
+  if (!sItem) throw InternalProcessingException("Sensor Item not selected");
 
-  DSMConfig *dsmConfig = dsmItem->getDSMConfig();
-  if (!dsmConfig)
-    throw InternalProcessingException("null DSMConfig");
+  updateSensor(sItem, sensorIdName, device, lcId, sfx, a2dTempSfx,
+               a2dSNFname, pmsSN, resltn);
+}
 
-  NidasItem *item = 0;
-  if (indexList.size() > 0)  {
-    for (int i=0; i<indexList.size(); i++) {
-      QModelIndex index = indexList[i];
-      // the NidasItem for the selected row resides in column 0
-      if (index.column() != 0) continue;
-      if (!index.isValid()) continue;
-      item = model->getItem(index);
-    }
-  }
+void Document::updateSensor(SensorItem *sItem,
+                            const std::string & sensorIdName,
+                            const std::string & device,
+                            const std::string & lcId,
+                            const std::string & sfx,
+                            const std::string & a2dTempSfx,
+                            const std::string & a2dSNFname,
+                            const std::string & pmsSN,
+                            const std::string & resltn)
+{
+cerr<<"entering Document::updateSensor\n";
 
-  if (!item) throw InternalProcessingException("null DSMConfig");
-  SensorItem* sItem = dynamic_cast<SensorItem*>(item);
+  // Gather together all the elements we'll need to update the Sensor
+  // in both the DOM model and the Nidas Model
   if (!sItem) throw InternalProcessingException("Sensor Item not selected");
+  EditJournal::Transaction tx(_journal, "Edit Sensor");
+  tx.touch(sItem);
   // Confirm we got an A2D sensor item
   A2DSensorItem *a2dSensorItem = dynamic_cast<A2DSensorItem*>(sItem);
   DSC_A2DSensorItem *dscA2dSensorItem = dynamic_cast<DSC_A2DSensorItem*>(sItem);
@@ -442,6 +670,12 @@ cerr<<"entering Document::updateSensor\n";
     }
   }
 
+  // Keep the sensor's element as it was, so only what changes gets
+  // re-read into the Project tree
+  xercesc::DOMElement *beforeElem =
+      (xercesc::DOMElement*) sItem->getDOMNode()->cloneNode(true);
+  NodeReleaser releaseBefore(beforeElem);
+
   // Start by updating the sensor DOM
   updateSensorDOM(sItem, device, lcId, sfx);
 
@@ -467,14 +701,14 @@ cerr<<"entering Document::updateSensor\n";
   // Now we need to validate that all is right with the updated sensor
   // information - and if not change it all back to the original state
   try {
-    sItem->fromDOM();
+    ProjectSync::sensor(sensor, beforeElem,
+                        (xercesc::DOMElement*) sItem->getDOMNode());
 
     // make sure new sensor works well with old (e.g. var names and suffix)
     //Site* site = const_cast <Site *> (dsmConfig->getSite());
     //site->validate();
 
   } catch (nidas::util::InvalidParameterException &e) {
-
     stringstream strS;
     strS<<currSensorId;
     updateSensorDOM(sItem, currDevName, strS.str(), currSuffix);
@@ -554,13 +788,26 @@ void Document::addSensor(const std::string & sensorIdName,
                          const std::string & pmsSN,
                          const std::string & resltn)
 {
-cerr << "entering Document::addSensor about to make call to "
-     << "_configWindow->getModel()\n  configwindow address = "
-     << _configWindow << "\n";
-  NidasModel *model = _configWindow->getModel();
-  DSMItem* dsmItem = dynamic_cast<DSMItem*>(model->getCurrentRootItem());
+  addSensor(currentDSMItem(), sensorIdName, device, lcId, sfx, a2dTempSfx,
+            a2dSNFname, pmsSN, resltn);
+}
+
+void Document::addSensor(DSMItem *dsmItem,
+                         const std::string & sensorIdName,
+                         const std::string & device,
+                         const std::string & lcId,
+                         const std::string & sfx,
+                         const std::string & a2dTempSfx,
+                         const std::string & a2dSNFname,
+                         const std::string & pmsSN,
+                         const std::string & resltn)
+{
+cerr << "entering Document::addSensor\n";
+  NidasModel *model = getModel();
   if (!dsmItem)
-    throw InternalProcessingException("Current root index is not a DSM.");
+    throw InternalProcessingException("null DSMItem");
+  EditJournal::Transaction tx(_journal, "Add Sensor");
+  tx.touch(dsmItem);
 
   DSMConfig *dsmConfig = dsmItem->getDSMConfig();
   if (!dsmConfig)
@@ -688,6 +935,115 @@ cerr << "entering Document::addSensor about to make call to "
    printSiteNames();
 }
 
+/*!
+ * \brief Move \a sensorItems (from any DSMs) to \a dsmItem.
+ *
+ * Each sensor's DOM element is copied under the new DSM, keeping its
+ * samples, variables and calibrations; a sensor id already used there
+ * is replaced by a free one.  The new sensors are all validated before
+ * the old ones are removed, and if any fails none are moved.
+ */
+void Document::moveSensors(const QList<SensorItem*> & sensorItems,
+                           DSMItem *dsmItem)
+{
+cerr << "entering Document::moveSensors\n";
+  NidasModel *model = getModel();
+  if (!dsmItem)
+    throw InternalProcessingException("null DSMItem");
+
+  DSMConfig *dsmConfig = dsmItem->getDSMConfig();
+  if (!dsmConfig)
+    throw InternalProcessingException("null DSMConfig");
+
+  xercesc::DOMNode *dsmNode = dsmItem->getDOMNode();
+  if (!dsmNode)
+    throw InternalProcessingException("null dsm DOM node");
+
+  // DSMItem::removeChild() goes by devicename, so it has to stay unique
+  set<string> devices;
+  for (SensorIterator si = dsmConfig->getSensorIterator(); si.hasNext(); )
+    devices.insert(si.next()->getDeviceName());
+
+  QList<SensorItem*> moving;
+  for (int i = 0; i < sensorItems.size(); i++) {
+    SensorItem *sensorItem = sensorItems[i];
+    if (!sensorItem || !sensorItem->getDOMNode())
+      throw InternalProcessingException("null SensorItem");
+    if (sensorItem->getParentItem() == dsmItem) continue;
+    if (!devices.insert(sensorItem->devicename()).second)
+      throw n_u::InvalidParameterException(string("dsm") + ": " +
+                dsmConfig->getName(), "devicename",
+                sensorItem->devicename() + " is already in use");
+    moving.append(sensorItem);
+  }
+  if (moving.isEmpty()) return;
+
+  EditJournal::Transaction tx(_journal, "Move Sensors");
+  tx.touch(dsmItem);
+  for (int i = 0; i < moving.size(); i++) tx.touch(moving[i]);
+
+  IdAllocator & sensorIds = _ids.sensors(dsmConfig->getSite()->getName(),
+                                         dsmConfig->getId());
+  vector<DSMSensor*> added;
+  vector<xercesc::DOMNode*> addedNodes;
+  try {
+    for (int i = 0; i < moving.size(); i++) {
+      SensorItem *sensorItem = moving[i];
+      xercesc::DOMElement *elem = (xercesc::DOMElement *)
+                                  sensorItem->getDOMNode()->cloneNode(true);
+      unsigned int sensorId = sensorItem->getDSMSensor()->getSensorId();
+      if (!sensorIds.reserve(sensorId)) {
+        sensorId = sensorIds.next(IdAllocators::SensorIdStride,
+                                  IdAllocators::ShortIdEnd);
+        sensorIds.reserve(sensorId);
+        elem->setAttribute((const XMLCh*)XMLStringConverter("id"),
+                 (const XMLCh*)XMLStringConverter(std::to_string(sensorId)));
+      }
+
+      DSMSensor* sensor = 0;
+      try {
+        sensor = dsmConfig->sensorFromDOMElement(elem);
+      } catch (...) {
+        elem->release();
+        throw;
+      }
+      if (sensor == NULL) {
+        elem->release();
+        throw InternalProcessingException("null sensor(FromDOMElement)");
+      }
+      dsmConfig->addSensor(sensor);
+      added.push_back(sensor);
+      addedNodes.push_back(dsmNode->appendChild(elem));
+    }
+
+    dsmConfig->validate();
+    for (size_t i = 0; i < added.size(); i++) added[i]->validate();
+    Site* site = const_cast <Site *> (dsmConfig->getSite());
+    site->validate();
+
+  } catch (...) {
+    // keep nidas Project tree and DOM as they were
+    for (size_t i = 0; i < added.size(); i++) {
+      dsmConfig->removeSensor(added[i]);
+      delete added[i];
+    }
+    for (size_t i = 0; i < addedNodes.size(); i++)
+      dsmNode->removeChild(addedNodes[i])->release();
+    throw;
+  }
+
+  // update Qt model: the copies in one go, then the originals
+  model->appendChildren(dsmItem, moving.size());
+
+  QModelIndexList indexList;
+  for (int i = 0; i < moving.size(); i++)
+    indexList.append(moving[i]->createIndex());
+  if (!model->removeIndexes(indexList))
+    throw InternalProcessingException("Document::moveSensors - removing moved sensors failed");
+
+  setIsChangedBig(true);
+}
+
 vector <std::string> Document::getSiteNames()
 {
     vector <std::string> sites;
@@ -1257,15 +1613,20 @@ cerr << "  setting samp element attribs: id = " << sampleId
 
 void Document::addDSM(const std::string & dsmName, const std::string & dsmId,
                          const std::string & dsmLocation)
+{
+  addDSM(currentSiteItem(), dsmName, dsmId, dsmLocation);
+}
+
+void Document::addDSM(SiteItem *siteItem,
+                      const std::string & dsmName, const std::string & dsmId,
+                      const std::string & dsmLocation)
 //               throw (nidas::util::InvalidParameterException, InternalProcessingException)
 {
-cerr<<"entering Document::addDSM about to make call to _configWindow->getModel()"  <<"\n"
-      "dsmName = "<<dsmName<<" id= "<<dsmId<<" location= " <<dsmLocation<<"\n"
-      "configwindow address = "<< _configWindow <<"\n";
-  NidasModel *model = _configWindow->getModel();
-  SiteItem * siteItem = dynamic_cast<SiteItem*>(model->getCurrentRootItem());
+cerr<<"entering Document::addDSM"  <<"\n"
+      "dsmName = "<<dsmName<<" id= "<<dsmId<<" location= " <<dsmLocation<<"\n";
+  NidasModel *model = getModel();
   if (!siteItem)
-    throw InternalProcessingException("Current root index is not a Site.");
+    throw InternalProcessingException("null SiteItem");
 
   Site *site = siteItem->getSite();
   if (!site)
@@ -1274,6 +1635,9 @@ cerr<<"entering Document::addDSM about to make call to _configWindow->getModel()
   unsigned int iDsmId;
   iDsmId = validateDsmInfo(site, dsmName,dsmId);
 
+  EditJournal::Transaction tx(_journal, "Add DSM");
+  tx.touchDSM(site->getName(), iDsmId);
+
 // get the DOM node for this Site
   xercesc::DOMNode *siteNode = siteItem->getDOMNode();
   if (!siteNode) {
@@ -1411,30 +1775,34 @@ void Document::updateDSM(const std::string & dsmName,
                          const std::string & dsmLocation,
                          QModelIndexList indexList)
 {
-cerr<<"entering Document::updateDSM\n";
+  NidasItem *item = selectedItem(indexList);
+  if (!item) throw InternalProcessingException("null DSMConfig");
+  DSMItem* dsmItem = dynamic_cast<DSMItem*>(item);
+  if (!dsmItem) throw InternalProcessingException("DSM Item not selected.");
 
-  // Gather together all the elements we'll need to update the Sensor
-  // in both the document object model (DOM) and the Nidas Model
-  NidasModel *model = _configWindow->getModel();
+  updateDSM(dsmItem, dsmName, dsmId, dsmLocation);
+}
 
-  NidasItem *item = 0;
-  if (indexList.size() > 0)  {
-    for (int i=0; i<indexList.size(); i++) {
-      QModelIndex index = indexList[i];
-      // the NidasItem for the selected row resides in column 0
-      if (index.column() != 0) continue;
-      if (!index.isValid()) continue;
-      item = model->getItem(index);
-    }
-  }
+void Document::updateDSM(DSMItem *dsmItem,
+                         const std::string & dsmName,
+                         const std::string & dsmId,
+                         const std::string & dsmLocation)
+{
+cerr<<"entering Document::updateDSM\n";
 
-  if (!item) throw InternalProcessingException("null DSMConfig");
-  DSMItem* dsmItem = dynamic_cast<DSMItem*>(item);
+  // Gather together all the elements we'll need to update the DSM
+  // in both the document object model (DOM) and the Nidas Model
   if (!dsmItem) throw InternalProcessingException("DSM Item not selected.");
 
   // Get the DSM and save all the current values, then update
   // to the new values
   DSMConfig* dsm = dsmItem->getDSMConfig();
+
+  // journaled under both ids if it's being renumbered
+  EditJournal::Transaction tx(_journal, "Edit DSM");
+  tx.touch(dsmItem);
+  if (!dsmId.empty() && dsm->getSite())
+    tx.touchDSM(dsm->getSite()->getName(), atoi(dsmId.c_str()));
   std::string currDSMName = dsm->getName();
   dsm_sample_id_t currDSMId = dsm->getId();
   std::string currLocation = dsm->getLocation();
@@ -1446,7 +1814,7 @@ cerr<<"entering Document::updateDSM\n";
   // in the nidas world and if not, change it all back.
   try {
 cerr<<" Getting and validating site.\n";
-    dsmItem->fromDOM();
+    ProjectSync::dsm(dsm, (xercesc::DOMElement*) dsmItem->getDOMNode());
     Site* site = const_cast<Site *>(dsmItem->getDSMConfig()->getSite());
     site->validate();
   } catch (nidas::util::InvalidParameterException &e) {
@@ -1497,41 +1865,26 @@ cerr<<"updateDSMDOM - name:" << dsmName << " ID:"<<dsmId<<" loc:"<<dsmLocation<<
 
 unsigned int Document::getNextSensorId()
 {
-cerr<< "in getNextSensorId" << endl;
-  unsigned int maxSensorId = 0;
-
-  NidasModel *model = _configWindow->getModel();
+  return getNextSensorId(currentDSMItem());
+}
 
-  DSMItem * dsmItem = dynamic_cast<DSMItem*>(model->getCurrentRootItem());
-  if (!dsmItem) {
-    throw InternalProcessingException("Current root index is not a DSM.");
-    cerr<<" dsmItem = NULL" << endl;
-    return 0;
-    }
-cerr<< "after call to model->getCurrentRootItem" << endl;
+unsigned int Document::getNextSensorId(DSMItem *dsmItem)
+{
+  if (!dsmItem)
+    throw InternalProcessingException("null DSMItem");
 
-  //DSMConfig *dsmConfig = (DSMConfig *) dsmItem;
   DSMConfig *dsmConfig = dsmItem->getDSMConfig();
   if (dsmConfig == NULL) {
     cerr << "dsmConfig is null!" <<endl;
     return 0;
     }
 
-cerr << "dsmConfig name : " << dsmConfig->getName() << endl;
-  const std::list<DSMSensor*>& sensors = dsmConfig->getSensors();
-cerr<< "after call to dsmConfig->getSensors" << endl;
-
-  for (list<DSMSensor*>::const_iterator si = sensors.begin();si != sensors.end(); si++)
-  {
-if (*si == 0) cerr << "si is zero" << endl;
-cerr<<" si is: " << (*si)->getName() << endl;
-    if ((*si)->getSensorId() > maxSensorId) maxSensorId = (*si)->getSensorId();
-cerr<< "after call to getSensorId" << endl;
-  }
-
-    maxSensorId += 200;
-cerr<< "returning maxSensorId " << maxSensorId << endl;
-    return maxSensorId;
+  // the lowest free block of SensorIdStride ids, gaps left by removed
+  // sensors included
+  unsigned int sensorId =
+      _ids.sensors(dsmConfig->getSite()->getName(), dsmConfig->getId())
+          .next(IdAllocators::SensorIdStride, IdAllocators::ShortIdEnd);
+  return sensorId;
 }
 
 std::list <int> Document::getAvailableA2DChannels()
@@ -1539,9 +1892,8 @@ std::list <int> Document::getAvailableA2DChannels()
 cerr<< "in getAvailableA2DChannels" << endl;
   std::list<int> availableChannels;
   for (int i = 0; i < 8; i++) availableChannels.push_back(i);
-  std::list<int>::iterator aci;
 
-  NidasModel *model = _configWindow->getModel();
+  NidasModel *model = getModel();
 
   SensorItem * sensorItem = dynamic_cast<SensorItem*>(model->getCurrentRootItem());
   if (!sensorItem) {
@@ -1550,6 +1902,9 @@ cerr<< "in getAvailableA2DChannels" << endl;
     // selected. Check for that case here.
     DSMItem * dsmItem = dynamic_cast<DSMItem*>(model->getCurrentRootItem());
     if (dsmItem) { // parent is a DSM item
+        if (!_configWindow)
+          throw InternalProcessingException(
+                    "No sensor selection available without a ConfigWindow");
         // Get selected indices and make sure it's only one
         QTableView *tableview = _configWindow->getTableView();
         QModelIndexList indexList = tableview->selectionModel()->selectedIndexes();
@@ -1577,6 +1932,18 @@ cerr<< "in getAvailableA2DChannels" << endl;
     return availableChannels;
   }
 
+  return getAvailableA2DChannels(sensorItem);
+}
+
+std::list <int> Document::getAvailableA2DChannels(SensorItem *sensorItem)
+{
+  std::list<int> availableChannels;
+  for (int i = 0; i < 8; i++) availableChannels.push_back(i);
+  std::list<int>::iterator aci;
+
+  if (!sensorItem)
+    throw InternalProcessingException("null SensorItem");
+
   DSMSensor *sensor = sensorItem->getDSMSensor();
   if (sensor == NULL) {
     cerr << "dsmSensor is null!\n";
@@ -1611,42 +1978,25 @@ cerr<< "in getAvailableA2DChannels" << endl;
  */
 unsigned int Document::getNextDSMId()
 {
-cerr<< "in getNextDSMId" << endl;
-  unsigned int maxDSMId = 0;
-
-  NidasModel *model = _configWindow->getModel();
+  return getNextDSMId(currentSiteItem());
+}
 
-  SiteItem * siteItem = dynamic_cast<SiteItem*>(model->getCurrentRootItem());
-  if (!siteItem) {
-    throw InternalProcessingException("Current root index is not a Site.");
-    cerr<<" siteItem = NULL" << endl;
-    return 0;
-    }
-cerr<< "after call to model->getCurrentRootItem" << endl;
+unsigned int Document::getNextDSMId(SiteItem *siteItem)
+{
+  if (!siteItem)
+    throw InternalProcessingException("null SiteItem");
 
-  //DSMConfig *dsmConfig = (DSMConfig *) dsmItem;
   Site *site = siteItem->getSite();
   if (site == NULL) {
     cerr << "Site is null!" <<endl;
     return 0;
     }
 
-cerr << "Site name : " << site->getName() << endl;
-  const std::list<DSMConfig*>& dsmConfigs = site->getDSMConfigs();
-cerr<< "after call to site->getDSMConfigs" << endl;
-
-  for (list<DSMConfig*>::const_iterator di = dsmConfigs.begin();di != dsmConfigs.end(); di++)
-  {
-if (*di == 0) cerr << "di is zero" << endl;
-cerr<<" di is: " << (*di)->getName() << endl;
-    if (((*di)->getId() > maxDSMId) && ((*di)->getId() < _MIN_WING_DSM_ID))
-      maxDSMId = (*di)->getId();
-cerr<< "after call to getDSMId" << endl;
-  }
-
-    maxDSMId += 1;
-cerr<< "returning maxDSMId" << maxDSMId << endl;
-    return maxDSMId;
+  IdAllocator & dsmIds = _ids.dsms(site->getName());
+  unsigned int dsmId = dsmIds.next(1, _MIN_WING_DSM_ID);
+  if (dsmId == _MIN_WING_DSM_ID)    // no room below the wing DSMs
+    dsmId = dsmIds.next(_MIN_WING_DSM_ID, IdAllocators::DSMIdEnd);
+  return dsmId;
 }
 
 void Document::updateVariable(VariableItem * varItem,
@@ -1658,11 +2008,13 @@ void Document::updateVariable(VariableItem * varItem,
                               bool useCalfile)
 {
   cerr<<"Document::updateVariable\n";
-  NidasModel *model = _configWindow->getModel();
-  SensorItem * sensorItem = dynamic_cast<SensorItem*>
-                                        (model->getCurrentRootItem());
+  if (!varItem)
+    throw InternalProcessingException("null VariableItem");
+  SensorItem * sensorItem = varItem->getSensorItem();
   if (!sensorItem)
-    throw InternalProcessingException("Current root index is not a SensorItem");
+    throw InternalProcessingException("Parent of VariableItem is not a SensorItem");
+  EditJournal::Transaction tx(_journal, "Edit Variable");
+  tx.touch(sensorItem);
 
   DOMNode *sensorDOMNode = sensorItem->getDOMNode();
   DSMSensor* sensor;
@@ -1708,17 +2060,14 @@ void Document::updateVariable(VariableItem * varItem,
        throw InternalProcessingException(
                  "Document::updateVariable - can't find sensor catalog!");
 
-    map<string,xercesc::DOMElement*>::const_iterator mi;
-    const map<std::string,xercesc::DOMElement*>& scMap =
-                                    _project->getSensorCatalog()->getMap();
-
     // Find the sensor in the sensor catalog
-    for (mi = scMap.begin(); mi != scMap.end(); mi++) {
-      if (mi->first == siBName.toStdString()) {
+    const SensorCatalogIndex::Entry * catEntry =
+                              _sensorCatalog.find(siBName.toStdString());
+    if (catEntry) {
         cerr << "  found sensor node in catalog\n";
 
         // find Sample node in the sensor node from the catalog
-        DOMNodeList * sampleNodes = mi->second->getChildNodes();
+        DOMNodeList * sampleNodes = catEntry->element->getChildNodes();
         for (XMLSize_t i = 0; i < sampleNodes->getLength(); i++) {
           DOMNode * sensorChild = sampleNodes->item(i);
           if ( ((string)XMLStringConverter(sensorChild->getNodeName())).
@@ -1744,7 +2093,6 @@ void Document::updateVariable(VariableItem * varItem,
             break;
           }
         }
-      }
     }
   }
   origSampleElem = ((xercesc::DOMElement*) sampleNode);
@@ -1839,7 +2187,7 @@ void Document::updateVariable(VariableItem * varItem,
   // Check for SampleTag having problems with new XML
   SampleTag* origSampTag = varItem->getSampleTag();
   try {
-    origSampTag->fromDOMElement((xercesc::DOMElement*)newSampleElem);
+    ProjectSync::sample(origSampTag, (xercesc::DOMElement*)newSampleElem);
   }
     catch(const n_u::InvalidParameterException& e) {
     origSampTag->fromDOMElement((xercesc::DOMElement*)origSampleElem);
@@ -1852,9 +2200,9 @@ void Document::updateVariable(VariableItem * varItem,
   // add sample to Sensor DOM - get the varItem parent which should be the
   // SensorItem then get it's Dom
   try {
+    // the SampleTag already has the new sample; nothing else in the
+    // sensor changed, so it doesn't need re-reading
     sensorDOMNode->appendChild(newSampleNode);
-    DOMElement *sensorElem = (DOMElement*) sensorDOMNode;
-    sensor->fromDOMElement((DOMElement*)sensorElem);
   } catch (DOMException &e) {
      origSampTag->fromDOMElement((xercesc::DOMElement*)origSampleElem);
      throw InternalProcessingException("add var to sensor element: " +
@@ -1886,7 +2234,6 @@ void Document::updateVariable(VariableItem * varItem,
 
   cerr<<"added sample node to the DOM - now updating varItem\n";
   varItem->clearVarItem();
-  sensorItem->fromDOM();
   varItem->fromDOM();
 
     // update Qt model
@@ -1906,19 +2253,33 @@ void Document::addA2DVariable(const std::string & a2dVarNamePfx,
                               const std::string & a2dVarUnits,
                               vector <std::string> cals)
 {
-cerr<<"in Document::addA2DVariable about to call _configWindow->getModel()"  <<"\n";
-  NidasModel *model = _configWindow->getModel();
-cerr<<"got model \n";
-  SensorItem * sensorItem = dynamic_cast<SensorItem*>(model->getCurrentRootItem());
+  addA2DVariable(currentSensorItem(), a2dVarNamePfx, a2dVarNameSfx,
+                 a2dVarLongName, a2dVarVolts, a2dVarChannel, a2dVarSR,
+                 a2dVarUnits, cals);
+}
+
+void Document::addA2DVariable(SensorItem *sensorItem,
+                              const std::string & a2dVarNamePfx,
+                              const std::string & a2dVarNameSfx,
+                              const std::string & a2dVarLongName,
+                              const std::string & a2dVarVolts,
+                              const std::string & a2dVarChannel,
+                              const std::string & a2dVarSR,
+                              const std::string & a2dVarUnits,
+                              vector <std::string> cals)
+{
+cerr<<"in Document::addA2DVariable\n";
   if (!sensorItem)
-    throw InternalProcessingException("Current root index is not an A2D SensorItem.");
+    throw InternalProcessingException("null A2D SensorItem.");
+  EditJournal::Transaction tx(_journal, "Add A2D Variable");
+  tx.touch(sensorItem);
 
   // Use devicename() to determine which type of analog sensor we are dealing with
   if (sensorItem->devicename() == "/dev/ncar_a2d0") { // ANALOG_NCAR
-    addNCARVariable(a2dVarNamePfx, a2dVarNameSfx, a2dVarLongName, a2dVarVolts,
+    addNCARVariable(sensorItem, a2dVarNamePfx, a2dVarNameSfx, a2dVarLongName, a2dVarVolts,
                     a2dVarChannel, a2dVarSR, a2dVarUnits, cals);
   } else if (sensorItem->devicename() == "/dev/dmmat_a2d0") { // ANALOG_DMMAT
-    addDSCVariable(a2dVarNamePfx, a2dVarNameSfx, a2dVarLongName, a2dVarVolts,
+    addDSCVariable(sensorItem, a2dVarNamePfx, a2dVarNameSfx, a2dVarLongName, a2dVarVolts,
                     a2dVarChannel, a2dVarSR, a2dVarUnits, cals);
   }
 cerr << "Leaving Document::addA2DVariable\n";
@@ -1926,7 +2287,8 @@ cerr << "Leaving Document::addA2DVariable\n";
   return;
 }
 
-void Document::addNCARVariable(const std::string & a2dVarNamePfx,
+void Document::addNCARVariable(SensorItem *sensorItem,
+                              const std::string & a2dVarNamePfx,
                               const std::string & a2dVarNameSfx,
                               const std::string & a2dVarLongName,
                               const std::string & a2dVarVolts,
@@ -1935,12 +2297,10 @@ void Document::addNCARVariable(const std::string & a2dVarNamePfx,
                               const std::string & a2dVarUnits,
                               vector <std::string> cals)
 {
-cerr<<"entering Document::addA2DVariable about to make call to _configWindow->getModel()"  <<"\n";
-  NidasModel *model = _configWindow->getModel();
-cerr<<"got model \n";
-  SensorItem * sensorItem = dynamic_cast<SensorItem*>(model->getCurrentRootItem());
+cerr<<"entering Document::addNCARVariable\n";
+  NidasModel *model = getModel();
   if (!sensorItem)
-    throw InternalProcessingException("Current root index is not an A2D SensorItem.");
+    throw InternalProcessingException("null A2D SensorItem.");
 
   DOMNode * sensorNode = sensorItem->getDOMNode();
   A2DVariableItem *a2dvItem;
@@ -1971,34 +2331,12 @@ cerr<<"Find existing A2D Variable Items (non-A2DTemp) and add them to list:\n";
   for (int i = 0; i<sensorItem->childCount(); i++) {
 //  Gather key elements of children
     a2dvItem = dynamic_cast<A2DVariableItem*>(sensorItem->child(i));
-    if (a2dvItem) {
-      a2dvInfo = new A2DVariableInfo;
-    } else {
+    if (!a2dvItem) {
       throw InternalProcessingException("Child of A2D Sensor is not A2D Variable.");
     }
 // If we've got an A2DTEMP variable we need to skip it
     if (a2dvItem->variableName().compare(0,7,"A2DTEMP") != 0) {
-      a2dvInfo->a2dVarNamePfx = a2dvItem->getVarNamePfx();
-      a2dvInfo->a2dVarNameSfx = a2dvItem->getVarNameSfx();
-cerr<<"  - A2DvItem pfx:"<<a2dvItem->getVarNamePfx();
-cerr<<"  sfx:"<<a2dvItem->getVarNameSfx()<<"\n";
-      a2dvInfo->a2dVarLongName = a2dvItem->getLongName().toStdString();
-      if (a2dvItem->getGain() == 1 && a2dvItem->getBipolar() == 1)
-        a2dvInfo->a2dVarVolts = "-10 to 10 Volts";
-      else if (a2dvItem->getGain() == 2 && a2dvItem->getBipolar() == 0)
-        a2dvInfo->a2dVarVolts = "  0 to 10 Volts";
-      else if (a2dvItem->getGain() == 2 && a2dvItem->getBipolar() == 1)
-        a2dvInfo->a2dVarVolts = " -5 to  5 Volts";
-      else if (a2dvItem->getGain() == 4 && a2dvItem->getBipolar() == 0)
-        a2dvInfo->a2dVarVolts = "  0 to  5 Volts";
-      else {
-        throw InternalProcessingException
-                      ("Unsupported Gain and Bipolar Values");
-      }
-      a2dvInfo->a2dVarChannel = std::to_string(a2dvItem->getA2DChannel());
-      a2dvInfo->a2dVarSR = std::to_string((int) a2dvItem->getRate());
-      a2dvInfo->a2dVarUnits = a2dvItem->getUnits();
-      a2dvInfo->cals = a2dvItem->getCalibrationInfo();
+      a2dvInfo = new A2DVariableInfo(getA2DVariableInfo(a2dvItem));
 
 //
 //   If we put them into the vector ordered based solely on channel number
@@ -2128,7 +2466,8 @@ cerr<<"  sfx:"<<a2dvItem->getVarNameSfx()<<"\n";
   return;
 }
 
-void Document::addDSCVariable(const std::string & a2dVarNamePfx,
+void Document::addDSCVariable(SensorItem *sensorItem,
+                              const std::string & a2dVarNamePfx,
                               const std::string & a2dVarNameSfx,
                               const std::string & a2dVarLongName,
                               const std::string & a2dVarVolts,
@@ -2137,7 +2476,7 @@ void Document::addDSCVariable(const std::string & a2dVarNamePfx,
                               const std::string & a2dVarUnits,
                               vector <std::string> cals)
 {
-cerr<<"entering Document::addDSCVariable about to make call to _configWindow->getModel()"  <<"\n";
+cerr<<"entering Document::addDSCVariable\n";
 
 
   // Attempting to insert a DSC_A2D var causes two separate errors:
@@ -2146,6 +2485,9 @@ cerr<<"entering Document::addDSCVariable about to make call to _configWindow->ge
   //   It is likely related to this error.
   // - if highlight a variable, get out of sync error
   // Temporarily catch trying to add a DMMAT var and don't allow it.
+  if (!_configWindow)
+    throw InternalProcessingException(
+              "Adding a variable on a DMMAT card not implemented yet");
   QMessageBox msgBox;
   QString msg("Adding a variable on a DMMAT card not implemented yet");
   msgBox.setText(msg);
@@ -2153,11 +2495,9 @@ cerr<<"entering Document::addDSCVariable about to make call to _configWindow->ge
   return;
 
 
-  NidasModel *model = _configWindow->getModel();
-cerr<<"got model \n";
-  SensorItem * sensorItem = dynamic_cast<SensorItem*>(model->getCurrentRootItem());
+  NidasModel *model = getModel();
   if (!sensorItem)
-    throw InternalProcessingException("Current root index is not an A2D SensorItem.");
+    throw InternalProcessingException("null A2D SensorItem.");
 
   DOMNode * sensorNode = sensorItem->getDOMNode();
   DSC_A2DVariableItem *a2dvItem;
@@ -2348,6 +2688,127 @@ cerr << "Leaving Document::addDSCVariable\n";
   return;
 }
 
+/*!
+ * \brief Describe the existing \a a2dvItem the way insertA2DVariable()
+ *        wants it, so the variable can be removed and put back.
+ */
+Document::A2DVariableInfo Document::getA2DVariableInfo(A2DVariableItem *a2dvItem)
+{
+  A2DVariableInfo a2dvInfo;
+  a2dvInfo.a2dVarNamePfx = a2dvItem->getVarNamePfx();
+  a2dvInfo.a2dVarNameSfx = a2dvItem->getVarNameSfx();
+cerr<<"  - A2DvItem pfx:"<<a2dvItem->getVarNamePfx();
+cerr<<"  sfx:"<<a2dvItem->getVarNameSfx()<<"\n";
+  a2dvInfo.a2dVarLongName = a2dvItem->getLongName().toStdString();
+  if (a2dvItem->getGain() == 1 && a2dvItem->getBipolar() == 1)
+    a2dvInfo.a2dVarVolts = "-10 to 10 Volts";
+  else if (a2dvItem->getGain() == 2 && a2dvItem->getBipolar() == 0)
+    a2dvInfo.a2dVarVolts = "  0 to 10 Volts";
+  else if (a2dvItem->getGain() == 2 && a2dvItem->getBipolar() == 1)
+    a2dvInfo.a2dVarVolts = " -5 to  5 Volts";
+  else if (a2dvItem->getGain() == 4 && a2dvItem->getBipolar() == 0)
+    a2dvInfo.a2dVarVolts = "  0 to  5 Volts";
+  else {
+    throw InternalProcessingException
+                  ("Unsupported Gain and Bipolar Values");
+  }
+  a2dvInfo.a2dVarChannel = std::to_string(a2dvItem->getA2DChannel());
+  a2dvInfo.a2dVarSR = std::to_string((int) a2dvItem->getRate());
+  a2dvInfo.a2dVarUnits = a2dvItem->getUnits();
+  a2dvInfo.cals = a2dvItem->getCalibrationInfo();
+  return a2dvInfo;
+}
+
+/*!
+ * \brief Change the sample rate of all of \a varItems on the ANALOG_NCAR
+ *        card \a sensorItem to \a a2dVarSR.
+ *
+ * Like addNCARVariable(), the card's variables are taken out and put back
+ * so they land in samples by rate - but once for the whole selection
+ * rather than once per variable.  A2DTEMP keeps its rate.
+ */
+void Document::setA2DVariableRates(SensorItem *sensorItem,
+                                   const QList<A2DVariableItem*> & varItems,
+                                   const std::string & a2dVarSR)
+{
+cerr<<"entering Document::setA2DVariableRates\n";
+  NidasModel *model = getModel();
+  if (!dynamic_cast<A2DSensorItem*>(sensorItem))
+    throw InternalProcessingException(
+              "Sample rates can only be set together on an ANALOG_NCAR card.");
+  if (!isNum(a2dVarSR) || atoi(a2dVarSR.c_str()) <= 0)
+    throw n_u::InvalidParameterException(
+              sensorItem->getBaseName().toStdString(), "sample rate", a2dVarSR);
+  if (varItems.isEmpty()) return;
+
+  EditJournal::Transaction tx(_journal, "Set Sample Rate");
+  tx.touch(sensorItem);
+
+  DOMNode * sensorNode = sensorItem->getDOMNode();
+  vector<A2DVariableInfo> varInfoList;
+  QModelIndexList qmIdxList;
+  for (int i = 0; i<sensorItem->childCount(); i++) {
+    A2DVariableItem *a2dvItem =
+                 dynamic_cast<A2DVariableItem*>(sensorItem->child(i));
+    if (!a2dvItem)
+      throw InternalProcessingException("Child of A2D Sensor is not A2D Variable.");
+    if (a2dvItem->variableName().compare(0,7,"A2DTEMP") == 0) continue;
+
+    A2DVariableInfo a2dvInfo = getA2DVariableInfo(a2dvItem);
+    if (varItems.contains(a2dvItem)) a2dvInfo.a2dVarSR = a2dVarSR;
+
+    // cals last "value" may be a unit indication
+    //    - if so, change it to null string
+    if (a2dvInfo.cals.size() && !isNum(a2dvInfo.cals[a2dvInfo.cals.size()-1])) {
+      a2dvInfo.a2dVarUnits = a2dvInfo.cals[a2dvInfo.cals.size()-1];
+      a2dvInfo.cals[a2dvInfo.cals.size()-1] = "";
+    }
+    varInfoList.push_back(a2dvInfo);
+    qmIdxList.push_back(a2dvItem->createIndex());
+  }
+
+  // insertA2DVariable() numbers samples in the order it meets new rates,
+  // so put them back by rate and then channel, as addNCARVariable() does
+  std::stable_sort(varInfoList.begin(), varInfoList.end(),
+                   [](const A2DVariableInfo & a, const A2DVariableInfo & b) {
+    int aSR = atoi(a.a2dVarSR.c_str()), bSR = atoi(b.a2dVarSR.c_str());
+    if (aSR != bSR) return aSR < bSR;
+    return atoi(a.a2dVarChannel.c_str()) < atoi(b.a2dVarChannel.c_str());
+  });
+
+  model->removeIndexes(qmIdxList);
+
+  InternalProcessingException* intProcEx = 0;
+  nidas::util::InvalidParameterException* InvParmEx = 0;
+  bool gotUnspEx = false;
+  for (size_t ii = 0; ii < varInfoList.size(); ii++) {
+    try {
+      insertA2DVariable(model, sensorItem, sensorNode,
+                      varInfoList[ii].a2dVarNamePfx,
+                      varInfoList[ii].a2dVarNameSfx,
+                      varInfoList[ii].a2dVarLongName,
+                      varInfoList[ii].a2dVarVolts,
+                      varInfoList[ii].a2dVarChannel,
+                      varInfoList[ii].a2dVarSR,
+                      varInfoList[ii].a2dVarUnits,
+                      varInfoList[ii].cals);
+    } catch (InternalProcessingException &e) {
+      if (!intProcEx) intProcEx = e.clone();
+    } catch (nidas::util::InvalidParameterException &e) {
+      if (!InvParmEx)
+        InvParmEx = new nidas::util::InvalidParameterException(e.toString());
+    } catch (...) {
+      gotUnspEx = true;
+    }
+  }
+  setIsChanged(true);
+
+  if (intProcEx) throw(*intProcEx);
+  if (InvParmEx) throw(*InvParmEx);
+  if (gotUnspEx)
+    throw InternalProcessingException("Document::setA2DVariableRates - unexpected error re-adding variables");
+}
+
 bool Document::isNum(std::string str)
 {
   // Determine if a string is numeric
@@ -2359,6 +2820,25 @@ bool Document::isNum(std::string str)
     return false;
 }
 
+/*!
+ * \brief The sample ids in use in \a sensorItem's sensor now.
+ *
+ * Read again from the sensor, since the edit we're in may have removed
+ * samples (addNCARVariable() takes a card's variables out and puts them
+ * back), and their ids should be used again.
+ */
+IdAllocator & Document::sampleIds(SensorItem *sensorItem)
+{
+  DSMItem *dsmItem = dynamic_cast<DSMItem*>(sensorItem->getParentItem());
+  if (!dsmItem || !dsmItem->getDSMConfig())
+    throw InternalProcessingException("Parent of SensorItem is not a DSMItem!");
+  DSMConfig *dsmConfig = dsmItem->getDSMConfig();
+  DSMSensor *sensor = sensorItem->getDSMSensor();
+  const std::string & siteName = dsmConfig->getSite()->getName();
+  _ids.sensorChanged(siteName, dsmConfig->getId(), sensor);
+  return _ids.samples(siteName, dsmConfig->getId(), sensor->getSensorId());
+}
+
 void Document::insertA2DVariable(NidasModel            *model,
                                  SensorItem            *sensorItem,
                                  DOMNode               *sensorNode,
@@ -2393,7 +2873,6 @@ std::cerr<<"\n";
     if (ist.fail()) throw n_u::InvalidParameterException(
         string("sample rate:") + a2dVarSR);
   }
-  set<unsigned int> sampleIds;
 
 // We want a sampleTag with the same sample rate as requested, but if the
 // SampleTag found is A2D temperature, we don't want it.
@@ -2404,30 +2883,20 @@ std::cerr<<"\n";
       throw InternalProcessingException
             ("Found child of A2DSensorItem that's not an A2DVariableItem!");
     SampleTag* sampleTag = variableItem->getSampleTag();
-    sampleIds.insert(sampleTag->getSampleId());
     if (sampleTag->getRate() == iSampRate)
       if  ( !sampleTag->getParameter("temperature")) sampleTag2Add2 = sampleTag;
   }
 
-set<unsigned int>::iterator it;
-cerr << "Sample IDs found: ";
-for (it=sampleIds.begin(); it!=sampleIds.end(); it++)
-    cerr << " " << *it;
-cerr << "\n";
-
   bool createdNewSamp = false;
   xercesc::DOMNode *sampleNode = 0;
   if (!sampleTag2Add2) {
     // We need a unique sample Id
-    unsigned int sampleId=0;
-    for (unsigned int i = 1; i<99; i++) {
-      pair<set<unsigned int>::iterator,bool> ret;
-      ret = sampleIds.insert(i);
-      if (ret.second == true) {
-        sampleId=i;
-        break;
-      }
-    }
+    IdAllocator & freeIds = sampleIds(sensorItem);
+    unsigned int sampleId = freeIds.next(1, 99);
+    if (sampleId == 99)
+      throw n_u::InvalidParameterException(sensorItem->devicename(),
+                "sample id", "no free sample ids below 99");
+    freeIds.reserve(sampleId);
     char sSampleId[10];
     sprintf(sSampleId,"%d",sampleId);
     DOMElement* newSampleElem = 0;
@@ -2640,32 +3109,15 @@ cerr<<"a2dVarVolts = " << a2dVarVolts <<"\n";
     // this Variable
     Site* site = const_cast<Site *> (analogSensor->getSite());
     std::string siteName = site->getName();
-    QString varPfxFileName = QString::fromStdString(a2dVarNamePfx);
-    varPfxFileName.append(".dat");
-    QString varFileName = QString::fromStdString(a2dVarName);
-    varFileName.append(".dat");
-    bool foundCalFile = false;
-    for (std::vector<QString>::iterator qit=_engCalFiles.begin();
-         qit!=_engCalFiles.end(); qit++) {
-//cerr<<(*qit).toStdString()<<"\n";
-      if (!foundCalFile) {
-        if ((*qit) == varFileName) {
-          foundCalFile = true;
-          addVarCalFileElem(a2dVarName + string(".dat"), a2dVarUnits,
-                            siteName, sampleNode, a2dVarElem);
-cerr<<"Found engineering cal file: "<<a2dVarName<<".dat\n";
-        }
-        if (*qit == varPfxFileName && !foundCalFile) {
-          foundCalFile = true;
-          addVarCalFileElem(a2dVarNamePfx + string(".dat"), a2dVarUnits,
-                            siteName, sampleNode, a2dVarElem);
-cerr<<"Found engineering cal file: "<<a2dVarNamePfx<<".dat\n";
-        }
-      }
-    }
-    if (!foundCalFile) {
+    std::string calFile =
+        _engCalFiles.findVariableCalFile(a2dVarNamePfx, a2dVarName);
+    if (!calFile.empty()) {
+      addVarCalFileElem(calFile, a2dVarUnits, siteName, sampleNode,
+                        a2dVarElem);
+cerr<<"Found engineering cal file: "<<calFile<<"\n";
+    } else {
       addMissingEngCalFile(QString::fromStdString(a2dVarName));
-cerr<<"Found neither "<<varPfxFileName.toStdString()<<" nor "<<varFileName.toStdString()<<" in Cal Dir\n";
+cerr<<"Found neither "<<a2dVarNamePfx<<".dat nor "<<a2dVarName<<".dat in Cal Dir\n";
       addVarCalFileElem(a2dVarName + string(".dat"), a2dVarUnits, siteName,
                             sampleNode, a2dVarElem);
     }
@@ -2789,7 +3241,6 @@ std::cerr<<"\n";
     if (ist.fail()) throw n_u::InvalidParameterException(
         string("sample rate:") + a2dVarSR);
   }
-  set<unsigned int> sampleIds;
 
 // We want a sampleTag with the same sample rate as requested
   for (int i=0; i< sensorItem->childCount(); i++) {
@@ -2799,30 +3250,20 @@ std::cerr<<"\n";
       throw InternalProcessingException
             ("Found child of DSC_A2DSensorItem that's not an DSC_A2DVariableItem!");
     SampleTag* sampleTag = variableItem->getSampleTag();
-    sampleIds.insert(sampleTag->getSampleId());
     if (sampleTag->getRate() == iSampRate)
       sampleTag2Add2 = sampleTag;
   }
 
-set<unsigned int>::iterator it;
-cerr << "Sample IDs found: ";
-for (it=sampleIds.begin(); it!=sampleIds.end(); it++)
-    cerr << " " << *it;
-cerr << "\n";
-
   bool createdNewSamp = false;
   xercesc::DOMNode *sampleNode = 0;
   if (!sampleTag2Add2) {
     // We need a unique sample Id
-    unsigned int sampleId=0;
-    for (unsigned int i = 1; i<99; i++) {
-      pair<set<unsigned int>::iterator,bool> ret;
-      ret = sampleIds.insert(i);
-      if (ret.second == true) {
-        sampleId=i;
-        break;
-      }
-    }
+    IdAllocator & freeIds = sampleIds(sensorItem);
+    unsigned int sampleId = freeIds.next(1, 99);
+    if (sampleId == 99)
+      throw n_u::InvalidParameterException(sensorItem->devicename(),
+                "sample id", "no free sample ids below 99");
+    freeIds.reserve(sampleId);
     char sSampleId[10];
     sprintf(sSampleId,"%d",sampleId);
     DOMElement* newSampleElem = 0;
@@ -3035,32 +3476,15 @@ cerr<<"a2dVarVolts = " << a2dVarVolts <<"\n";
     // this Variable
     Site* site = const_cast<Site *> (analogSensor->getSite());
     std::string siteName = site->getName();
-    QString varPfxFileName = QString::fromStdString(a2dVarNamePfx);
-    varPfxFileName.append(".dat");
-    QString varFileName = QString::fromStdString(a2dVarName);
-    varFileName.append(".dat");
-    bool foundCalFile = false;
-    for (std::vector<QString>::iterator qit=_engCalFiles.begin();
-         qit!=_engCalFiles.end(); qit++) {
-//cerr<<(*qit).toStdString()<<"\n";
-      if (!foundCalFile) {
-        if ((*qit) == varFileName) {
-          foundCalFile = true;
-          addVarCalFileElem(a2dVarName + string(".dat"), a2dVarUnits,
-                            siteName, sampleNode, a2dVarElem);
-cerr<<"Found engineering cal file: "<<a2dVarName<<".dat\n";
-        }
-        if (*qit == varPfxFileName && !foundCalFile) {
-          foundCalFile = true;
-          addVarCalFileElem(a2dVarNamePfx + string(".dat"), a2dVarUnits,
-                            siteName, sampleNode, a2dVarElem);
-cerr<<"Found engineering cal file: "<<a2dVarNamePfx<<".dat\n";
-        }
-      }
-    }
-    if (!foundCalFile) {
+    std::string calFile =
+        _engCalFiles.findVariableCalFile(a2dVarNamePfx, a2dVarName);
+    if (!calFile.empty()) {
+      addVarCalFileElem(calFile, a2dVarUnits, siteName, sampleNode,
+                        a2dVarElem);
+cerr<<"Found engineering cal file: "<<calFile<<"\n";
+    } else {
       addMissingEngCalFile(QString::fromStdString(a2dVarName));
-cerr<<"Found neither "<<varPfxFileName.toStdString()<<" nor "<<varFileName.toStdString()<<" in Cal Dir\n";
+cerr<<"Found neither "<<a2dVarNamePfx<<".dat nor "<<a2dVarName<<".dat in Cal Dir\n";
       addVarCalFileElem(a2dVarName + string(".dat"), a2dVarUnits, siteName,
                             sampleNode, a2dVarElem);
     }
@@ -50,6 +50,7 @@
 #include <nidas/core/Project.h>
 #include <nidas/core/SensorCatalog.h>
 
+#include "nidas_qmv/SiteItem.h"
 #include "nidas_qmv/DSMItem.h"
 #include "nidas_qmv/SensorItem.h"
 #include "nidas_qmv/ProjectItem.h"
@@ -60,6 +61,12 @@
 #include "nidas_qmv/PMSSensorItem.h"
 #include "nidas_qmv/VariableItem.h"
 
+#include "SensorCatalogIndex.h"
+#include "CalFileCatalog.h"
+#include "EditJournal.h"
+#include "LintEngine.h"
+#include "IdAllocator.h"
+
 class ConfigWindow;
 
 using namespace std;
@@ -72,13 +79,21 @@ class Document {
 public:
 
     Document(QString engCalDirRoot, ConfigWindow* cw) :
-        filename(0), _configWindow(cw), domdoc(0), 
+        _project(0), filename(0), _configWindow(cw), _model(0), domdoc(0), 
         _engCalDirExists(false), _isChanged(false), _isChangedBig(false),
-        _MIN_WING_DSM_ID(80)
+        _fastOpen(false), _fromSnapshot(false), _MIN_WING_DSM_ID(80),
+        _ids(this), _lint(this), _journal(this)
         { _engCalDirRoot = engCalDirRoot; }
     ~Document() { delete filename; };
 
     const char *getDirectory() const;
+
+    // Document normally gets its NidasModel from the ConfigWindow; when
+    // run headless (configedit --batch) there is no window and the model
+    // is handed to us here instead.
+    void setModel(NidasModel *model) { _model = model; }
+    NidasModel *getModel() const;
+
     const std::string getFilename() const { return *filename; };
     void setFilename(const std::string &f) 
          { if (filename) delete filename; filename = new std::string(f); };
@@ -86,6 +101,7 @@ public:
     xercesc::DOMDocument *getDomDocument() const { return domdoc; };
     void setDomDocument(xercesc::DOMDocument *d) { domdoc=d; };
     bool writeDocument();
+    bool saveFileCopy(const std::string & origFile);
 
     string getProjectName() const ;
     void setProjectName(string projectName);
@@ -100,11 +116,36 @@ public:
 
 
     const xercesc::DOMElement * findSensor(const std::string & sensorIdName);
+    const SensorCatalogIndex & getSensorCatalogIndex() const
+        { return _sensorCatalog; }
+
+    Project *getProject() const { return _project; }
+    // the DSM, sensor and sample ids in use, kept current as it's edited
+    IdAllocators & getIds() { return _ids; }
+    // the lint problems of this configuration, kept current as it's edited
+    LintEngine *getLintEngine() { return &_lint; }
 
     void parseFile();
+
+    // Fast open skips Xerces schema full checking in parseFile(); the
+    // caller should then check the file with validateFile() (e.g. on a
+    // background thread) to catch what that would have.
+    void setFastOpen(bool fast) { _fastOpen = fast; }
+    bool isFastOpen() const { return _fastOpen; }
+
+    // Opened from a SessionSnapshot rather than parsed: as with a fast
+    // open, the caller should check the file with validateFile().
+    bool isFromSnapshot() const { return _fromSnapshot; }
+
+    // Parse \a file with full schema validation and checking.
+    // \return an empty string if it is valid, otherwise the error.
+    static std::string validateFile(const std::string & file);
     void printSiteNames();
     vector <std::string> getSiteNames();
 
+    // These work on the model's current root item (i.e. what the user
+    // has selected in ConfigWindow).  Each has a counterpart further down
+    // that takes the item to work on explicitly.
     unsigned int getNextSensorId();
     unsigned int getNextDSMId();
     list <int> getAvailableA2DChannels();
@@ -181,7 +222,8 @@ public:
                         const std::string & a2dVarUnits, 
                         vector <std::string> cals);
 
-    void addNCARVariable(const std::string & a2dVarNamePfx,
+    void addNCARVariable(SensorItem *sensorItem,
+                        const std::string & a2dVarNamePfx,
                         const std::string & a2dVarNameSfx,
                         const std::string & a2dVarLongName,
                         const std::string & a2dVarVolts,
@@ -190,7 +232,8 @@ public:
                         const std::string & a2dVarUnits,
                         vector <std::string> cals);
 
-    void addDSCVariable(const std::string & a2dVarNamePfx,
+    void addDSCVariable(SensorItem *sensorItem,
+                        const std::string & a2dVarNamePfx,
                         const std::string & a2dVarNameSfx,
                         const std::string & a2dVarLongName,
                         const std::string & a2dVarVolts,
@@ -223,6 +266,59 @@ public:
                            const std::string     &a2dVarUnits,
                            vector <std::string>  cals);
 
+    // Edit operations on explicitly given items - these don't depend on
+    // the ConfigWindow's current root index or selection, so are what
+    // batch edits should use.
+    unsigned int getNextSensorId(DSMItem *dsmItem);
+    unsigned int getNextDSMId(SiteItem *siteItem);
+    list <int> getAvailableA2DChannels(SensorItem *sensorItem);
+
+    void addDSM(SiteItem *siteItem, const std::string & dsmName,
+                const std::string & dsmId, const std::string & dsmLocation);
+    void updateDSM(DSMItem *dsmItem,
+                   const std::string & dsmName,
+                   const std::string & dsmId,
+                   const std::string & dsmLocation);
+    void addSensor(DSMItem *dsmItem,
+                   const std::string & sensorIdName,
+                   const std::string & device,
+                   const std::string & lcId,
+                   const std::string & sfx,
+                   const std::string & a2dTempSfx,
+                   const std::string & a2dSNFname,
+                   const std::string & pmsSN,
+                   const std::string & resltn);
+    void updateSensor(SensorItem *sItem,
+                      const std::string & sensorIdName,
+                      const std::string & device,
+                      const std::string & lcId,
+                      const std::string & sfx,
+                      const std::string & a2dTempSfx,
+                      const std::string & a2dSNFname,
+                      const std::string & pmsSN,
+                      const std::string & resltn);
+    void addA2DVariable(SensorItem *sensorItem,
+                        const std::string & a2dVarNamePfx,
+                        const std::string & a2dVarNameSfx,
+                        const std::string & a2dVarLongName,
+                        const std::string & a2dVarVolts,
+                        const std::string & a2dVarChannel,
+                        const std::string & a2dSR,
+                        const std::string & a2dVarUnits,
+                        vector <std::string> cals);
+    void removeItem(NidasItem *item);
+
+    // Bulk edits on a multi-row selection.  Each is checked up front and
+    // then done as one pass: one DOM/Project update and one Qt model
+    // update, however many items it is given.
+    void removeItems(const QList<NidasItem*> & items);
+    void setA2DVariableRates(SensorItem *sensorItem,
+                             const QList<A2DVariableItem*> & varItems,
+                             const std::string & a2dVarSR);
+    void moveSensors(const QList<SensorItem*> & sensorItems,
+                     DSMItem *dsmItem);
+
+    // varItem's parent SensorItem is the one updated
     void updateVariable(VariableItem * varItem,
                         const std::string & VarName, 
                         const std::string & VarLongName,
@@ -247,6 +343,12 @@ public:
                         const std::string & pmsSN,
                         const std::string & pmsResltn);
 
+    // Every edit above is journaled: an undo step on getUndoStack(), and
+    // put back as it was if it throws.  Callers making several edits that
+    // should undo together wrap them in an EditJournal::Transaction.
+    EditJournal & getJournal() { return _journal; }
+    QUndoStack *getUndoStack() const { return _journal.getUndoStack(); }
+
     // For informing user about saving the configuration
     // changed means save in place, changedBig means that they should
     // consider a new filename (esp if done mid-project) and 
@@ -259,13 +361,17 @@ public:
     void addMissingEngCalFile(QString filename);
     bool engCalDirExists() { return _engCalDirExists; }
     QString getEngCalDir() { return _engCalDir; }
+    // the engineering cal dir's .dat files, kept current by ConfigWindow
+    CalFileCatalog & getEngCalFiles() { return _engCalFiles; }
 
 private:
 
     Project* _project;
     std::string *filename;
     const ConfigWindow* _configWindow;
+    NidasModel* _model;
     xercesc::DOMDocument *domdoc;
+    SensorCatalogIndex _sensorCatalog;
 
     // stoopid error handler for development/testing
     // can't be inner class so writeDOM can be const
@@ -302,15 +408,28 @@ private:
     };
 
     bool isNum(std::string str);
+    A2DVariableInfo getA2DVariableInfo(A2DVariableItem *a2dvItem);
+
+    IdAllocator & sampleIds(SensorItem *sensorItem);
+
+    DSMItem *currentDSMItem() const;
+    SiteItem *currentSiteItem() const;
+    SensorItem *currentSensorItem() const;
+    NidasItem *selectedItem(const QModelIndexList & indexList) const;
 
     QString _engCalDir;
     QString _engCalDirRoot;
-    std::vector <QString> _engCalFiles;
+    CalFileCatalog _engCalFiles;
     bool _engCalDirExists;
     vector <QString> _missingEngCalFiles;
     bool _isChanged;
     bool _isChangedBig;
+    bool _fastOpen;
+    bool _fromSnapshot;
     const unsigned int _MIN_WING_DSM_ID;
+    IdAllocators _ids;
+    LintEngine _lint;
+    EditJournal _journal;
 };
 
 #endif
@@ -0,0 +1,346 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+
+#include "EditJournal.h"
+#include "Document.h"
+#include "Profiler.h"
+#include "exceptions/InternalProcessingException.h"
+#include "nidas_qmv/NidasModel.h"
+#include "nidas_qmv/DOMIndex.h"
+
+#include <nidas/core/XDOM.h>
+
+#include <QUndoStack>
+
+#include <exception>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+using namespace xercesc;
+using namespace nidas::core;
+
+
+
+EditJournal::Entry::~Entry()
+{
+    for (size_t i = 0; i < dsms.size(); i++) {
+        if (dsms[i].before) dsms[i].before->release();
+        if (dsms[i].after) dsms[i].after->release();
+    }
+}
+
+EditJournal::EditJournal(Document *doc) :
+    _doc(doc), _undoStack(new QUndoStack()), _depth(0), _replaying(false),
+    _current(0)
+{
+}
+
+EditJournal::~EditJournal()
+{
+    delete _current;
+    delete _undoStack;
+}
+
+void EditJournal::begin(const QString & text)
+{
+    if (_depth++ > 0 || _replaying) return;
+
+    _current = new Entry;
+    _current->text = text;
+    _current->projectBefore = _doc->getProjectName();
+}
+
+void EditJournal::touch(NidasItem *item)
+{
+    if (!_current) return;
+    for (NidasItem *i = item; i; i = i->getParentItem()) {
+        DSMItem *dsmItem = dynamic_cast<DSMItem*>(i);
+        if (!dsmItem) continue;
+        DSMConfig *dsm = dsmItem->getDSMConfig();
+        if (!dsm || !dsm->getSite()) return;
+        touchDSM(dsm->getSite()->getName(), dsm->getId());
+        return;
+    }
+}
+
+void EditJournal::touchDSM(const std::string & siteName, unsigned int dsmId)
+{
+    if (!_current) return;
+    for (size_t i = 0; i < _current->dsms.size(); i++)
+        if (_current->dsms[i].siteName == siteName &&
+            _current->dsms[i].dsmId == dsmId) return;
+
+    DSMImage image;
+    image.siteName = siteName;
+    image.dsmId = dsmId;
+    image.before = copyDSM(siteName, dsmId, image.beforePos);
+    image.after = 0;
+    image.afterPos = -1;
+    _current->dsms.push_back(image);
+}
+
+void EditJournal::commit()
+{
+    if (_depth == 0) return;
+    if (--_depth > 0 || !_current) return;
+
+    ProfileScope ps("EditJournal::commit");
+    Entry *entry = _current;
+    _current = 0;
+
+    entry->projectAfter = _doc->getProjectName();
+    bool changed = (entry->projectAfter != entry->projectBefore);
+
+    // keep just the DSMs that did change
+    vector<DSMImage> & dsms = entry->dsms;
+    for (size_t i = 0; i < dsms.size(); ) {
+        DSMImage & image = dsms[i];
+        DOMElement *now = findDSM(image.siteName, image.dsmId);
+        if ((!image.before && !now) ||
+            (image.before && now && image.before->isEqualNode(now))) {
+            if (image.before) image.before->release();
+            dsms.erase(dsms.begin() + i);
+            continue;
+        }
+        image.after = copyDSM(image.siteName, image.dsmId, image.afterPos);
+        i++;
+    }
+    if (!changed && dsms.empty()) {
+        delete entry;
+        return;
+    }
+    _undoStack->push(new EditCommand(this, entry));
+
+    for (size_t i = 0; i < dsms.size(); i++) {
+        _doc->getIds().dsmChanged(dsms[i].siteName, dsms[i].dsmId);
+        _doc->getLintEngine()->dsmChanged(dsms[i].siteName, dsms[i].dsmId);
+    }
+}
+
+void EditJournal::rollback()
+{
+    if (_depth == 0) return;
+    if (--_depth > 0 || !_current) return;
+
+    Entry *entry = _current;
+    _current = 0;
+
+    // Edits that already put things back in their catch blocks leave
+    // nothing to do here, and the items of those DSMs (which a dialog
+    // kept up for another try may still hold) are left alone.
+    vector<DSMImage> & dsms = entry->dsms;
+    for (size_t i = 0; i < dsms.size(); ) {
+        DOMElement *now = findDSM(dsms[i].siteName, dsms[i].dsmId);
+        DOMElement *before = dsms[i].before;
+        if ((!before && !now) || (before && now && before->isEqualNode(now))) {
+            // ids the edit reserved before it failed
+            _doc->getIds().dsmChanged(dsms[i].siteName, dsms[i].dsmId);
+            if (before) before->release();
+            dsms.erase(dsms.begin() + i);
+        }
+        else i++;
+    }
+    try {
+        if (!dsms.empty() || entry->projectBefore != _doc->getProjectName())
+            apply(*entry, true);
+    } catch (const nidas::util::Exception & e) {
+        cerr << "EditJournal::rollback failed: " << e.toString() << "\n";
+    } catch (...) {
+        cerr << "EditJournal::rollback failed\n";
+    }
+    delete entry;
+}
+
+EditJournal::Transaction::~Transaction()
+{
+    if (std::uncaught_exception()) _journal.rollback();
+    else _journal.commit();
+}
+
+/*!
+ * \brief Put the document back as it was before (\a undo) or after
+ *        \a entry.
+ *
+ * All the DSMs in the entry are removed first and then those in the
+ * wanted state put back, so a DSM whose id was changed never exists
+ * twice.
+ */
+void EditJournal::apply(const Entry & entry, bool undo)
+{
+    ProfileScope ps("EditJournal::apply");
+    _replaying = true;
+    try {
+        for (size_t i = 0; i < entry.dsms.size(); i++)
+            restoreDSM(entry.dsms[i].siteName, entry.dsms[i].dsmId, 0, -1);
+        for (size_t i = 0; i < entry.dsms.size(); i++) {
+            const DSMImage & image = entry.dsms[i];
+            if (undo && image.before)
+                restoreDSM(image.siteName, image.dsmId,
+                           image.before, image.beforePos);
+            else if (!undo && image.after)
+                restoreDSM(image.siteName, image.dsmId,
+                           image.after, image.afterPos);
+        }
+
+        const std::string & name =
+                undo ? entry.projectBefore : entry.projectAfter;
+        if (!name.empty() && name != _doc->getProjectName())
+            _doc->setProjectName(name);
+    } catch (...) {
+        _replaying = false;
+        throw;
+    }
+    _replaying = false;
+    _doc->setIsChangedBig(true);
+
+    for (size_t i = 0; i < entry.dsms.size(); i++) {
+        const DSMImage & image = entry.dsms[i];
+        _doc->getIds().dsmChanged(image.siteName, image.dsmId);
+        _doc->getLintEngine()->dsmChanged(image.siteName, image.dsmId);
+    }
+}
+
+/*!
+ * \brief A copy of DSM \a dsmId's element in the DOM, or 0 if there is
+ *        none.  \a pos is set to its index among its parent's children.
+ */
+DOMElement *EditJournal::copyDSM(const std::string & siteName,
+                                 unsigned int dsmId, int & pos)
+{
+    pos = -1;
+    DOMElement *elem = findDSM(siteName, dsmId);
+    if (!elem) return 0;
+
+    pos = 0;
+    for (DOMNode *n = elem->getPreviousSibling(); n; n = n->getPreviousSibling())
+        pos++;
+    return (DOMElement *) elem->cloneNode(true);
+}
+
+DOMElement *EditJournal::findDSM(const std::string & siteName,
+                                 unsigned int dsmId)
+{
+    return _doc->getModel()->getDOMIndex()->dsm(siteName, dsmId);
+}
+
+SiteItem *EditJournal::findSiteItem(const std::string & siteName)
+{
+    NidasItem *projectItem = _doc->getModel()->getRootItem();
+    for (int i = 0; i < projectItem->childCount(); i++) {
+        SiteItem *siteItem = dynamic_cast<SiteItem*>(projectItem->child(i));
+        if (siteItem && siteItem->getSite()->getName() == siteName)
+            return siteItem;
+    }
+    throw InternalProcessingException("EditJournal: no site " + siteName);
+}
+
+/*!
+ * \brief Make DSM \a dsmId of \a siteName what \a image is: remove it if
+ *        it's there and then, unless \a image is 0, put a copy of \a image
+ *        back at \a pos among the site's DOM children.
+ *
+ * The DSMConfig is rebuilt from the element as Document::addDSM() does
+ * and the model told of the one new row.
+ */
+void EditJournal::restoreDSM(const std::string & siteName, unsigned int dsmId,
+                             const DOMElement *image, int pos)
+{
+    NidasModel *model = _doc->getModel();
+    SiteItem *siteItem = findSiteItem(siteName);
+    Site *site = siteItem->getSite();
+
+    if (!image) {
+        for (int i = 0; i < siteItem->childCount(); i++) {
+            DSMItem *dsmItem = dynamic_cast<DSMItem*>(siteItem->child(i));
+            if (!dsmItem || dsmItem->getDSMConfig()->getId() != dsmId) continue;
+            QModelIndexList indexList;
+            indexList.append(dsmItem->createIndex());
+            if (!model->removeIndexes(indexList))
+                throw InternalProcessingException(
+                        "EditJournal: could not remove dsm " + dsmItem->name().toStdString());
+            break;
+        }
+        return;
+    }
+
+    DOMNode *siteNode = siteItem->getDOMNode();
+    if (!siteNode)
+        throw InternalProcessingException("null site DOM node");
+
+    DOMElement *elem = (DOMElement *) image->cloneNode(true);
+    DOMNodeList *siteChildren = siteNode->getChildNodes();
+    DOMNode *refChild = 0;
+    if (pos >= 0 && (XMLSize_t) pos < siteChildren->getLength())
+        refChild = siteChildren->item(pos);
+    siteNode->insertBefore(elem, refChild);
+    model->getDOMIndex()->add(elem);
+
+    XDOMElement xelem(elem);
+    DSMConfig *dsm = new DSMConfig();
+    dsm->setSite(site);
+    dsm->setName(xelem.getAttributeValue("name"));
+    dsm->setId(dsmId);
+    dsm->setLocation(xelem.getAttributeValue("location"));
+    try {
+        dsm->fromDOMElement(elem);
+    } catch (...) {
+        delete dsm;
+        model->getDOMIndex()->remove(elem);
+        siteNode->removeChild(elem)->release();
+        throw;
+    }
+
+    // The DSM goes back where its element is among the site's <dsm>
+    // elements, in the Project and model as in the DOM that is saved.
+    int row = 0;
+    for (DOMNode *n = elem->getPreviousSibling(); n; n = n->getPreviousSibling())
+        if (n->getNodeType() == DOMNode::ELEMENT_NODE &&
+            XDOMElement((DOMElement *) n).getNodeName() == "dsm") row++;
+
+    const list<DSMConfig*> & dsms = site->getDSMConfigs();
+    list<DSMConfig*>::const_iterator di = dsms.begin();
+    for (int i = 0; i < row && di != dsms.end(); i++) ++di;
+    vector<DSMConfig*> after(di, dsms.end());
+    for (size_t i = 0; i < after.size(); i++) site->removeDSMConfig(after[i]);
+    site->addDSMConfig(dsm);
+    for (size_t i = 0; i < after.size(); i++) site->addDSMConfig(after[i]);
+
+    if (row <= siteItem->builtChildCount())
+        model->insertChild(siteItem, row,
+                           new DSMItem(dsm, row, model, siteItem));
+    // else its item is built from the Project with the rest
+}
+
+void EditCommand::redo()
+{
+    // QUndoStack::push() calls redo(), but the edit's already been made
+    if (!_pushed) {
+        _pushed = true;
+        return;
+    }
+    _journal->apply(*_entry, false);
+}
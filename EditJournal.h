@@ -0,0 +1,186 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+/*
+ * EditJournal.h
+ *  undo/redo and rollback of Document edits
+ */
+
+#ifndef _EditJournal_h
+#define _EditJournal_h
+
+#include <xercesc/dom/DOMElement.hpp>
+
+#include <QString>
+#include <QUndoCommand>
+
+#include <string>
+#include <vector>
+
+class Document;
+class NidasItem;
+class SiteItem;
+class QUndoStack;
+
+
+/*!
+ * \brief Journal of the edits made to a Document, as deltas of the DSMs
+ *        they changed.
+ *
+ * An edit runs inside a transaction.  Before a DSM is first changed the
+ * transaction is told about it (touch()) and keeps a copy of the DSM's
+ * DOM element; on commit it copies the element again, and the pair is
+ * pushed on the undo stack.  Undo and redo put the DSM back from one
+ * copy or the other: just that DSM's DOM element, DSMConfig and NidasItems
+ * are rebuilt, and the file is never reparsed.  A DSM copied as absent
+ * (being added, or removed) is removed, or put back, accordingly.  The
+ * project name is journaled along with the DSMs.
+ *
+ * Transactions nest: an edit made by another edit (e.g. a dialog that
+ * removes a variable and adds it back) joins the outer transaction and
+ * the whole is one undo step.  If the outermost transaction ends with an
+ * exception, every DSM it touched is put back as it was before.
+ *
+ * Undo steps are QUndoCommands on getUndoStack(), so the GUI can offer
+ * them through a QUndoStack or QUndoGroup's actions.
+ */
+class EditJournal {
+
+public:
+
+    EditJournal(Document *doc);
+    ~EditJournal();
+
+    QUndoStack *getUndoStack() const { return _undoStack; }
+
+    /*!
+     * \brief Open a transaction, or join the one already open.
+     *        \a text names the undo step.
+     */
+    void begin(const QString & text);
+
+    /// Record the DSM \a item is in (or is) before it is changed.
+    void touch(NidasItem *item);
+
+    /// Record DSM \a dsmId of \a siteName, which may not exist yet.
+    void touchDSM(const std::string & siteName, unsigned int dsmId);
+
+    /// Close a transaction; the outermost pushes the undo step.
+    void commit();
+
+    /// Close a transaction; the outermost puts everything back.
+    void rollback();
+
+    bool isOpen() const { return _depth > 0; }
+
+    /*!
+     * \brief A transaction for the life of a scope.  It commits when the
+     *        scope is left normally and rolls back when left by an
+     *        exception.
+     */
+    class Transaction {
+    public:
+        Transaction(EditJournal & journal, const QString & text) :
+            _journal(journal) { _journal.begin(text); }
+        ~Transaction();
+        void touch(NidasItem *item) { _journal.touch(item); }
+        void touchDSM(const std::string & siteName, unsigned int dsmId)
+            { _journal.touchDSM(siteName, dsmId); }
+    private:
+        EditJournal & _journal;
+        Transaction(const Transaction &);
+        Transaction & operator=(const Transaction &);
+    };
+
+    /// A DSM's DOM element (0 if absent) and its place among its siblings.
+    struct DSMImage {
+        std::string siteName;
+        unsigned int dsmId;
+        xercesc::DOMElement *before;
+        int beforePos;
+        xercesc::DOMElement *after;
+        int afterPos;
+    };
+
+    struct Entry {
+        QString text;
+        std::vector<DSMImage> dsms;
+        std::string projectBefore;
+        std::string projectAfter;
+        ~Entry();
+    };
+
+    /// Put the document back to before (\a undo) or after \a entry.
+    void apply(const Entry & entry, bool undo);
+
+private:
+
+    xercesc::DOMElement *findDSM(const std::string & siteName,
+                                 unsigned int dsmId);
+    xercesc::DOMElement *copyDSM(const std::string & siteName,
+                                 unsigned int dsmId, int & pos);
+    SiteItem *findSiteItem(const std::string & siteName);
+    void restoreDSM(const std::string & siteName, unsigned int dsmId,
+                    const xercesc::DOMElement *image, int pos);
+
+    Document *_doc;
+    QUndoStack *_undoStack;
+
+    int _depth;
+    bool _replaying;    // in apply(): don't journal what it does
+    Entry *_current;
+
+    // No copying
+    EditJournal(const EditJournal &);
+    EditJournal & operator=(const EditJournal &);
+};
+
+
+/*!
+ * \brief One journal entry on a QUndoStack.
+ *
+ * The edit has been made by the time it's pushed, so the push's redo()
+ * does nothing.
+ */
+class EditCommand : public QUndoCommand {
+
+public:
+
+    EditCommand(EditJournal *journal, EditJournal::Entry *entry) :
+        QUndoCommand(entry->text), _journal(journal), _entry(entry),
+        _pushed(false) {}
+    ~EditCommand() { delete _entry; }
+
+    void undo() { _journal->apply(*_entry, true); }
+    void redo();
+
+private:
+
+    EditJournal *_journal;
+    EditJournal::Entry *_entry;
+    bool _pushed;
+};
+
+#endif
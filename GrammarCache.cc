@@ -0,0 +1,294 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+
+#include "GrammarCache.h"
+#include "MappedFileCache.h"
+#include "Profiler.h"
+
+#include <nidas/core/XMLParser.h>
+#include <nidas/util/Exception.h>
+
+#if XERCES_VERSION_MAJOR >= 3
+#include <xercesc/dom/DOMImplementationLS.hpp>
+#include <xercesc/framework/Wrapper4InputSource.hpp>
+#include <xercesc/internal/XMLGrammarPoolImpl.hpp>
+#include <xercesc/util/PlatformUtils.hpp>
+#include <xercesc/util/XMLUni.hpp>
+#endif
+
+#include <sys/stat.h>
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+using namespace xercesc;
+using namespace nidas::core;
+
+
+GrammarCache * GrammarCache::getInstance()
+{
+  // Never deleted: the pool must not be released after the xerces
+  // XMLPlatformUtils::Terminate() that ConfigWindow/BatchEditor do.
+  static GrammarCache * instance = new GrammarCache();
+  return instance;
+}
+
+#if XERCES_VERSION_MAJOR < 3
+
+// No grammar pools for DOM parsers before xerces 3, parse as nidas does.
+
+GrammarCache::GrammarCache()
+{
+}
+
+GrammarCache::~GrammarCache()
+{
+}
+
+xercesc::DOMDocument * GrammarCache::parse(const std::string & file,
+                                           bool fullChecking)
+{
+  XMLParser parser;
+
+  parser.setDOMValidation(true);
+  parser.setDOMValidateIfSchema(true);
+  parser.setDOMNamespaces(true);
+  parser.setXercesSchema(true);
+  parser.setXercesSchemaFullChecking(fullChecking);
+  parser.setDOMDatatypeNormalization(false);
+  parser.setXercesHandleMultipleImports(true);
+  parser.setXercesDoXInclude(true);
+  parser.setXercesUserAdoptsDOMDocument(true);
+
+  return parser.parse(file);
+}
+
+xercesc::DOMDocument * GrammarCache::parseUncached(const std::string & file)
+{
+  return parse(file, true);
+}
+
+#else
+
+GrammarCache::Pool::Pool() : pool(0), locked(false)
+{
+  // makes sure xerces is initialized before the pool is made
+  XMLImplementation::getImplementation();
+  pool = new XMLGrammarPoolImpl(XMLPlatformUtils::fgMemoryManager);
+}
+
+GrammarCache::Pool::~Pool()
+{
+  delete pool;
+}
+
+GrammarCache::GrammarCache()
+{
+}
+
+GrammarCache::~GrammarCache()
+{
+  for (map<string, Pool*>::iterator pi = _pools.begin();
+       pi != _pools.end(); ++pi)
+    delete pi->second;
+}
+
+/**
+ * Which schema \a file is validated against: the file its root element's
+ * (noNamespace)schemaLocation names, resolved against the directory of
+ * \a file, and that file's modification time.  Empty if it can't be
+ * told, e.g. there's no schemaLocation or the schema isn't there.
+ */
+std::string GrammarCache::schemaKey(const std::string & file)
+{
+  static const string attrName = "chemaLocation";   // [noNamespace]S...
+
+  std::shared_ptr<const MappedFile> mapped;
+  try {
+    mapped.reset(new MappedFile(file));
+  }
+  catch (const nidas::util::Exception &) {
+    return string();      // the parse will say why
+  }
+  const char * data = (const char *) mapped->data();
+  const char * end = data + mapped->size();
+
+  const char * p = search(data, end, attrName.begin(), attrName.end());
+  if (p == end) return string();
+  p += attrName.size();
+  while (p < end && isspace((unsigned char) *p)) p++;
+  if (p == end || *p++ != '=') return string();
+  while (p < end && isspace((unsigned char) *p)) p++;
+  if (p == end || (*p != '"' && *p != '\'')) return string();
+  const char * valEnd = find(p + 1, end, *p);
+  if (valEnd == end) return string();
+
+  // schemaLocation is namespace/location pairs: nidas' has the one
+  istringstream value(string(p + 1, valEnd));
+  string loc, word;
+  while (value >> word) loc = word;
+
+  if (loc.compare(0, 7, "file://") == 0) loc.erase(0, 7);
+  else if (loc.find("://") != string::npos) return loc;
+  if (loc.empty()) return string();
+  if (loc[0] != '/') {
+    size_t slash = file.rfind('/');
+    if (slash != string::npos) loc = file.substr(0, slash + 1) + loc;
+  }
+
+  struct stat st;
+  if (stat(loc.c_str(), &st) < 0) return string();
+  ostringstream key;
+  key << loc << '@' << st.st_mtim.tv_sec << '.' << st.st_mtim.tv_nsec;
+  return key.str();
+}
+
+/**
+ * A DOM parser on \a pool (the shared one, or 0 for one of its own) set
+ * up as nidas' XMLParser sets up its own.  With \a cacheGrammar the
+ * grammars it loads go into the pool, otherwise it only uses those
+ * already there.
+ */
+DOMLSParser * GrammarCache::createParser(bool fullChecking, bool cacheGrammar,
+                                         XMLGrammarPool * pool)
+{
+  DOMImplementationLS * impl =
+      (DOMImplementationLS *) XMLImplementation::getImplementation();
+  DOMLSParser * parser =
+      impl->createLSParser(DOMImplementationLS::MODE_SYNCHRONOUS, 0,
+                           XMLPlatformUtils::fgMemoryManager, pool);
+
+  DOMConfiguration * config = parser->getDomConfig();
+  config->setParameter(XMLUni::fgDOMValidate, true);
+  config->setParameter(XMLUni::fgDOMValidateIfSchema, true);
+  config->setParameter(XMLUni::fgDOMNamespaces, true);
+  config->setParameter(XMLUni::fgXercesSchema, true);
+  config->setParameter(XMLUni::fgXercesSchemaFullChecking, fullChecking);
+  config->setParameter(XMLUni::fgDOMDatatypeNormalization, false);
+  config->setParameter(XMLUni::fgXercesHandleMultipleImports, true);
+  config->setParameter(XMLUni::fgXercesDoXInclude, true);
+  config->setParameter(XMLUni::fgXercesUserAdoptsDOMDocument, true);
+
+  // XIncluded files come mapped from the cache rather than being re-read
+  config->setParameter(XMLUni::fgXercesEntityResolver,
+                       (XMLEntityResolver *) MappedFileCache::getInstance());
+
+  config->setParameter(XMLUni::fgXercesUseCachedGrammarInParse, pool != 0);
+  config->setParameter(XMLUni::fgXercesCacheGrammarFromParse, cacheGrammar);
+
+  return parser;
+}
+
+xercesc::DOMDocument * GrammarCache::parse(const std::string & file,
+                                           bool fullChecking)
+{
+  ProfileScope profile("GrammarCache::parse");
+
+  string key = schemaKey(file);
+  if (key.empty()) {
+    // can't tell which grammars would be right, so use none
+    Profiler::getInstance()->count("unpooled grammar parses");
+    return parse(createParser(fullChecking, false, 0), file);
+  }
+
+  Pool * pool;
+  {
+    QMutexLocker locker(&_mutex);
+    Pool * & p = _pools[key];
+    if (!p) p = new Pool();
+    pool = p;
+  }
+
+  // Until there are grammars in the pool, parses take turns with it.
+  // Only a fully checked parse fills it, so that a fast open doesn't
+  // leave an unchecked schema cached (and the background validation
+  // after it repeating the same unchecked parse).  After that the pool
+  // is locked and nothing more is written to it.
+  QMutexLocker locker(&pool->mutex);
+  bool locked = pool->locked;
+  bool cacheGrammar = !locked && fullChecking;
+  if (locked) {
+    locker.unlock();
+    Profiler::getInstance()->count("cached grammar parses");
+  }
+
+  xercesc::DOMDocument * doc =
+      parse(createParser(cacheGrammar, cacheGrammar, pool->pool), file);
+
+  if (cacheGrammar && doc) {
+    bool haveGrammar;
+    {
+      RefHashTableOfEnumerator<Grammar> grammars =
+          pool->pool->getGrammarEnumerator();
+      haveGrammar = grammars.hasMoreElements();
+    }
+    if (haveGrammar) {
+      pool->pool->lockPool();
+      pool->locked = true;
+      cerr << "schema grammar " << key << " cached for later parses" << endl;
+    }
+  }
+  return doc;
+}
+
+xercesc::DOMDocument * GrammarCache::parseUncached(const std::string & file)
+{
+  ProfileScope profile("GrammarCache::parseUncached");
+  return parse(createParser(true, false, 0), file);
+}
+
+/**
+ * Parse \a file with \a parser, which is released.
+ */
+xercesc::DOMDocument * GrammarCache::parse(DOMLSParser * parser,
+                                           const std::string & file)
+{
+  XMLErrorHandler errorHandler;
+  parser->getDomConfig()->setParameter(XMLUni::fgDOMErrorHandler,
+                                       &errorHandler);
+
+  xercesc::DOMDocument * doc = 0;
+  try {
+    Wrapper4InputSource input(MappedFileCache::getInstance()->open(file));
+    doc = parser->parse(&input);
+  }
+  catch (...) {
+    parser->release();
+    throw;
+  }
+  parser->release();
+
+  const nidas::core::XMLException * xe = errorHandler.getXMLException();
+  if (xe) {
+    if (doc) doc->release();
+    throw *xe;
+  }
+  return doc;
+}
+
+#endif
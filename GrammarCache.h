@@ -0,0 +1,124 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+#ifndef _GRAMMAR_CACHE_H
+#define _GRAMMAR_CACHE_H
+
+#include <xercesc/dom/DOMDocument.hpp>
+#include <xercesc/util/XercesVersion.hpp>
+
+#if XERCES_VERSION_MAJOR >= 3
+#include <xercesc/dom/DOMLSParser.hpp>
+#include <xercesc/framework/XMLGrammarPool.hpp>
+#endif
+
+#include <QMutex>
+
+#include <map>
+#include <string>
+
+
+/**
+ * Parses configuration files against schema grammars that are compiled
+ * once per session.
+ *
+ * nidas' XMLParser loads and compiles nidas.xsd for every file it
+ * parses, which is much of the cost of opening a configuration.  Here
+ * there is a Xerces grammar pool for each schema file, as named by the
+ * configuration's schemaLocation (resolved against its directory) and
+ * at its current modification time.  The first file parsed with schema
+ * full checking against a schema caches the grammars it loads, after
+ * which that pool is locked and later parses naming the same schema
+ * (re-opens, other projects sharing it) use the compiled grammars as
+ * they are.  A project with a schema of its own, or a schema edited
+ * since, gets a pool of its own.  Parses without full checking (fast
+ * opens) don't fill a pool, so the background validation that follows
+ * one still checks the schema.  Files whose schema can't be found from
+ * the file itself are parsed without a pool, as parseUncached() does.
+ *
+ * A locked pool is read only, so parses may run on several threads at
+ * once; only the parse that fills a pool is serialized.
+ */
+class GrammarCache {
+
+public:
+
+  static GrammarCache * getInstance();
+
+  /**
+   * Parse and validate \a file as nidas' XMLParser would with DOM
+   * validation, schema processing, multiple imports and XInclude on.
+   * Schema full checking is done only when \a fullChecking and the
+   * grammar of the schema \a file names has not already been cached (it
+   * checks the schema itself, not the file); such a parse is what caches
+   * it.  The caller adopts and must release() the document.
+   *
+   * The file and any it XIncludes are read through MappedFileCache
+   * (xerces 3 and later).
+   *
+   * \throw nidas::core::XMLException on parse or validation errors,
+   *        nidas::util::IOException if \a file can't be read.
+   */
+  xercesc::DOMDocument * parse(const std::string & file, bool fullChecking);
+
+  /**
+   * Parse and validate \a file as parse() does, with schema full
+   * checking, but on a parser of its own that neither uses nor fills
+   * the session's grammar pools (e.g. when auditing years of projects,
+   * whose schemas are mostly each used once).
+   */
+  xercesc::DOMDocument * parseUncached(const std::string & file);
+
+private:
+
+  GrammarCache();
+  ~GrammarCache();
+
+#if XERCES_VERSION_MAJOR >= 3
+  xercesc::DOMLSParser * createParser(bool fullChecking, bool cacheGrammar,
+                                      xercesc::XMLGrammarPool * pool);
+  xercesc::DOMDocument * parse(xercesc::DOMLSParser * parser,
+                               const std::string & file);
+
+  static std::string schemaKey(const std::string & file);
+
+  struct Pool {
+    Pool();
+    ~Pool();
+    xercesc::XMLGrammarPool * pool;
+    QMutex mutex;       // held while the pool is being filled
+    bool locked;        // grammars cached, pool read only
+  };
+
+  QMutex _mutex;        // guards _pools
+  std::map<std::string, Pool*> _pools;  // by schemaKey()
+#endif
+
+  // No copying
+  GrammarCache(const GrammarCache &);
+  GrammarCache & operator=(const GrammarCache &);
+};
+
+#endif
@@ -0,0 +1,177 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+
+#include "IdAllocator.h"
+#include "Document.h"
+#include "Profiler.h"
+
+#include <nidas/core/Project.h>
+#include <nidas/core/Site.h>
+#include <nidas/core/DSMConfig.h>
+#include <nidas/core/DSMSensor.h>
+
+using namespace std;
+using namespace nidas::core;
+
+
+void IdAllocator::set(vector<uint64_t> & bits, unsigned int i, bool on)
+{
+    if (i / 64 >= bits.size()) {
+        if (!on) return;
+        bits.resize(i / 64 + 1, 0);
+    }
+    if (on) bits[i / 64] |= uint64_t(1) << (i % 64);
+    else bits[i / 64] &= ~(uint64_t(1) << (i % 64));
+}
+
+/// The first clear bit in [\a from, \a to), or \a to.
+unsigned int IdAllocator::firstClear(const vector<uint64_t> & bits,
+                                     unsigned int from, unsigned int to)
+{
+    for (unsigned int i = from; i < to; ) {
+        size_t w = i / 64;
+        if (w >= bits.size()) return i;     // never set
+        uint64_t clear = ~bits[w] >> (i % 64);
+        if (clear) {
+            unsigned int found = i + __builtin_ctzll(clear);
+            return found < to ? found : to;
+        }
+        i = (w + 1) * 64;
+    }
+    return to;
+}
+
+bool IdAllocator::reserve(unsigned int id)
+{
+    if (isUsed(id)) return false;
+    set(_ids, id, true);
+    if (_stride > 1) {
+        unsigned int block = id / _stride;
+        if (block >= _blockCounts.size()) _blockCounts.resize(block + 1, 0);
+        if (_blockCounts[block]++ == 0) set(_blocks, block, true);
+    }
+    return true;
+}
+
+void IdAllocator::release(unsigned int id)
+{
+    if (!isUsed(id)) return;
+    set(_ids, id, false);
+    if (_stride > 1) {
+        unsigned int block = id / _stride;
+        if (--_blockCounts[block] == 0) set(_blocks, block, false);
+    }
+}
+
+unsigned int IdAllocator::next(unsigned int first, unsigned int end) const
+{
+    if (_stride == 1) return firstClear(_ids, first, end);
+
+    unsigned int from = (first + _stride - 1) / _stride;
+    unsigned int to = (end + _stride - 1) / _stride;
+    unsigned int block = firstClear(_blocks, from, to);
+    return block < to ? block * _stride : end;
+}
+
+void IdAllocator::clear()
+{
+    _ids.clear();
+    _blocks.clear();
+    _blockCounts.clear();
+}
+
+void IdAllocators::build()
+{
+    ProfileScope ps("IdAllocators::build");
+    _sites.clear();
+    Project *project = _doc->getProject();
+    if (!project) return;
+    for (SiteIterator si = project->getSiteIterator(); si.hasNext(); )
+        addSite(si.next());
+}
+
+void IdAllocators::addSite(Site *site)
+{
+    SiteIds & siteIds = _sites[site->getName()];
+    const list<DSMConfig*> & dsms = site->getDSMConfigs();
+    for (list<DSMConfig*>::const_iterator di = dsms.begin();
+         di != dsms.end(); ++di)
+        addDSM(siteIds, *di);
+}
+
+void IdAllocators::addDSM(SiteIds & siteIds, DSMConfig *dsm)
+{
+    siteIds.dsms.reserve(dsm->getId());
+    DSMIds & dsmIds = siteIds.dsmIds[dsm->getId()];
+    for (SensorIterator si = dsm->getSensorIterator(); si.hasNext(); ) {
+        DSMSensor *sensor = si.next();
+        dsmIds.sensors.reserve(sensor->getSensorId());
+        addSamples(dsmIds.samples[sensor->getSensorId()], sensor);
+    }
+}
+
+void IdAllocators::addSamples(IdAllocator & samples, DSMSensor *sensor)
+{
+    for (SampleTagIterator ti = sensor->getSampleTagIterator(); ti.hasNext(); )
+        samples.reserve(ti.next()->getSampleId());
+}
+
+void IdAllocators::sensorChanged(const string & siteName, unsigned int dsmId,
+                                 DSMSensor *sensor)
+{
+    IdAllocator & ids = samples(siteName, dsmId, sensor->getSensorId());
+    ids.clear();
+    addSamples(ids, sensor);
+}
+
+void IdAllocators::dsmChanged(const string & siteName, unsigned int dsmId)
+{
+    Profiler::getInstance()->count("id allocator DSM updates");
+
+    Project *project = _doc->getProject();
+    if (!project) return;
+    Site *site = 0;
+    for (SiteIterator si = project->getSiteIterator(); si.hasNext(); ) {
+        Site *s = si.next();
+        if (s->getName() == siteName) { site = s; break; }
+    }
+    if (!site) {
+        _sites.erase(siteName);
+        return;
+    }
+
+    // the site's DSM ids, which an added or removed DSM changes, and
+    // the changed DSM's own
+    SiteIds & siteIds = _sites[siteName];
+    siteIds.dsms.clear();
+    siteIds.dsmIds.erase(dsmId);
+    const list<DSMConfig*> & dsms = site->getDSMConfigs();
+    for (list<DSMConfig*>::const_iterator di = dsms.begin();
+         di != dsms.end(); ++di) {
+        if ((*di)->getId() == dsmId) addDSM(siteIds, *di);
+        else siteIds.dsms.reserve((*di)->getId());
+    }
+}
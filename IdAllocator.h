@@ -0,0 +1,162 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+/*
+ * IdAllocator.h
+ *  bitsets of the DSM, sensor and sample ids in use, kept per scope
+ */
+
+#ifndef _IdAllocator_h
+#define _IdAllocator_h
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+class Document;
+
+namespace nidas { namespace core {
+class Site;
+class DSMConfig;
+class DSMSensor;
+} }
+
+
+/*!
+ * \brief The ids in use in one scope (the DSMs of a site, the sensors
+ *        of a DSM or the samples of a sensor) as a bitset.
+ *
+ * isUsed(), reserve() and release() are a bit test or flip.  Ids can be
+ * handed out in blocks of \a stride: sensor ids go up by 200 so that a
+ * sensor's sample ids, which are added to it, stay clear of the next
+ * sensor's.  next() finds the lowest block with no id in it, so gaps
+ * left by removals are used again, scanning 64 blocks per word.
+ */
+class IdAllocator {
+
+public:
+
+    IdAllocator(unsigned int stride = 1) : _stride(stride) {}
+
+    bool isUsed(unsigned int id) const { return test(_ids, id); }
+
+    /// Mark \a id used; false if it already was.
+    bool reserve(unsigned int id);
+
+    void release(unsigned int id);
+
+    /*!
+     * \brief The lowest multiple of the stride in [\a first, \a end)
+     *        whose block holds no id, or \a end if there is none.
+     */
+    unsigned int next(unsigned int first, unsigned int end) const;
+
+    void clear();
+
+private:
+
+    static bool test(const std::vector<uint64_t> & bits, unsigned int i)
+    {
+        return i / 64 < bits.size() && (bits[i / 64] >> (i % 64)) & 1;
+    }
+    static void set(std::vector<uint64_t> & bits, unsigned int i, bool on);
+    static unsigned int firstClear(const std::vector<uint64_t> & bits,
+                                   unsigned int from, unsigned int to);
+
+    unsigned int _stride;
+    std::vector<uint64_t> _ids;
+
+    // with a stride of more than one: the blocks with ids in them, and
+    // how many each has
+    std::vector<uint64_t> _blocks;
+    std::vector<unsigned int> _blockCounts;
+};
+
+/*!
+ * \brief The IdAllocators of a Document's Project: DSM ids per site,
+ *        sensor ids per DSM and sample ids per sensor.
+ *
+ * build() fills them once the file is parsed.  EditJournal then reports
+ * each DSM an edit, undo or redo changed (dsmChanged()) and just that
+ * DSM, and its site's DSM ids, are read again.  An edit that hands out
+ * several ids before it commits reserve()s each as it goes; one that
+ * also removes things first reads what is left with sensorChanged().
+ */
+class IdAllocators {
+
+public:
+
+    // DSM ids are 10 bits, and a sensor id plus sample id 16
+    static const unsigned int DSMIdEnd = 1024;
+    static const unsigned int ShortIdEnd = 65536;
+    static const unsigned int SensorIdStride = 200;
+
+    IdAllocators(Document *doc) : _doc(doc) {}
+
+    void build();
+
+    /// DSM \a dsmId of \a siteName was edited, added or removed.
+    void dsmChanged(const std::string & siteName, unsigned int dsmId);
+
+    /*!
+     * \brief Read \a sensor's sample ids again, e.g. in the middle of an
+     *        edit that has removed some of its samples and is adding others.
+     */
+    void sensorChanged(const std::string & siteName, unsigned int dsmId,
+                       nidas::core::DSMSensor *sensor);
+
+    IdAllocator & dsms(const std::string & siteName)
+        { return _sites[siteName].dsms; }
+    IdAllocator & sensors(const std::string & siteName, unsigned int dsmId)
+        { return _sites[siteName].dsmIds[dsmId].sensors; }
+    IdAllocator & samples(const std::string & siteName, unsigned int dsmId,
+                          unsigned int sensorId)
+        { return _sites[siteName].dsmIds[dsmId].samples[sensorId]; }
+
+private:
+
+    struct DSMIds {
+        DSMIds() : sensors(SensorIdStride) {}
+        IdAllocator sensors;
+        std::map<unsigned int, IdAllocator> samples;
+    };
+
+    struct SiteIds {
+        IdAllocator dsms;
+        std::map<unsigned int, DSMIds> dsmIds;
+    };
+
+    void addSite(nidas::core::Site *site);
+    void addDSM(SiteIds & siteIds, nidas::core::DSMConfig *dsm);
+    static void addSamples(IdAllocator & samples,
+                           nidas::core::DSMSensor *sensor);
+
+    Document *_doc;
+    std::map<std::string, SiteIds> _sites;
+};
+
+#endif
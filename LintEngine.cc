@@ -0,0 +1,264 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+/*
+ * This file is part of configedit:
+ * A Qt based application that allows visualization of a nidas/nimbus
+ * configuration (e.g. default.xml) file.
+ */
+
+#include "LintEngine.h"
+#include "Document.h"
+#include "nidas_qmv/NidasModel.h"
+#include "Profiler.h"
+
+#include <nidas/core/Project.h>
+#include <nidas/util/Exception.h>
+
+#include <xercesc/util/PlatformUtils.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+using namespace nidas::core;
+namespace n_u = nidas::util;
+
+
+void LintRule::problem(vector<LintProblem> & problems,
+                       LintProblem::Severity severity, const string & where,
+                       const string & message) const
+{
+    LintProblem p = { severity, name(), where, message };
+    problems.push_back(p);
+}
+
+
+LintRegistry *LintRegistry::getInstance()
+{
+    static LintRegistry *instance = 0;
+    if (!instance) {
+        instance = new LintRegistry();
+        addBuiltinRules(instance);
+    }
+    return instance;
+}
+
+
+LintEngine::LintEngine(Document *doc) : _doc(doc)
+{
+}
+
+string LintEngine::siteKey(const string & siteName)
+{
+    return "s:" + siteName;
+}
+
+string LintEngine::dsmKey(const string & siteName, unsigned int dsmId)
+{
+    ostringstream ost;
+    ost << siteKey(siteName) << "/d:" << dsmId;
+    return ost.str();
+}
+
+Site *LintEngine::findSite(const string & siteName) const
+{
+    Project *project = _doc->getProject();
+    if (!project) return 0;
+    for (SiteIterator si = project->getSiteIterator(); si.hasNext(); ) {
+        Site *site = si.next();
+        if (site->getName() == siteName) return site;
+    }
+    return 0;
+}
+
+void LintEngine::runAll()
+{
+    ProfileScope ps("LintEngine::runAll");
+    _problems.clear();
+
+    Project *project = _doc->getProject();
+    if (project) {
+        LintTarget target = { _doc, project, 0, 0, 0, "project" };
+        run(LintRule::ProjectScope, target, "");
+        for (SiteIterator si = project->getSiteIterator(); si.hasNext(); )
+            runSite(si.next());
+    }
+    emit problemsChanged();
+}
+
+void LintEngine::dsmChanged(const string & siteName, unsigned int dsmId)
+{
+    ProfileScope ps("LintEngine::dsmChanged");
+
+    // forget the DSM's own and its sensors' problems, and the site's
+    string key = dsmKey(siteName, dsmId);
+    _problems.erase(siteKey(siteName));
+    map<string, map<string, vector<LintProblem> > >::iterator pi =
+        _problems.lower_bound(key);
+    while (pi != _problems.end() && pi->first.compare(0, key.size(), key) == 0) {
+        if (pi->first.size() == key.size() || pi->first[key.size()] == '/')
+            _problems.erase(pi++);
+        else ++pi;
+    }
+
+    Site *site = findSite(siteName);
+    if (site) {
+        LintTarget target = { _doc, _doc->getProject(), site, 0, 0,
+                              "site " + siteName };
+        run(LintRule::SiteScope, target, siteKey(siteName));
+
+        const list<DSMConfig*> & dsms = site->getDSMConfigs();
+        for (list<DSMConfig*>::const_iterator di = dsms.begin();
+             di != dsms.end(); ++di)
+            if ((*di)->getId() == dsmId) runDSM(site, *di);
+    }
+    emit problemsChanged();
+}
+
+void LintEngine::runSite(Site *site)
+{
+    LintTarget target = { _doc, _doc->getProject(), site, 0, 0,
+                          "site " + site->getName() };
+    run(LintRule::SiteScope, target, siteKey(site->getName()));
+
+    const list<DSMConfig*> & dsms = site->getDSMConfigs();
+    for (list<DSMConfig*>::const_iterator di = dsms.begin();
+         di != dsms.end(); ++di)
+        runDSM(site, *di);
+}
+
+void LintEngine::runDSM(Site *site, DSMConfig *dsm)
+{
+    ostringstream where;
+    where << "site " << site->getName() << " / dsm " << dsm->getId()
+          << " (" << dsm->getName() << ")";
+    string key = dsmKey(site->getName(), dsm->getId());
+
+    LintTarget target = { _doc, _doc->getProject(), site, dsm, 0, where.str() };
+    run(LintRule::DSMScope, target, key);
+
+    for (SensorIterator si = dsm->getSensorIterator(); si.hasNext(); ) {
+        DSMSensor *sensor = si.next();
+        ostringstream sensorWhere;
+        sensorWhere << where.str() << " / sensor " << sensor->getSensorId()
+                    << " (" << sensor->getDeviceName() << ")";
+        ostringstream sensorKey;
+        sensorKey << key << "/x:" << sensor->getSensorId();
+
+        LintTarget sensorTarget = { _doc, _doc->getProject(), site, dsm, sensor,
+                                    sensorWhere.str() };
+        run(LintRule::SensorScope, sensorTarget, sensorKey.str());
+    }
+}
+
+void LintEngine::run(LintRule::Scope scope, const LintTarget & target,
+                     const string & key)
+{
+    const vector<LintRule*> & rules = LintRegistry::getInstance()->getRules();
+    for (size_t i = 0; i < rules.size(); i++) {
+        const LintRule *rule = rules[i];
+        if (rule->scope() != scope) continue;
+
+        Profiler::getInstance()->count("lint rules run");
+        vector<LintProblem> found;
+        try {
+            rule->check(target, found);
+        }
+        catch (const n_u::Exception & e) {
+            LintProblem p = { LintProblem::Error, rule->name(), target.where,
+                              string("rule failed: ") + e.what() };
+            found.push_back(p);
+        }
+
+        if (found.empty()) {
+            map<string, map<string, vector<LintProblem> > >::iterator pi =
+                _problems.find(key);
+            if (pi != _problems.end()) {
+                pi->second.erase(rule->name());
+                if (pi->second.empty()) _problems.erase(pi);
+            }
+        }
+        else _problems[key][rule->name()] = found;
+    }
+}
+
+vector<LintProblem> LintEngine::getProblems() const
+{
+    vector<LintProblem> all;
+    map<string, map<string, vector<LintProblem> > >::const_iterator pi;
+    for (pi = _problems.begin(); pi != _problems.end(); ++pi) {
+        map<string, vector<LintProblem> >::const_iterator ri;
+        for (ri = pi->second.begin(); ri != pi->second.end(); ++ri)
+            all.insert(all.end(), ri->second.begin(), ri->second.end());
+    }
+    return all;
+}
+
+/*!
+ * \brief configedit --lint: open \a file as the editor would and print
+ *        what the rules find.  Returns 0 if nothing, 1 if problems were
+ *        found or the file could not be read.
+ */
+int LintEngine::run(const string & file)
+{
+    static const char *severities[] = { "error", "warning" };
+
+    string projDir;
+    const char * env = getenv("PROJ_DIR");
+    if (env) projDir = env;
+    else cerr << "No $PROJ_DIR Environment Variable Defined.\n";
+
+    xercesc::XMLPlatformUtils::Initialize();
+    int status = 0;
+    {
+        Document doc(QString::fromStdString(projDir) +
+                     "/Configuration/cal_files/Engineering/", 0);
+        try {
+            doc.setFilename(file);
+            doc.parseFile();
+            // the rules find DOM elements through the model's DOMIndex
+            NidasModel model(Project::getInstance(), doc.getDomDocument());
+            doc.setModel(&model);
+            LintEngine *lint = doc.getLintEngine();
+            lint->runAll();
+            vector<LintProblem> problems = lint->getProblems();
+            for (size_t i = 0; i < problems.size(); i++) {
+                const LintProblem & p = problems[i];
+                cout << file << '\t' << severities[p.severity] << '\t'
+                     << p.rule << '\t' << p.where << '\t' << p.message << '\n';
+            }
+            cerr << file << ": " << problems.size() << " problems\n";
+            if (!problems.empty()) status = 1;
+        }
+        catch (const n_u::Exception & e) {
+            cerr << file << ": " << e.what() << "\n";
+            status = 1;
+        }
+    }
+    xercesc::XMLPlatformUtils::Terminate();
+    return status;
+}
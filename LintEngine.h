@@ -0,0 +1,182 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+/*
+ * LintEngine.h
+ *  rule based checks of a configuration, re-run as it is edited
+ */
+
+#ifndef _LintEngine_h
+#define _LintEngine_h
+
+#include <nidas/core/Project.h>
+#include <nidas/core/Site.h>
+#include <nidas/core/DSMConfig.h>
+#include <nidas/core/DSMSensor.h>
+
+#include <QObject>
+
+#include <map>
+#include <string>
+#include <vector>
+
+class Document;
+
+
+struct LintProblem {
+    enum Severity { Error, Warning };
+    Severity severity;
+    std::string rule;
+    std::string where;      // e.g. "site GV_N677F / dsm 1 (dsm304)"
+    std::string message;
+};
+
+/*!
+ * \brief What a rule is run on: the project, one site, one DSM or one
+ *        sensor, depending on the rule's scope.
+ */
+struct LintTarget {
+    Document *doc;
+    nidas::core::Project *project;
+    nidas::core::Site *site;
+    nidas::core::DSMConfig *dsm;
+    nidas::core::DSMSensor *sensor;
+    std::string where;
+};
+
+/*!
+ * \brief One check of a configuration.
+ *
+ * A rule's scope is what it depends on, and so what it is run on: a
+ * sensor rule looks at one sensor and need only run again when that
+ * sensor's DSM is edited, a site rule looks across a site's DSMs, and a
+ * project rule across the sites.
+ */
+class LintRule {
+
+public:
+
+    enum Scope { ProjectScope, SiteScope, DSMScope, SensorScope };
+
+    virtual ~LintRule() {}
+
+    virtual const char *name() const = 0;
+    virtual const char *description() const = 0;
+    virtual Scope scope() const = 0;
+
+    /// Add what is wrong with \a target to \a problems.
+    virtual void check(const LintTarget & target,
+                       std::vector<LintProblem> & problems) const = 0;
+
+protected:
+
+    void problem(std::vector<LintProblem> & problems,
+                 LintProblem::Severity severity, const std::string & where,
+                 const std::string & message) const;
+};
+
+/*!
+ * \brief The rules there are.  The built in ones (LintRules.cc) are
+ *        registered on first use; add() takes others.
+ */
+class LintRegistry {
+
+public:
+
+    static LintRegistry *getInstance();
+
+    /// Register \a rule, which the registry then owns.
+    void add(LintRule *rule) { _rules.push_back(rule); }
+
+    const std::vector<LintRule*> & getRules() const { return _rules; }
+
+private:
+
+    LintRegistry() {}
+    static void addBuiltinRules(LintRegistry *registry);
+
+    std::vector<LintRule*> _rules;
+};
+
+/*!
+ * \brief Runs the registered rules over a Document's Project and keeps
+ *        their problems current as the Document is edited.
+ *
+ * runAll() checks everything.  After that EditJournal reports each DSM
+ * an edit, undo or redo changed (dsmChanged()), and only the rules that
+ * depend on it are run again: the sensor rules for its sensors, its DSM
+ * rules and its site's site rules.  problemsChanged() is emitted after
+ * each run.
+ */
+class LintEngine : public QObject {
+
+    Q_OBJECT
+
+public:
+
+    LintEngine(Document *doc);
+
+    /// Run every rule on everything, e.g. once a file has been opened.
+    void runAll();
+
+    /// DSM \a dsmId of \a siteName was edited, added or removed.
+    void dsmChanged(const std::string & siteName, unsigned int dsmId);
+
+    /// Current problems, ordered by where they are.
+    std::vector<LintProblem> getProblems() const;
+
+    /// configedit --lint \a file; returns the exit status.
+    static int run(const std::string & file);
+
+signals:
+
+    void problemsChanged();
+
+private:
+
+    void runSite(nidas::core::Site *site);
+    void runDSM(nidas::core::Site *site, nidas::core::DSMConfig *dsm);
+    void run(LintRule::Scope scope, const LintTarget & target,
+             const std::string & key);
+
+    nidas::core::Site *findSite(const std::string & siteName) const;
+
+    static std::string siteKey(const std::string & siteName);
+    static std::string dsmKey(const std::string & siteName,
+                              unsigned int dsmId);
+
+    Document *_doc;
+
+    // problems by what they were found in ("" the project, then site,
+    // DSM and sensor keys, each extending the one above) and rule
+    std::map<std::string, std::map<std::string, std::vector<LintProblem> > >
+        _problems;
+
+    // No copying
+    LintEngine(const LintEngine &);
+    LintEngine & operator=(const LintEngine &);
+};
+
+#endif
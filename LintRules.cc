@@ -0,0 +1,267 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+/*
+ * This file is part of configedit:
+ * A Qt based application that allows visualization of a nidas/nimbus
+ * configuration (e.g. default.xml) file.
+ */
+
+/*
+ * The built in lint rules: the checks Document makes as it edits
+ * (validateDsmInfo(), validateSampleInfo(), getAvailableA2DChannels())
+ * and ConfigWindow makes on open, made of the whole configuration.
+ */
+
+#include "LintEngine.h"
+#include "Document.h"
+#include "nidas_qmv/NidasModel.h"
+#include "nidas_qmv/DOMIndex.h"
+
+#include <nidas/core/XDOM.h>
+
+#include <map>
+#include <set>
+#include <sstream>
+
+using namespace std;
+using namespace xercesc;
+using namespace nidas::core;
+
+
+namespace {
+
+string str(unsigned long n)
+{
+    ostringstream ost;
+    ost << n;
+    return ost.str();
+}
+
+/// Aircraft files should have only one site (as ConfigWindow::openFile).
+class AircraftSitesRule : public LintRule {
+public:
+    const char *name() const { return "aircraft-sites"; }
+    const char *description() const
+        { return "aircraft configurations have one site"; }
+    Scope scope() const { return ProjectScope; }
+
+    void check(const LintTarget & target, vector<LintProblem> & problems) const
+    {
+        vector<string> sites;
+        for (SiteIterator si = target.project->getSiteIterator(); si.hasNext(); )
+            sites.push_back(si.next()->getName());
+        if (sites.size() > 1 &&
+            (sites[0] == "GV_N677F" || sites[0] == "C130_N130AR"))
+            problem(problems, LintProblem::Error, target.where,
+                    "configuration is for aircraft " + sites[0] +
+                    " but has " + str(sites.size()) + " sites");
+    }
+};
+
+/// DSM ids and names are unique in a site (as Document::validateDsmInfo).
+class DSMIdsRule : public LintRule {
+public:
+    const char *name() const { return "dsm-ids"; }
+    const char *description() const
+        { return "DSM ids and names are unique in a site"; }
+    Scope scope() const { return SiteScope; }
+
+    void check(const LintTarget & target, vector<LintProblem> & problems) const
+    {
+        set<unsigned int> ids;
+        set<string> names;
+        const list<DSMConfig*> & dsms = target.site->getDSMConfigs();
+        for (list<DSMConfig*>::const_iterator di = dsms.begin();
+             di != dsms.end(); ++di) {
+            const DSMConfig *dsm = *di;
+            if (!ids.insert(dsm->getId()).second)
+                problem(problems, LintProblem::Error, target.where,
+                        "dsm id " + str(dsm->getId()) + " is not unique");
+            if (!names.insert(dsm->getName()).second)
+                problem(problems, LintProblem::Error, target.where,
+                        "dsm name " + dsm->getName() + " is not unique");
+        }
+    }
+};
+
+/// A variable name means one variable in a site.
+class VariableNamesRule : public LintRule {
+public:
+    const char *name() const { return "variable-names"; }
+    const char *description() const
+        { return "variable names are unique in a site"; }
+    Scope scope() const { return SiteScope; }
+
+    void check(const LintTarget & target, vector<LintProblem> & problems) const
+    {
+        map<string, string> seen;       // name -> where first found
+        const list<DSMConfig*> & dsms = target.site->getDSMConfigs();
+        for (list<DSMConfig*>::const_iterator di = dsms.begin();
+             di != dsms.end(); ++di) {
+            for (SensorIterator si = (*di)->getSensorIterator(); si.hasNext(); ) {
+                DSMSensor *sensor = si.next();
+                string where = "dsm " + (*di)->getName() + " sensor " +
+                               sensor->getDeviceName();
+                for (SampleTagIterator ti = sensor->getSampleTagIterator();
+                     ti.hasNext(); ) {
+                    const SampleTag *tag = ti.next();
+                    for (VariableIterator vi = tag->getVariableIterator();
+                         vi.hasNext(); ) {
+                        const Variable *var = vi.next();
+                        map<string, string>::const_iterator mi =
+                            seen.find(var->getName());
+                        if (mi == seen.end())
+                            seen[var->getName()] = where;
+                        else
+                            problem(problems, LintProblem::Error, target.where,
+                                    "variable " + var->getName() + " is in " +
+                                    mi->second + " and " + where);
+                    }
+                }
+            }
+        }
+    }
+};
+
+/// Sensor ids, and the device names sensors are removed by, are unique.
+class SensorIdsRule : public LintRule {
+public:
+    const char *name() const { return "sensor-ids"; }
+    const char *description() const
+        { return "sensor ids and device names are unique in a DSM"; }
+    Scope scope() const { return DSMScope; }
+
+    void check(const LintTarget & target, vector<LintProblem> & problems) const
+    {
+        set<unsigned int> ids;
+        set<string> devices;
+        for (SensorIterator si = target.dsm->getSensorIterator(); si.hasNext(); ) {
+            DSMSensor *sensor = si.next();
+            if (!ids.insert(sensor->getSensorId()).second)
+                problem(problems, LintProblem::Error, target.where,
+                        "sensor id " + str(sensor->getSensorId()) +
+                        " is not unique");
+            if (!devices.insert(sensor->getDeviceName()).second)
+                problem(problems, LintProblem::Warning, target.where,
+                        "device " + sensor->getDeviceName() +
+                        " is used by more than one sensor");
+        }
+    }
+};
+
+/// Sensors naming a catalog entry (IDREF) name one that's there.
+class CatalogRefsRule : public LintRule {
+public:
+    const char *name() const { return "catalog-refs"; }
+    const char *description() const
+        { return "sensors refer to sensors in the catalog"; }
+    Scope scope() const { return DSMScope; }
+
+    void check(const LintTarget & target, vector<LintProblem> & problems) const
+    {
+        const DOMElement *dsmElem = target.doc->getModel()->getDOMIndex()->
+            dsm(target.site->getName(), target.dsm->getId());
+        if (!dsmElem) return;
+
+        const SensorCatalogIndex & catalog =
+            target.doc->getSensorCatalogIndex();
+        for (const DOMNode *child = dsmElem->getFirstChild(); child;
+             child = child->getNextSibling()) {
+            if (child->getNodeType() != DOMNode::ELEMENT_NODE) continue;
+            XDOMElement xchild((const DOMElement *) child);
+            const string & idref = xchild.getAttributeValue("IDREF");
+            if (idref.empty() || catalog.find(idref)) continue;
+            problem(problems, LintProblem::Error, target.where,
+                    "sensor " + xchild.getAttributeValue("devicename") +
+                    " refers to " + idref + ", which is not in the catalog");
+        }
+    }
+};
+
+/// Sample ids are unique in a sensor (as Document::validateSampleInfo).
+class SampleIdsRule : public LintRule {
+public:
+    const char *name() const { return "sample-ids"; }
+    const char *description() const
+        { return "sample ids are unique in a sensor"; }
+    Scope scope() const { return SensorScope; }
+
+    void check(const LintTarget & target, vector<LintProblem> & problems) const
+    {
+        set<unsigned int> ids;
+        for (SampleTagIterator ti = target.sensor->getSampleTagIterator();
+             ti.hasNext(); ) {
+            const SampleTag *tag = ti.next();
+            if (!ids.insert(tag->getSampleId()).second)
+                problem(problems, LintProblem::Error, target.where,
+                        "sample id " + str(tag->getSampleId()) +
+                        " is not unique");
+        }
+    }
+};
+
+/// No two variables of an A2D card read the same channel.
+class A2DChannelsRule : public LintRule {
+public:
+    const char *name() const { return "a2d-channels"; }
+    const char *description() const
+        { return "A2D variables of a sensor are on different channels"; }
+    Scope scope() const { return SensorScope; }
+
+    void check(const LintTarget & target, vector<LintProblem> & problems) const
+    {
+        map<int, string> channels;
+        for (SampleTagIterator ti = target.sensor->getSampleTagIterator();
+             ti.hasNext(); ) {
+            const SampleTag *tag = ti.next();
+            for (VariableIterator vi = tag->getVariableIterator(); vi.hasNext(); ) {
+                const Variable *var = vi.next();
+                int chan = var->getA2dChannel();
+                if (chan < 0) continue;
+                map<int, string>::const_iterator ci = channels.find(chan);
+                if (ci == channels.end())
+                    channels[chan] = var->getName();
+                else
+                    problem(problems, LintProblem::Error, target.where,
+                            "channel " + str(chan) + " is used by both " +
+                            ci->second + " and " + var->getName());
+            }
+        }
+    }
+};
+
+}
+
+void LintRegistry::addBuiltinRules(LintRegistry *registry)
+{
+    registry->add(new AircraftSitesRule());
+    registry->add(new DSMIdsRule());
+    registry->add(new VariableNamesRule());
+    registry->add(new SensorIdsRule());
+    registry->add(new CatalogRefsRule());
+    registry->add(new SampleIdsRule());
+    registry->add(new A2DChannelsRule());
+}
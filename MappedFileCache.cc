@@ -0,0 +1,205 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+#include "MappedFileCache.h"
+#include "Profiler.h"
+
+#include <nidas/core/XDOM.h>
+#include <nidas/util/IOException.h>
+
+#include <xercesc/util/XMLResourceIdentifier.hpp>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+
+#include <iostream>
+
+using namespace std;
+using namespace xercesc;
+using nidas::core::XMLStringConverter;
+namespace n_u = nidas::util;
+
+
+MappedFile::MappedFile(const std::string & path) :
+  _data(0), _size(0), _dev(0), _ino(0), _mtim(), _mapped(false)
+{
+  ProfileScope profile("MappedFile");
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) throw n_u::IOException(path, "open", errno);
+
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    int err = errno;
+    ::close(fd);
+    throw n_u::IOException(path, "fstat", err);
+  }
+  _size = st.st_size;
+  _dev = st.st_dev;
+  _ino = st.st_ino;
+  _mtim = st.st_mtim;
+
+  if (_size > 0) {
+    void * addr = mmap(0, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr != MAP_FAILED) {
+      _data = (XMLByte *) addr;
+      _mapped = true;
+      // it's all about to be parsed front to back
+      madvise(addr, _size, MADV_SEQUENTIAL);
+      madvise(addr, _size, MADV_WILLNEED);
+    }
+  }
+
+  // some file systems won't map, so read it in one go instead
+  if (!_mapped) {
+    Profiler::getInstance()->count("mapped file fallback reads");
+    _data = new XMLByte[_size + 1];
+    size_t len = 0;
+    while (len < _size) {
+      ssize_t n = ::read(fd, _data + len, _size - len);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) {
+        int err = n < 0 ? errno : EIO;
+        delete [] _data;
+        ::close(fd);
+        throw n_u::IOException(path, "read", err);
+      }
+      len += n;
+    }
+  }
+  ::close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+  if (_mapped) munmap(_data, _size);
+  else delete [] _data;
+}
+
+bool MappedFile::isCurrent(const struct stat & st) const
+{
+  return st.st_dev == _dev && st.st_ino == _ino &&
+         st.st_mtim.tv_sec == _mtim.tv_sec &&
+         st.st_mtim.tv_nsec == _mtim.tv_nsec &&
+         (size_t) st.st_size == _size;
+}
+
+
+MappedInputSource::MappedInputSource(std::shared_ptr<const MappedFile> file,
+                                     const std::string & sysId) :
+  MemBufInputSource(file->data(), file->size(), sysId.c_str(), false),
+  _file(file)
+{
+}
+
+
+MappedFileCache * MappedFileCache::getInstance()
+{
+  static MappedFileCache * instance = new MappedFileCache();
+  return instance;
+}
+
+std::shared_ptr<const MappedFile> MappedFileCache::get(const std::string & path)
+{
+  struct stat st;
+  if (stat(path.c_str(), &st) < 0)
+    throw n_u::IOException(path, "stat", errno);
+
+  {
+    QMutexLocker locker(&_mutex);
+    map<string, Entry>::iterator fi = _files.find(path);
+    if (fi != _files.end() && fi->second.file->isCurrent(st)) {
+      Profiler::getInstance()->count("mapped file cache hits");
+      fi->second.lastUse = ++_uses;
+      return fi->second.file;
+    }
+  }
+
+  // Read without the lock, so other threads' reads (e.g. --scan's on
+  // NFS) aren't held up behind this one.  A parse still using an old
+  // mapping keeps it until it's done.
+  std::shared_ptr<const MappedFile> file(new MappedFile(path));
+
+  QMutexLocker locker(&_mutex);
+  Entry & entry = _files[path];
+  entry.file = file;
+  entry.lastUse = ++_uses;
+
+  if (_files.size() > MaxFiles) {
+    map<string, Entry>::iterator oldest = _files.begin();
+    for (map<string, Entry>::iterator fi = _files.begin();
+         fi != _files.end(); ++fi)
+      if (fi->second.lastUse < oldest->second.lastUse) oldest = fi;
+    _files.erase(oldest);
+    Profiler::getInstance()->count("mapped file cache evictions");
+  }
+  return file;
+}
+
+InputSource * MappedFileCache::open(const std::string & path)
+{
+  std::shared_ptr<const MappedFile> file(new MappedFile(path));
+  return new MappedInputSource(file, path);
+}
+
+InputSource *
+MappedFileCache::resolveEntity(XMLResourceIdentifier * resourceIdentifier)
+{
+  // schemas come from the grammar pool; XIncludes are external entities
+  if (resourceIdentifier->getResourceIdentifierType() !=
+      XMLResourceIdentifier::ExternalEntity)
+    return 0;
+  if (!resourceIdentifier->getSystemId()) return 0;
+
+  static const string fileScheme("file://");
+  string sysId = (string) XMLStringConverter(resourceIdentifier->getSystemId());
+  string base;
+  if (resourceIdentifier->getBaseURI())
+    base = (string) XMLStringConverter(resourceIdentifier->getBaseURI());
+
+  if (sysId.compare(0, fileScheme.size(), fileScheme) == 0)
+    sysId = sysId.substr(fileScheme.size());
+  if (base.compare(0, fileScheme.size(), fileScheme) == 0)
+    base = base.substr(fileScheme.size());
+  if (sysId.empty() || sysId.find("://") != string::npos) return 0;
+
+  string path = sysId;
+  if (path[0] != '/') {
+    size_t slash = base.rfind('/');
+    if (slash != string::npos) path = base.substr(0, slash+1) + sysId;
+  }
+
+  // let Xerces report files that aren't there as it always has
+  try {
+    return new MappedInputSource(get(path), path);
+  }
+  catch (const n_u::IOException & e) {
+    cerr << "MappedFileCache: " << e.what() << endl;
+    return 0;
+  }
+}
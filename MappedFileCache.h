@@ -0,0 +1,174 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+#ifndef _MAPPED_FILE_CACHE_H
+#define _MAPPED_FILE_CACHE_H
+
+#include <xercesc/framework/MemBufInputSource.hpp>
+#include <xercesc/util/XMLEntityResolver.hpp>
+
+#include <QMutex>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <ctime>
+
+#include <map>
+#include <memory>
+#include <string>
+
+
+/**
+ * The contents of a file, memory mapped, or read into memory where it
+ * can't be mapped.
+ */
+class MappedFile {
+
+public:
+
+  /**
+   * Map \a path.
+   *
+   * \throw nidas::util::IOException if it can't be opened or read.
+   */
+  MappedFile(const std::string & path);
+  ~MappedFile();
+
+  const XMLByte * data() const { return _data; }
+  size_t size() const { return _size; }
+
+  /// Is this still the contents of the file \a st is the stat() of?
+  bool isCurrent(const struct stat & st) const;
+
+  bool isMapped() const { return _mapped; }
+
+private:
+
+  XMLByte * _data;
+  size_t _size;
+
+  // which file, and which version of it, this is
+  dev_t _dev;
+  ino_t _ino;
+  struct timespec _mtim;
+
+  bool _mapped;
+
+  // No copying
+  MappedFile(const MappedFile &);
+  MappedFile & operator=(const MappedFile &);
+};
+
+
+/**
+ * A Xerces input source over a MappedFile, keeping it mapped as long as
+ * the parser holds the source.  System ids are resolved against \a sysId
+ * as they would be against the file name.
+ */
+class MappedInputSource : public xercesc::MemBufInputSource {
+
+public:
+
+  MappedInputSource(std::shared_ptr<const MappedFile> file,
+                    const std::string & sysId);
+
+private:
+
+  std::shared_ptr<const MappedFile> _file;
+};
+
+
+/**
+ * Configuration files read by mapping them, and the files they XInclude
+ * mapped once per session.
+ *
+ * Parsing straight from a file name has Xerces do many small buffered
+ * reads, and an XIncluded fragment is read again on every open, which
+ * adds up on the NFS shares projects live on.  Here each file is mapped
+ * (one read-ahead instead of many round trips).  XInclude targets, which
+ * many configurations share, are kept, keyed by path, until the file
+ * changes (inode, modification time or size), up to MaxFiles of them
+ * with the least recently used dropped first.  The configurations
+ * themselves are mapped afresh on each open() and not kept, so --diff
+ * or --scan over many files holds only those being parsed.
+ *
+ * Used as the parser's entity resolver it serves XInclude targets.
+ * configedit replaces files by renaming a new one over them, which
+ * leaves an existing mapping of the old file intact.
+ *
+ * Thread safe: background validation parses alongside the GUI's.
+ */
+class MappedFileCache : public xercesc::XMLEntityResolver {
+
+public:
+
+  static MappedFileCache * getInstance();
+
+  // XInclude targets kept mapped at most
+  static const size_t MaxFiles = 64;
+
+  /**
+   * An input source for a new mapping of \a path, which is not kept
+   * in the cache.  The parser adopts the source.
+   *
+   * \throw nidas::util::IOException if it can't be read.
+   */
+  xercesc::InputSource * open(const std::string & path);
+
+  /**
+   * The cached mapping of \a path, made again if the file has changed.
+   * The file is read with the cache unlocked.
+   *
+   * \throw nidas::util::IOException if it can't be read.
+   */
+  std::shared_ptr<const MappedFile> get(const std::string & path);
+
+  /**
+   * XMLEntityResolver: XIncludes (and other external entities) that
+   * name local files are served from the cache; anything else is left to
+   * Xerces.
+   */
+  xercesc::InputSource * resolveEntity(
+                        xercesc::XMLResourceIdentifier * resourceIdentifier);
+
+private:
+
+  MappedFileCache() : _uses(0) {}
+
+  struct Entry {
+    std::shared_ptr<const MappedFile> file;
+    unsigned long lastUse;
+  };
+
+  QMutex _mutex;
+  std::map<std::string, Entry> _files;
+  unsigned long _uses;
+
+  // No copying
+  MappedFileCache(const MappedFileCache &);
+  MappedFileCache & operator=(const MappedFileCache &);
+};
+
+#endif
@@ -0,0 +1,165 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+
+#include "Profiler.h"
+
+#include <QMutexLocker>
+
+#include <sys/time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+
+using namespace std;
+
+
+Profiler * Profiler::_instance = NULL;
+
+static void reportAtExit()
+{
+  Profiler::getInstance()->report();
+}
+
+static long long usecsNow()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (long long) tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+Profiler * Profiler::getInstance()
+{
+  if (!_instance) _instance = new Profiler();
+  return _instance;
+}
+
+Profiler::Profiler() : _enabled(false), _startUsecs(usecsNow())
+{
+  const char * trace = getenv("CONFEDIT_TRACE");
+  if (trace && *trace) _traceFile = trace;
+
+  const char * prof = getenv("CONFEDIT_PROFILE");
+  _enabled = (prof && *prof && string(prof) != "0") || _traceFile.size();
+
+  if (_enabled) atexit(reportAtExit);
+}
+
+long long Profiler::now() const
+{
+  return usecsNow() - _startUsecs;
+}
+
+// Small, stable thread numbers read better in a trace than pthread ids.
+// Called with _mutex held.
+int Profiler::threadNumber()
+{
+  unsigned long self = (unsigned long) pthread_self();
+  map<unsigned long, int>::iterator it = _threads.find(self);
+  if (it != _threads.end()) return it->second;
+  int n = _threads.size() + 1;
+  _threads[self] = n;
+  return n;
+}
+
+void Profiler::addPhase(const char * name, long long start, long long dur)
+{
+  if (!_enabled) return;
+  QMutexLocker locker(&_mutex);
+
+  Total & total = _phases[name];
+  total.calls++;
+  total.usecs += dur;
+
+  if (_traceFile.size()) {
+    Event e = { name, 'X', start, dur, threadNumber() };
+    _events.push_back(e);
+  }
+}
+
+void Profiler::count(const char * name, long long n)
+{
+  if (!_enabled) return;
+  QMutexLocker locker(&_mutex);
+
+  long long & value = _counters[name];
+  value += n;
+
+  if (_traceFile.size()) {
+    Event e = { name, 'C', now(), value, threadNumber() };
+    _events.push_back(e);
+  }
+}
+
+void Profiler::report()
+{
+  if (!_enabled) return;
+  QMutexLocker locker(&_mutex);
+
+  cerr << "\nconfigedit profile (total ms, calls, phase):\n";
+  char line[256];
+  for (map<string, Total>::const_iterator it = _phases.begin();
+       it != _phases.end(); ++it) {
+    snprintf(line, sizeof(line), "  %10.3f %6ld  %s\n",
+             it->second.usecs / 1000.0, it->second.calls, it->first.c_str());
+    cerr << line;
+  }
+  if (_counters.size()) cerr << "counters:\n";
+  for (map<string, long long>::const_iterator it = _counters.begin();
+       it != _counters.end(); ++it)
+    cerr << "  " << it->second << "  " << it->first << "\n";
+
+  if (_traceFile.size()) writeTrace();
+}
+
+// Called with _mutex held.
+void Profiler::writeTrace()
+{
+  ofstream out(_traceFile.c_str());
+  if (!out) {
+    cerr << "Could not write profile trace file " << _traceFile << "\n";
+    return;
+  }
+
+  // Names are the string literals given to ProfileScope/count, so need
+  // no JSON escaping.
+  int pid = getpid();
+  out << "{\"traceEvents\":[\n";
+  for (size_t i = 0; i < _events.size(); i++) {
+    const Event & e = _events[i];
+    out << "{\"name\":\"" << e.name << "\",\"ph\":\"" << e.type
+        << "\",\"pid\":" << pid << ",\"tid\":" << e.tid
+        << ",\"ts\":" << e.ts;
+    if (e.type == 'X') out << ",\"dur\":" << e.dur;
+    else out << ",\"args\":{\"value\":" << e.dur << "}";
+    out << "}" << (i+1 < _events.size() ? ",\n" : "\n");
+  }
+  out << "],\"displayTimeUnit\":\"ms\"}\n";
+
+  cerr << "wrote profile trace to " << _traceFile << "\n";
+}
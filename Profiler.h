@@ -0,0 +1,136 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+#ifndef _PROFILER_H
+#define _PROFILER_H
+
+#include <QMutex>
+
+#include <map>
+#include <string>
+#include <vector>
+
+
+/**
+ * Phase timers and counters for finding out where configedit spends its
+ * time (e.g. opening a large project).
+ *
+ * Off unless the environment asks for it:
+ *  - CONFEDIT_PROFILE=1 prints a summary of phase times and counters to
+ *    stderr at exit.
+ *  - CONFEDIT_TRACE=<file> also writes every timed phase and counter as
+ *    Chrome trace event JSON to <file>, for chrome://tracing or Perfetto.
+ *
+ * Phases are timed with a ProfileScope on the stack:
+ * \code
+ *   ProfileScope ps("Document::parseFile");
+ * \endcode
+ * and may nest and run on any thread.  When profiling is off a scope
+ * costs a test of a bool.
+ */
+class Profiler {
+
+public:
+
+  static Profiler * getInstance();
+
+  bool isEnabled() const { return _enabled; }
+
+  /// Microseconds since the Profiler was created.
+  long long now() const;
+
+  /// Record a phase \a name that started at \a start and ran \a dur usecs.
+  void addPhase(const char * name, long long start, long long dur);
+
+  /// Add \a n to the counter \a name.
+  void count(const char * name, long long n = 1);
+
+  /// Print the summary and write the trace file, if asked for.
+  void report();
+
+private:
+
+  Profiler();
+
+  struct Event {
+    const char * name;
+    char type;          // 'X' complete phase or 'C' counter, as in trace JSON
+    long long ts;
+    long long dur;      // duration, or the counter value
+    int tid;
+  };
+
+  struct Total {
+    Total() : calls(0), usecs(0) {}
+    long calls;
+    long long usecs;
+  };
+
+  int threadNumber();
+  void writeTrace();
+
+  bool _enabled;
+  std::string _traceFile;
+  long long _startUsecs;
+
+  QMutex _mutex;
+  std::vector<Event> _events;
+  std::map<std::string, Total> _phases;
+  std::map<std::string, long long> _counters;
+  std::map<unsigned long, int> _threads;
+
+  static Profiler * _instance;
+};
+
+/**
+ * Times the enclosing block as a Profiler phase.  \a name must outlive
+ * the Profiler, i.e. be a string literal.
+ */
+class ProfileScope {
+
+public:
+
+  ProfileScope(const char * name) : _name(name), _start(-1)
+  {
+    Profiler * p = Profiler::getInstance();
+    if (p->isEnabled()) _start = p->now();
+  }
+
+  ~ProfileScope()
+  {
+    if (_start < 0) return;
+    Profiler * p = Profiler::getInstance();
+    p->addPhase(_name, _start, p->now() - _start);
+  }
+
+private:
+  const char * _name;
+  long long _start;
+
+  ProfileScope(const ProfileScope &);
+  ProfileScope & operator=(const ProfileScope &);
+};
+
+#endif
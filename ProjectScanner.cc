@@ -0,0 +1,444 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+/*
+ * This file is part of configedit:
+ * A Qt based application that allows visualization of a nidas/nimbus
+ * configuration (e.g. default.xml) file.
+ */
+
+#include "ProjectScanner.h"
+#include "CalFileCatalog.h"
+#include "GrammarCache.h"
+#include "Profiler.h"
+
+#include <nidas/core/XDOM.h>
+#include <nidas/util/Exception.h>
+
+#include <raf/vardb.hh>
+
+#include <xercesc/util/PlatformUtils.hpp>
+
+#include <QList>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrentMap>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <cstdlib>
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+using namespace xercesc;
+using nidas::core::XDOMElement;
+namespace n_u = nidas::util;
+
+
+namespace {
+
+string attr(const DOMElement * elem, const string & name)
+{
+    return XDOMElement(elem).getAttributeValue(name);
+}
+
+string tagName(const DOMElement * elem)
+{
+    return XDOMElement(elem).getNodeName();
+}
+
+bool isSensor(const string & tag)
+{
+    return tag == "sensor" ||
+           (tag.size() > 6 && tag.compare(tag.size()-6, 6, "Sensor") == 0);
+}
+
+bool isDir(const string & path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+// sub-directories of dir, skipping hidden ones like .confedit
+vector<string> subDirs(const string & dir)
+{
+    vector<string> dirs;
+    DIR * dp = opendir(dir.c_str());
+    if (!dp) return dirs;
+    struct dirent * entry;
+    while ((entry = readdir(dp))) {
+        if (entry->d_name[0] == '.') continue;
+        string path = dir + "/" + entry->d_name;
+        if (isDir(path)) dirs.push_back(path);
+    }
+    closedir(dp);
+    sort(dirs.begin(), dirs.end());
+    return dirs;
+}
+
+// ${VAR} and $VAR from the environment; false if one isn't set
+bool expandEnv(const string & in, string & out)
+{
+    out.clear();
+    for (size_t i = 0; i < in.size(); ) {
+        if (in[i] != '$') { out += in[i++]; continue; }
+        size_t start = i + 1, end;
+        if (start < in.size() && in[start] == '{') {
+            end = in.find('}', ++start);
+            if (end == string::npos) return false;
+            i = end + 1;
+        } else {
+            end = start;
+            while (end < in.size() && (isalnum(in[end]) || in[end] == '_'))
+                end++;
+            i = end;
+        }
+        const char * val = getenv(in.substr(start, end - start).c_str());
+        if (!val) return false;
+        out += val;
+    }
+    return true;
+}
+
+}
+
+const char * ProjectScanner::kindName(Problem::Kind kind)
+{
+    switch (kind) {
+    case Problem::ParseError:     return "parse";
+    case Problem::VarDB:          return "vardb";
+    case Problem::MissingCalFile: return "calfile";
+    case Problem::DuplicateId:    return "duplicate";
+    }
+    return "?";
+}
+
+/*
+ * Projects keep their configurations in <project>/nidas, or for
+ * aircraft projects <project>/<aircraft>/nidas.
+ */
+vector<string> ProjectScanner::findConfigurations(const string & projDir)
+{
+    ProfileScope ps("ProjectScanner::findConfigurations");
+
+    vector<string> nidasDirs;
+    vector<string> projects = subDirs(projDir);
+    for (size_t i = 0; i < projects.size(); i++) {
+        if (isDir(projects[i] + "/nidas"))
+            nidasDirs.push_back(projects[i] + "/nidas");
+        vector<string> platforms = subDirs(projects[i]);
+        for (size_t j = 0; j < platforms.size(); j++)
+            if (isDir(platforms[j] + "/nidas"))
+                nidasDirs.push_back(platforms[j] + "/nidas");
+    }
+
+    vector<string> files;
+    for (size_t i = 0; i < nidasDirs.size(); i++) {
+        DIR * dp = opendir(nidasDirs[i].c_str());
+        if (!dp) continue;
+        struct dirent * entry;
+        while ((entry = readdir(dp))) {
+            string name(entry->d_name);
+            if (name[0] == '.' || name.size() < 5 ||
+                name.compare(name.size()-4, 4, ".xml") != 0) continue;
+            files.push_back(nidasDirs[i] + "/" + name);
+        }
+        closedir(dp);
+    }
+    sort(files.begin(), files.end());
+    return files;
+}
+
+ProjectScanner::ProjectScanner(Result & result, VDBFile * vardb) :
+    _result(result), _vardb(vardb)
+{
+}
+
+ProjectScanner::Result ProjectScanner::scan(const string & file)
+{
+    ProfileScope ps("ProjectScanner::scan");
+
+    Result result;
+    result.file = file;
+    ProjectScanner scanner(result, 0);
+
+    xercesc::DOMDocument * doc = 0;
+    try {
+        // each against the schema it names, not the session's
+        doc = GrammarCache::getInstance()->parseUncached(file);
+    }
+    catch (const n_u::Exception & e) {
+        scanner.problem(Problem::ParseError, "", e.what());
+        return result;
+    }
+    catch (...) {
+        scanner.problem(Problem::ParseError, "", "Caught Unspecified error");
+        return result;
+    }
+
+    // the project's vardb.xml is beside its nidas directory (as
+    // AddA2DVariableComboDialog finds it)
+    string projDir = file.substr(0, file.find_last_of('/'));
+    projDir = projDir.substr(0, projDir.find_last_of('/'));
+    string vardbFile = projDir + "/vardb.xml";
+    VDBFile vardb(vardbFile.c_str());
+    if (vardb.is_valid())
+        scanner._vardb = &vardb;
+    else
+        scanner.problem(Problem::VarDB, "", "could not read " + vardbFile);
+
+    const DOMElement * project = doc->getDocumentElement();
+    for (const DOMNode * child = project->getFirstChild(); child;
+         child = child->getNextSibling()) {
+        if (child->getNodeType() != DOMNode::ELEMENT_NODE) continue;
+        const DOMElement * elem = (const DOMElement *) child;
+        string tag = tagName(elem);
+        if (tag == "site" || tag == "aircraft") scanner.checkSite(elem);
+    }
+
+    doc->release();
+    Profiler::getInstance()->count("configurations scanned");
+    return result;
+}
+
+void ProjectScanner::checkSite(const DOMElement * site)
+{
+    string where = tagName(site) + " " + attr(site, "name");
+    _variables.clear();
+
+    set<unsigned long> dsmIds;
+    for (const DOMNode * child = site->getFirstChild(); child;
+         child = child->getNextSibling()) {
+        if (child->getNodeType() != DOMNode::ELEMENT_NODE) continue;
+        const DOMElement * dsm = (const DOMElement *) child;
+        if (tagName(dsm) != "dsm") continue;
+        string dsmWhere = where + " / dsm " + attr(dsm, "id") +
+                          " (" + attr(dsm, "name") + ")";
+        duplicate(dsmIds, attr(dsm, "id"), "DSM id", dsmWhere);
+        checkDSM(dsm, dsmWhere);
+    }
+}
+
+void ProjectScanner::checkDSM(const DOMElement * dsm, const string & where)
+{
+    set<unsigned long> sensorIds;
+    for (const DOMNode * child = dsm->getFirstChild(); child;
+         child = child->getNextSibling()) {
+        if (child->getNodeType() != DOMNode::ELEMENT_NODE) continue;
+        const DOMElement * sensor = (const DOMElement *) child;
+        if (!isSensor(tagName(sensor))) continue;
+        string sensorWhere = where + " / sensor " + attr(sensor, "id") +
+                             " (" + attr(sensor, "devicename") + ")";
+        duplicate(sensorIds, attr(sensor, "id"), "sensor id", sensorWhere);
+        checkSensor(sensor, sensorWhere);
+    }
+}
+
+void ProjectScanner::checkSensor(const DOMElement * sensor,
+                                 const string & where)
+{
+    // analog sensors' variables are the ones VarDB must know about
+    string kind = attr(sensor, "class") + " " + attr(sensor, "IDREF");
+    bool analog = kind.find("Analog") != string::npos ||
+                  kind.find("ANALOG") != string::npos ||
+                  kind.find("A2D") != string::npos;
+    string suffix = attr(sensor, "suffix");
+
+    checkCalFiles(sensor, where);
+
+    set<unsigned long> sampleIds;
+    for (const DOMNode * child = sensor->getFirstChild(); child;
+         child = child->getNextSibling()) {
+        if (child->getNodeType() != DOMNode::ELEMENT_NODE) continue;
+        const DOMElement * sample = (const DOMElement *) child;
+        if (tagName(sample) != "sample") continue;
+        string sampleWhere = where + " / sample " + attr(sample, "id");
+        duplicate(sampleIds, attr(sample, "id"), "sample id", sampleWhere);
+
+        for (const DOMNode * v = sample->getFirstChild(); v;
+             v = v->getNextSibling()) {
+            if (v->getNodeType() != DOMNode::ELEMENT_NODE) continue;
+            const DOMElement * var = (const DOMElement *) v;
+            if (tagName(var) != "variable") continue;
+            string name = attr(var, "name") + suffix;
+            string varWhere = sampleWhere + " / variable " + name;
+
+            if (!_variables.insert(name).second)
+                problem(Problem::DuplicateId, varWhere,
+                        "variable name used more than once in the site");
+            if (analog && _vardb && !_vardb->search_var(name))
+                problem(Problem::VarDB, varWhere, name + " is not in VarDB");
+        }
+    }
+}
+
+/*
+ * Every <calfile> at or below \a elem must name a file in its path
+ * (directories separated by ':', with environment variables).  Directories
+ * naming unset variables are left out of the search.
+ */
+void ProjectScanner::checkCalFiles(const DOMElement * elem,
+                                   const string & where)
+{
+    for (const DOMNode * child = elem->getFirstChild(); child;
+         child = child->getNextSibling()) {
+        if (child->getNodeType() != DOMNode::ELEMENT_NODE) continue;
+        const DOMElement * childElem = (const DOMElement *) child;
+        if (tagName(childElem) != "calfile") {
+            // sensor cals, then those of its samples' variables
+            checkCalFiles(childElem, where);
+            continue;
+        }
+
+        string file = attr(childElem, "file");
+        if (file.empty()) continue;
+
+        // Expand each directory on its own: paths configedit writes look
+        // in ${TMP_PROJ_DIR} first, which is usually unset, and the rest
+        // must still be checked.
+        istringstream dirs(attr(childElem, "path"));
+        string dir, expanded, path;
+        while (getline(dirs, dir, ':')) {
+            if (!expandEnv(dir, expanded) || expanded.empty()) continue;
+            if (!path.empty()) path += ':';
+            path += expanded;
+        }
+        if (path.empty()) continue;     // can't tell
+        if (!inPath(path, file))
+            problem(Problem::MissingCalFile, where,
+                    file + " not found in " + attr(childElem, "path"));
+    }
+}
+
+bool ProjectScanner::inPath(const string & path, const string & file)
+{
+    istringstream dirs(path);
+    string dir;
+    while (getline(dirs, dir, ':')) {
+        if (dir.empty()) continue;
+        if (dir[dir.size()-1] == '/') dir.erase(dir.size()-1);
+
+        // list each directory once, however many variables look in it
+        map<string, set<string> >::iterator di = _dirs.find(dir);
+        if (di == _dirs.end()) {
+            CalFileCatalog catalog;
+            set<string> names;
+            if (catalog.scan(dir))
+                names.insert(catalog.getFileNames().begin(),
+                             catalog.getFileNames().end());
+            di = _dirs.insert(make_pair(dir, names)).first;
+        }
+        if (di->second.count(file)) return true;
+
+        // the catalog keeps only .dat files
+        struct stat st;
+        if (file.find(".dat") == string::npos &&
+            stat((dir + "/" + file).c_str(), &st) == 0)
+            return true;
+    }
+    return false;
+}
+
+bool ProjectScanner::duplicate(set<unsigned long> & seen, const string & id,
+                               const string & what, const string & where)
+{
+    if (id.empty()) return false;
+    if (seen.insert(strtoul(id.c_str(), 0, 0)).second) return false;
+    problem(Problem::DuplicateId, where, what + " " + id + " used more than once");
+    return true;
+}
+
+void ProjectScanner::problem(Problem::Kind kind, const string & where,
+                             const string & message)
+{
+    Problem p = { kind, where, message };
+    _result.problems.push_back(p);
+}
+
+int ProjectScanner::run(const vector<string> & args)
+{
+    string projDir;
+    int threads = QThread::idealThreadCount();
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i] == "-j" && i + 1 < args.size())
+            threads = atoi(args[++i].c_str());
+        else if (projDir.empty() && args[i][0] != '-')
+            projDir = args[i];
+        else {
+            cerr << "Usage: configedit --scan [-j <threads>] [<dir>]\n";
+            return 2;
+        }
+    }
+    if (projDir.empty()) {
+        const char * env = getenv("PROJ_DIR");
+        if (!env) {
+            cerr << "No $PROJ_DIR Environment Variable Defined, "
+                    "and no directory given.\n";
+            return 2;
+        }
+        projDir = env;
+    }
+    if (threads < 1) threads = 1;
+
+    XMLPlatformUtils::Initialize();
+
+    vector<string> files = findConfigurations(projDir);
+    cerr << "scanning " << files.size() << " configurations under "
+         << projDir << " on " << threads << " threads\n";
+
+    QList<string> fileList;
+    for (size_t i = 0; i < files.size(); i++) fileList.append(files[i]);
+
+    QThreadPool::globalInstance()->setMaxThreadCount(threads);
+    QList<Result> results;
+    {
+        ProfileScope ps("ProjectScanner::run");
+        results = QtConcurrent::blockingMapped<QList<Result> >(
+                fileList, ProjectScanner::scan);
+    }
+
+    int withProblems = 0;
+    size_t nproblems = 0;
+    for (int i = 0; i < results.size(); i++) {
+        const Result & r = results[i];
+        if (r.problems.empty()) continue;
+        withProblems++;
+        nproblems += r.problems.size();
+        for (size_t j = 0; j < r.problems.size(); j++) {
+            const Problem & p = r.problems[j];
+            cout << r.file << "\t" << kindName(p.kind) << "\t" << p.where
+                 << "\t" << p.message << "\n";
+        }
+    }
+    cout << results.size() << " configurations, " << withProblems
+         << " with problems, " << nproblems << " problems\n";
+
+    XMLPlatformUtils::Terminate();
+    return withProblems ? 1 : 0;
+}
@@ -0,0 +1,123 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+/*
+ * ProjectScanner.h
+ *  validate every project configuration under $PROJ_DIR at once
+ */
+
+#ifndef _ProjectScanner_h
+#define _ProjectScanner_h
+
+#include <xercesc/dom/DOMElement.hpp>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+class VDBFile;
+
+
+/*!
+ * \brief Headless check of many project configurations in parallel.
+ *
+ * Finds the configurations in the nidas directories of every project
+ * under a directory (normally $PROJ_DIR), and on the global thread pool
+ * checks each as opening it in configedit would, and more:
+ *  - parse and full schema validation, each on its own Xerces parser
+ *    against the schema the file names (GrammarCache::parseUncached()),
+ *  - duplicate DSM ids in a site, sensor ids in a DSM, sample ids in a
+ *    sensor and variable names in a site,
+ *  - cal files named by <calfile> elements that aren't in their path,
+ *  - analog variables missing from the project's own vardb.xml.
+ *
+ * Configurations are independent, so a scan scales with the cores it is
+ * given.  Only the DOM is checked: nidas Project trees can't be built on
+ * several threads at once.
+ */
+class ProjectScanner {
+
+public:
+
+    struct Problem {
+        enum Kind { ParseError, VarDB, MissingCalFile, DuplicateId };
+        Kind kind;
+        std::string where;      // e.g. "aircraft GV_N677F / dsm 1"
+        std::string message;
+    };
+
+    struct Result {
+        std::string file;
+        std::vector<Problem> problems;
+    };
+
+    static const char * kindName(Problem::Kind kind);
+
+    /// The *.xml files in <project>/nidas directories under \a projDir.
+    static std::vector<std::string> findConfigurations(
+                                        const std::string & projDir);
+
+    /// Check one configuration; safe to run on several threads at once.
+    static Result scan(const std::string & file);
+
+    /*!
+     * \brief configedit --scan [-j <threads>] [<dir>]
+     *
+     * Prints one tab separated line per problem: file, kind, where and
+     * message, then a summary.
+     *
+     * \return 0 if no problems were found, 1 if some, 2 on bad arguments.
+     */
+    static int run(const std::vector<std::string> & args);
+
+private:
+
+    ProjectScanner(Result & result, VDBFile * vardb);
+
+    void checkSite(const xercesc::DOMElement * site);
+    void checkDSM(const xercesc::DOMElement * dsm, const std::string & where);
+    void checkSensor(const xercesc::DOMElement * sensor,
+                     const std::string & where);
+    void checkCalFiles(const xercesc::DOMElement * elem,
+                       const std::string & where);
+
+    bool duplicate(std::set<unsigned long> & seen, const std::string & id,
+                   const std::string & what, const std::string & where);
+    bool inPath(const std::string & path, const std::string & file);
+    void problem(Problem::Kind kind, const std::string & where,
+                 const std::string & message);
+
+    Result & _result;
+    VDBFile * _vardb;
+
+    // variable names seen in the site being checked
+    std::set<std::string> _variables;
+
+    // cal directory listings, read once per scan
+    std::map<std::string, std::set<std::string> > _dirs;
+};
+
+#endif
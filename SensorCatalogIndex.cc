@@ -0,0 +1,73 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+
+#include "SensorCatalogIndex.h"
+#include "Profiler.h"
+
+#include <nidas/core/XDOM.h>
+
+#include <iostream>
+
+using namespace std;
+using namespace nidas::core;
+
+
+void SensorCatalogIndex::build(const SensorCatalog * catalog)
+{
+  _entries.clear();
+  _names.clear();
+  if (!catalog) return;
+
+  ProfileScope ps("SensorCatalogIndex::build");
+
+  const map<string, xercesc::DOMElement*>& scMap = catalog->getMap();
+  _entries.reserve(scMap.size());
+  _names.reserve(scMap.size());
+
+  map<string, xercesc::DOMElement*>::const_iterator mi;
+  for (mi = scMap.begin(); mi != scMap.end(); mi++) {
+    XDOMElement xnode(mi->second);
+
+    Entry entry;
+    entry.element = mi->second;
+    entry.suffix = xnode.getAttributeValue("suffix");
+    entry.deviceName = xnode.getAttributeValue("devicename");
+
+    _entries[mi->first] = entry;
+    _names.push_back(mi->first);
+  }
+  cerr << "SensorCatalogIndex: indexed " << _names.size()
+       << " catalog sensors\n";
+}
+
+const SensorCatalogIndex::Entry *
+SensorCatalogIndex::find(const string & sensorIdName) const
+{
+  unordered_map<string, Entry>::const_iterator it =
+                                            _entries.find(sensorIdName);
+  if (it == _entries.end()) return NULL;
+  return &it->second;
+}
@@ -0,0 +1,75 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+#ifndef _SENSOR_CATALOG_INDEX_H
+#define _SENSOR_CATALOG_INDEX_H
+
+#include <xercesc/dom/DOMElement.hpp>
+
+#include <nidas/core/SensorCatalog.h>
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+
+/**
+ * Index of a Project's sensor catalog.
+ *
+ * Built once per parsed configuration file, it maps a catalog sensor ID
+ * to its DOM element along with the suffix and devicename attributes
+ * that the sensor dialog fills in, so neither Document nor the dialogs
+ * walk the catalog or pull XDOMElement attributes per lookup.
+ */
+class SensorCatalogIndex {
+
+public:
+
+  struct Entry {
+    const xercesc::DOMElement * element;
+    std::string suffix;
+    std::string deviceName;
+  };
+
+  SensorCatalogIndex() {}
+
+  /// Replace the index contents with those of \a catalog (which may be NULL).
+  void build(const nidas::core::SensorCatalog * catalog);
+
+  /// \return the entry for catalog sensor \a sensorIdName, or NULL.
+  const Entry * find(const std::string & sensorIdName) const;
+
+  /// Catalog sensor IDs in catalog (i.e. sorted) order.
+  const std::vector<std::string> & getSensorNames() const { return _names; }
+
+  bool empty() const { return _names.empty(); }
+
+private:
+
+  std::unordered_map<std::string, Entry> _entries;
+  std::vector<std::string> _names;
+};
+
+#endif
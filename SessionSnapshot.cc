@@ -0,0 +1,456 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+#include "SessionSnapshot.h"
+#include "CalFileCatalog.h"
+#include "MappedFileCache.h"
+#include "Profiler.h"
+
+#include <nidas/core/XDOM.h>
+#include <nidas/core/XMLParser.h>
+#include <nidas/util/Exception.h>
+
+#include <xercesc/dom/DOM.hpp>
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+
+using namespace std;
+using namespace xercesc;
+namespace n_u = nidas::util;
+
+
+namespace {
+
+const char Magic[8] = { 'C', 'E', 'S', 'N', 'A', 'P', '2', '\0' };
+
+const char * XIncludeNS = "http://www.w3.org/2001/XInclude";
+
+// a snapshot that doesn't hold together
+struct BadSnapshot {};
+
+/*
+ * Serializes nodes, with every XML string stored once in a table:
+ * element and attribute names repeat all through a configuration.
+ */
+class Writer {
+public:
+  Writer() { _strings.push_back(string()); }    // 0 is a null string
+
+  void u8(unsigned char v) { _out.append((const char*)&v, 1); }
+  void u32(unsigned int v) { _out.append((const char*)&v, sizeof(v)); }
+  void i64(long long v) { _out.append((const char*)&v, sizeof(v)); }
+  void str(const string & s) { u32(s.size()); _out.append(s); }
+
+  void xstr(const XMLCh * s)
+  {
+    if (!s) { u32(0); return; }
+    string bytes((const char*)s, XMLString::stringLen(s) * sizeof(XMLCh));
+    map<string, unsigned int>::const_iterator si = _index.find(bytes);
+    if (si != _index.end()) { u32(si->second); return; }
+    unsigned int i = _strings.size();
+    _index[bytes] = i;
+    _strings.push_back(bytes);
+    u32(i);
+  }
+
+  void node(const DOMNode * node);
+
+  const string & out() const { return _out; }
+
+  string strings() const
+  {
+    Writer table;
+    table.u32(_strings.size());
+    for (size_t i = 0; i < _strings.size(); i++) {
+      table.u32(_strings[i].size() / sizeof(XMLCh));
+      table._out.append(_strings[i]);
+    }
+    return table._out;
+  }
+
+private:
+  string _out;
+  map<string, unsigned int> _index;
+  vector<string> _strings;
+};
+
+void Writer::node(const DOMNode * node)
+{
+  short type = node->getNodeType();
+  u8(type);
+
+  switch (type) {
+  case DOMNode::ELEMENT_NODE: {
+    xstr(node->getNamespaceURI());
+    xstr(node->getNodeName());
+
+    const DOMNamedNodeMap * attrs = node->getAttributes();
+    u32(attrs->getLength());
+    for (XMLSize_t i = 0; i < attrs->getLength(); i++) {
+      const DOMAttr * attr = (const DOMAttr*) attrs->item(i);
+      // Schema defaults can't be rebuilt as defaults (unspecified, so
+      // left out of saves) with the public DOM API, and left out they
+      // would make a different configuration: parse such files instead.
+      if (!attr->getSpecified()) throw BadSnapshot();
+      xstr(attr->getNamespaceURI());
+      xstr(attr->getName());
+      xstr(attr->getValue());
+    }
+
+    unsigned int n = 0;
+    for (const DOMNode * c = node->getFirstChild(); c; c = c->getNextSibling())
+      n++;
+    u32(n);
+    for (const DOMNode * c = node->getFirstChild(); c; c = c->getNextSibling())
+      this->node(c);
+    break;
+  }
+  case DOMNode::TEXT_NODE:
+  case DOMNode::CDATA_SECTION_NODE:
+  case DOMNode::COMMENT_NODE:
+    xstr(node->getNodeValue());
+    break;
+  case DOMNode::PROCESSING_INSTRUCTION_NODE:
+    xstr(node->getNodeName());
+    xstr(node->getNodeValue());
+    break;
+  default:
+    throw BadSnapshot();    // entity references and the like: not kept
+  }
+}
+
+class Reader {
+public:
+  Reader(const XMLByte * data, size_t size) : _p(data), _end(data + size) {}
+
+  const XMLByte * take(size_t n)
+  {
+    if ((size_t)(_end - _p) < n) throw BadSnapshot();
+    const XMLByte * p = _p;
+    _p += n;
+    return p;
+  }
+  unsigned char u8() { return *take(1); }
+  unsigned int u32() { unsigned int v; memcpy(&v, take(sizeof(v)), sizeof(v)); return v; }
+  long long i64() { long long v; memcpy(&v, take(sizeof(v)), sizeof(v)); return v; }
+  string str() { unsigned int n = u32(); return string((const char*)take(n), n); }
+
+  void strings()
+  {
+    unsigned int n = u32();
+    _strings.assign(n, vector<XMLCh>());
+    for (unsigned int i = 0; i < n; i++) {
+      unsigned int len = u32();
+      const XMLByte * p = take(len * sizeof(XMLCh));
+      _strings[i].resize(len + 1, 0);
+      memcpy(&_strings[i][0], p, len * sizeof(XMLCh));
+    }
+  }
+  const XMLCh * xstr()
+  {
+    unsigned int i = u32();
+    if (i >= _strings.size()) throw BadSnapshot();
+    return i == 0 ? 0 : &_strings[i][0];
+  }
+
+  DOMNode * node(xercesc::DOMDocument * doc);
+
+private:
+  const XMLByte * _p;
+  const XMLByte * _end;
+  vector<vector<XMLCh> > _strings;
+};
+
+DOMNode * Reader::node(xercesc::DOMDocument * doc)
+{
+  switch (u8()) {
+  case DOMNode::ELEMENT_NODE: {
+    const XMLCh * ns = xstr();
+    const XMLCh * qname = xstr();
+    if (!qname) throw BadSnapshot();
+    DOMElement * elem = doc->createElementNS(ns, qname);
+
+    unsigned int nattrs = u32();
+    for (unsigned int i = 0; i < nattrs; i++) {
+      const XMLCh * attrNS = xstr();
+      const XMLCh * attrName = xstr();
+      const XMLCh * value = xstr();
+      if (!attrName) throw BadSnapshot();
+      elem->setAttributeNS(attrNS, attrName,
+                           value ? value : XMLUni::fgZeroLenString);
+    }
+
+    unsigned int n = u32();
+    for (unsigned int i = 0; i < n; i++)
+      elem->appendChild(node(doc));
+    return elem;
+  }
+  case DOMNode::TEXT_NODE:
+    return doc->createTextNode(xstr());
+  case DOMNode::CDATA_SECTION_NODE:
+    return doc->createCDATASection(xstr());
+  case DOMNode::COMMENT_NODE:
+    return doc->createComment(xstr());
+  case DOMNode::PROCESSING_INSTRUCTION_NODE: {
+    const XMLCh * target = xstr();
+    return doc->createProcessingInstruction(target, xstr());
+  }
+  default:
+    throw BadSnapshot();
+  }
+}
+
+long long mtimeOf(const string & path)
+{
+  struct stat st;
+  if (stat(path.c_str(), &st) < 0) return -1;
+  return st.st_mtime;
+}
+
+}
+
+
+SessionSnapshot::SessionSnapshot(const std::string & configFile) :
+  _configFile(configFile), _enabled(getenv("CONFEDIT_NO_SNAPSHOT") == 0),
+  _hashed(false), _includes(false), _hash(0), _size(0), _doc(0),
+  _calDirMtime(-1)
+{
+  size_t slash = configFile.rfind('/');
+  string dir = (slash == string::npos) ? string() :
+               configFile.substr(0, slash+1);
+  string name = configFile.substr(slash == string::npos ? 0 : slash+1);
+  _snapshotFile = dir + ".confedit/" + name + ".snapshot";
+}
+
+SessionSnapshot::~SessionSnapshot()
+{
+  if (_doc) _doc->release();
+}
+
+xercesc::DOMDocument * SessionSnapshot::takeDocument()
+{
+  xercesc::DOMDocument * doc = _doc;
+  _doc = 0;
+  return doc;
+}
+
+/*
+ * FNV-1a over the configuration, read from a mapping of it as the
+ * parser reads it.
+ */
+bool SessionSnapshot::hashConfig()
+{
+  if (_hashed) return true;
+  ProfileScope ps("SessionSnapshot::hash");
+
+  std::shared_ptr<const MappedFile> file;
+  try {
+    file.reset(new MappedFile(_configFile));
+  }
+  catch (const n_u::Exception &) {
+    return false;
+  }
+
+  unsigned long long h = 14695981039346656037ULL;
+  const XMLByte * p = file->data();
+  const XMLByte * end = p + file->size();
+  for (; p < end; p++) {
+    h ^= *p;
+    h *= 1099511628211ULL;
+  }
+  _hash = h;
+  _size = file->size();
+
+  const XMLByte * ns = (const XMLByte *) XIncludeNS;
+  _includes = search(file->data(), end, ns, ns + strlen(XIncludeNS)) != end;
+  _hashed = true;
+  return true;
+}
+
+bool SessionSnapshot::load()
+{
+  if (!_enabled || !hashConfig() || _includes) return false;
+  if (access(_snapshotFile.c_str(), R_OK) != 0) return false;
+
+  ProfileScope ps("SessionSnapshot::load");
+  try {
+    MappedFile file(_snapshotFile);
+    Reader in(file.data(), file.size());
+
+    if (memcmp(in.take(sizeof(Magic)), Magic, sizeof(Magic)) != 0 ||
+        in.u32() != sizeof(XMLCh))
+      throw BadSnapshot();
+    unsigned long long hash = in.i64();
+    unsigned long long size = in.i64();
+    if (hash != _hash || size != _size) {
+      cerr << _snapshotFile << " is stale\n";
+      return false;
+    }
+
+    _calDir = in.str();
+    _calDirMtime = in.i64();
+    unsigned int ncal = in.u32();
+    _calFiles.clear();
+    for (unsigned int i = 0; i < ncal; i++) _calFiles.push_back(in.str());
+
+    in.strings();
+
+    xercesc::DOMDocument * doc =
+        nidas::core::XMLImplementation::getImplementation()->createDocument();
+    try {
+      const XMLCh * version = in.xstr();
+      if (version) doc->setXmlVersion(version);
+      doc->setXmlStandalone(in.u8());
+      doc->setDocumentURI((const XMLCh*)
+                          nidas::core::XMLStringConverter(_configFile));
+      unsigned int n = in.u32();
+      for (unsigned int i = 0; i < n; i++)
+        doc->appendChild(in.node(doc));
+      if (!doc->getDocumentElement()) throw BadSnapshot();
+    }
+    catch (...) {
+      doc->release();
+      throw;
+    }
+
+    if (_doc) _doc->release();
+    _doc = doc;
+  }
+  catch (const BadSnapshot &) {
+    cerr << _snapshotFile << " is damaged, ignoring it\n";
+    return false;
+  }
+  catch (const n_u::Exception & e) {
+    cerr << _snapshotFile << ": " << e.what() << "\n";
+    return false;
+  }
+  catch (const DOMException &) {
+    cerr << _snapshotFile << ": DOM error rebuilding the document\n";
+    return false;
+  }
+
+  Profiler::getInstance()->count("configurations opened from snapshot");
+  cerr << "opened " << _configFile << " from " << _snapshotFile << endl;
+  return true;
+}
+
+bool SessionSnapshot::restoreCalFiles(CalFileCatalog & catalog,
+                                      const std::string & dir) const
+{
+  if (_calDir != dir || _calDirMtime < 0) return false;
+  if (mtimeOf(dir) != _calDirMtime) return false;
+  catalog.restore(dir, _calFiles);
+  return true;
+}
+
+void SessionSnapshot::save(const xercesc::DOMDocument * doc,
+                           const CalFileCatalog & engCalFiles)
+{
+  if (!_enabled || !hashConfig() || _includes) return;
+  ProfileScope ps("SessionSnapshot::save");
+
+  Writer nodes;
+  try {
+    nodes.xstr(doc->getXmlVersion());
+    nodes.u8(doc->getXmlStandalone());
+    unsigned int n = 0;
+    for (const DOMNode * c = doc->getFirstChild(); c; c = c->getNextSibling())
+      if (c->getNodeType() != DOMNode::DOCUMENT_TYPE_NODE) n++;
+    nodes.u32(n);
+    for (const DOMNode * c = doc->getFirstChild(); c; c = c->getNextSibling())
+      if (c->getNodeType() != DOMNode::DOCUMENT_TYPE_NODE) nodes.node(c);
+  }
+  catch (const BadSnapshot &) {
+    cerr << _configFile << " has nodes or schema default attributes a "
+            "snapshot can't keep, not saving one\n";
+    return;
+  }
+
+  Writer head;
+  head.u32(sizeof(XMLCh));
+  head.i64(_hash);
+  head.i64(_size);
+  head.str(engCalFiles.getDirectory());
+  head.i64(mtimeOf(engCalFiles.getDirectory()));
+  const vector<string> & names = engCalFiles.getFileNames();
+  head.u32(names.size());
+  for (size_t i = 0; i < names.size(); i++) head.str(names[i]);
+
+  string out(Magic, sizeof(Magic));
+  out += head.out();
+  out += nodes.strings();
+  out += nodes.out();
+
+  // .confedit is where saveFileCopy() keeps its copies too
+  string dir = _snapshotFile.substr(0, _snapshotFile.rfind('/'));
+  if (mkdir(dir.c_str(), S_IRWXU|S_IRWXG|S_IROTH|S_IXOTH) < 0 &&
+      errno != EEXIST) {
+    cerr << "Could not create " << dir << " for snapshot : "
+         << strerror(errno) << "\n";
+    return;
+  }
+
+  // written aside and renamed, so a reader never sees half of one
+  string tmpl = _snapshotFile + ".XXXXXX";
+  vector<char> tmpName(tmpl.begin(), tmpl.end());
+  tmpName.push_back('\0');
+  int fd = mkstemp(&tmpName[0]);
+  if (fd < 0) {
+    cerr << "Could not create " << tmpl << " : " << strerror(errno) << "\n";
+    return;
+  }
+
+  bool ok = true;
+  const char * buf = out.data();
+  size_t left = out.size();
+  while (left > 0) {
+    ssize_t nw = ::write(fd, buf, left);
+    if (nw < 0) {
+      if (errno == EINTR) continue;
+      ok = false;
+      break;
+    }
+    buf += nw;
+    left -= nw;
+  }
+  if (::close(fd) < 0) ok = false;
+  if (ok && rename(&tmpName[0], _snapshotFile.c_str()) < 0) ok = false;
+  if (!ok) {
+    cerr << "Could not write " << _snapshotFile << " : "
+         << strerror(errno) << "\n";
+    unlink(&tmpName[0]);
+    return;
+  }
+
+  Profiler::getInstance()->count("snapshot bytes written", out.size());
+}
@@ -0,0 +1,119 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+#ifndef _SESSION_SNAPSHOT_H
+#define _SESSION_SNAPSHOT_H
+
+#include <xercesc/dom/DOMDocument.hpp>
+
+#include <sys/types.h>
+#include <ctime>
+
+#include <string>
+#include <vector>
+
+class CalFileCatalog;
+
+
+/**
+ * What opening a configuration works out from the file and the disk,
+ * saved in a compact binary file so an unchanged configuration reopens
+ * without parsing or validating it again.
+ *
+ * A snapshot holds the validated DOM tree (as a string table and a
+ * preorder node list) and the engineering cal directory's catalog.  It
+ * is kept as .confedit/<file>.snapshot beside the configuration and is
+ * used only if the configuration's contents still hash the same; the
+ * cal catalog is used only if the directory's mtime still matches.
+ *
+ * The nidas Project tree is still built from the DOM with fromDOMElement
+ * - nidas objects can't be stored - and the schema check is left to the
+ * background validation configedit does for fast opens, in case the
+ * schema has changed since.
+ *
+ * Configurations that XInclude other files aren't snapshotted, since a
+ * change to an included file wouldn't change the hash, nor are those
+ * given schema default attributes, which the public DOM API can't make
+ * again as defaults.  Setting CONFEDIT_NO_SNAPSHOT in the environment
+ * turns snapshots off.
+ */
+class SessionSnapshot {
+
+public:
+
+  SessionSnapshot(const std::string & configFile);
+  ~SessionSnapshot();
+
+  /**
+   * Read the snapshot, if there is one for the configuration's current
+   * contents.  \return false if there isn't (or it's unreadable or
+   * stale), in which case the configuration must be parsed.
+   */
+  bool load();
+
+  /// The DOM from load(), which the caller now owns.
+  xercesc::DOMDocument * takeDocument();
+
+  /**
+   * Fill \a catalog as CalFileCatalog::scan(\a dir, "") would from the
+   * snapshot, if it was taken of \a dir and \a dir hasn't changed since.
+   * \return false if \a dir must be scanned.
+   */
+  bool restoreCalFiles(CalFileCatalog & catalog, const std::string & dir) const;
+
+  /**
+   * Save \a doc (just parsed and validated from the configuration) and
+   * \a engCalFiles, replacing any older snapshot.  Failure only costs
+   * the next open a parse, so it's reported and otherwise ignored.
+   */
+  void save(const xercesc::DOMDocument * doc,
+            const CalFileCatalog & engCalFiles);
+
+  const std::string & getSnapshotFile() const { return _snapshotFile; }
+
+private:
+
+  bool hashConfig();
+
+  std::string _configFile;
+  std::string _snapshotFile;
+
+  bool _enabled;
+  bool _hashed;
+  bool _includes;               // the configuration uses XInclude
+  unsigned long long _hash;     // FNV-1a of the configuration's contents
+  unsigned long long _size;
+
+  xercesc::DOMDocument * _doc;
+  std::string _calDir;
+  long long _calDirMtime;
+  std::vector<std::string> _calFiles;
+
+  // No copying
+  SessionSnapshot(const SessionSnapshot &);
+  SessionSnapshot & operator=(const SessionSnapshot &);
+};
+
+#endif
@@ -0,0 +1,156 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+
+#include "TidyFileFormatTarget.h"
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+
+TidyFileFormatTarget::TidyFileFormatTarget(const std::string & fileName) :
+    _fileName(fileName)
+{
+}
+
+#if XERCES_VERSION_MAJOR < 3
+void TidyFileFormatTarget::writeChars(const XMLByte * const toWrite,
+                                      const unsigned int count,
+                                      xercesc::XMLFormatter * const)
+#else
+void TidyFileFormatTarget::writeChars(const XMLByte * const toWrite,
+                                      const XMLSize_t count,
+                                      xercesc::XMLFormatter * const)
+#endif
+{
+  const char * chars = (const char *) toWrite;
+  for (size_t i = 0; i < count; i++) {
+    if (chars[i] == '\n') endLine(true);
+    else _line += chars[i];
+  }
+}
+
+void TidyFileFormatTarget::endLine(bool newline)
+{
+  size_t first = _line.find_first_not_of(' ');
+  if (first == string::npos) {   // remove all blank lines
+    _line.clear();
+    return;
+  }
+
+  // move xml comments to the first column with a blank line ahead of them
+  if (_line.compare(first, 2, "<!") == 0) {
+    _line.erase(0, first);
+    _out += '\n';
+  }
+
+  _out += _line;
+  if (newline) _out += '\n';
+  _line.clear();
+}
+
+bool TidyFileFormatTarget::commit()
+{
+  if (_line.size()) endLine(false);
+
+  std::string tmpl = _fileName + ".XXXXXX";
+  char * tmpName = strdup(tmpl.c_str());
+  int fd = mkstemp(tmpName);
+  std::string tmpFileName = tmpName;
+  free(tmpName);
+  if (fd < 0) {
+    cerr << "Could not create temporary file " << tmpl << " : "
+         << strerror(errno) << "\n";
+    return false;
+  }
+
+  // mkstemp makes the file private - give it the permissions of the
+  // file it replaces, or what a new file would get.
+  struct stat st;
+  mode_t mode;
+  if (stat(_fileName.c_str(), &st) == 0)
+    mode = st.st_mode & 07777;
+  else {
+    mode_t mask = umask(0);
+    umask(mask);
+    mode = 0666 & ~mask;
+  }
+  fchmod(fd, mode);
+
+  bool ok = true;
+  const char * buf = _out.data();
+  size_t left = _out.size();
+  while (left > 0) {
+    ssize_t n = ::write(fd, buf, left);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      cerr << "Error writing " << tmpFileName << " : "
+           << strerror(errno) << "\n";
+      ok = false;
+      break;
+    }
+    buf += n;
+    left -= n;
+  }
+
+  if (ok && fsync(fd) < 0) {
+    cerr << "Error syncing " << tmpFileName << " : " << strerror(errno) << "\n";
+    ok = false;
+  }
+  if (::close(fd) < 0 && ok) {
+    cerr << "Error closing " << tmpFileName << " : " << strerror(errno) << "\n";
+    ok = false;
+  }
+
+  if (ok && rename(tmpFileName.c_str(), _fileName.c_str()) < 0) {
+    cerr << "Could not rename " << tmpFileName << " to " << _fileName
+         << " : " << strerror(errno) << "\n";
+    ok = false;
+  }
+  if (!ok) {
+    unlink(tmpFileName.c_str());
+    return false;
+  }
+
+  // make the rename itself durable
+  size_t slash = _fileName.rfind('/');
+  std::string dirName = (slash == string::npos) ? std::string(".") :
+                        _fileName.substr(0, slash+1);
+  int dfd = open(dirName.c_str(), O_RDONLY);
+  if (dfd >= 0) {
+    fsync(dfd);
+    ::close(dfd);
+  }
+
+  return true;
+}
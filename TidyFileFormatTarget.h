@@ -0,0 +1,91 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+#ifndef _TIDY_FILE_FORMAT_TARGET_H
+#define _TIDY_FILE_FORMAT_TARGET_H
+
+#include <xercesc/framework/XMLFormatter.hpp>
+#include <xercesc/util/XercesVersion.hpp>
+
+#include <string>
+
+
+/**
+ * Xerces format target that writes a configuration file the way we like
+ * to read it, and replaces the file only once it is completely written.
+ *
+ * xercesc's pretty printer leaves blank lines about and indents comments
+ * oddly, so as the serialized XML streams through, line by line:
+ *  - lines that are empty or all spaces are dropped,
+ *  - comment (<!) lines are moved to the first column and get a blank
+ *    line ahead of them.
+ *
+ * The tidied document is held in memory.  commit() then writes it with a
+ * single write to a temporary file in the destination's directory,
+ * fsyncs it and renames it over the destination, so the destination is
+ * never seen truncated or half written, even on NFS or after a crash.
+ */
+class TidyFileFormatTarget : public xercesc::XMLFormatTarget {
+
+public:
+
+  TidyFileFormatTarget(const std::string & fileName);
+
+  ~TidyFileFormatTarget() {}
+
+#if XERCES_VERSION_MAJOR < 3
+  void writeChars(const XMLByte * const toWrite, const unsigned int count,
+                  xercesc::XMLFormatter * const formatter);
+#else
+  void writeChars(const XMLByte * const toWrite, const XMLSize_t count,
+                  xercesc::XMLFormatter * const formatter);
+#endif
+
+  /**
+   * Write the document to a temporary file, fsync it, rename it to the
+   * destination file name and fsync the directory.
+   *
+   * \return false, leaving the destination as it was, on any failure.
+   */
+  bool commit();
+
+  /// The tidied document, so far.
+  const std::string & getBuffer() const { return _out; }
+
+private:
+
+  void endLine(bool newline);
+
+  std::string _fileName;
+
+  std::string _line;    // current, incomplete line of input
+  std::string _out;     // the tidied document
+
+  // No copying
+  TidyFileFormatTarget(const TidyFileFormatTarget &);
+  TidyFileFormatTarget & operator=(const TidyFileFormatTarget &);
+};
+
+#endif
@@ -37,18 +37,27 @@
 #include <fstream>
 #include "sys/stat.h"
 
+#include <QDockWidget>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QInputDialog>
 #include <QMenuBar>
 #include <QMenu>
 #include <QStatusBar>
+#include <QTreeWidget>
 #include <QHeaderView>
+#include <QUndoGroup>
+#include <QUndoStack>
+#include <QtConcurrentRun>
 
 #include "configwindow.h"
 #include "exceptions/exceptions.h"
 #include "exceptions/QtExceptionHandler.h"
 #include "exceptions/CuteLoggingExceptionHandler.h"
 #include "exceptions/CuteLoggingStreamHandler.h"
+#include "Profiler.h"
+#include "ConfigDiff.h"
+#include "GrammarCache.h"
 
 using namespace nidas::core;
 using namespace nidas::util;
@@ -74,7 +83,21 @@ try {
 
     XMLPlatformUtils::Initialize(); //xercesc class
     _errorMessage = new QMessageBox(this);
+    _validationWatcher = new QFutureWatcher<std::string>(this);
+    connect(_validationWatcher, SIGNAL(finished()), this,
+            SLOT(validationDone()));
+    _engCalWatcher = new CalDirWatcher(this);
+    connect(_engCalWatcher, SIGNAL(fileAdded(const QString &)), this,
+            SLOT(engCalFileAdded(const QString &)));
+    connect(_engCalWatcher, SIGNAL(fileChanged(const QString &)), this,
+            SLOT(engCalFileChanged(const QString &)));
+    connect(_engCalWatcher, SIGNAL(fileRemoved(const QString &)), this,
+            SLOT(engCalFileRemoved(const QString &)));
+    connect(_engCalWatcher, SIGNAL(directoryStale(const QString &)), this,
+            SLOT(engCalDirStale(const QString &)));
     setupDefaultDir();
+    setupDiffPane();
+    setupLintPane();
     buildMenus();
     sensorComboDialog = new AddSensorComboDialog(_projDir+_a2dCalDir,
                                                  _projDir+_pmsSpecsFile, this);
@@ -107,6 +130,7 @@ try {
 void ConfigWindow::buildMenus()
 {
     buildFileMenu();
+    buildEditMenu();
     buildProjectMenu();
     buildWindowMenu();
     buildDSMMenu();
@@ -140,6 +164,17 @@ void ConfigWindow::buildFileMenu()
     saveAsAct->setStatusTip(tr("Save configuration as a new file"));
     connect(saveAsAct, SIGNAL(triggered()), this, SLOT(saveAsFile()));
 
+    QAction * compareAct = new QAction(tr("&Compare With..."), this);
+    compareAct->setStatusTip(tr(
+      "Show what changed since a saved copy or another configuration"));
+    connect(compareAct, SIGNAL(triggered()), this, SLOT(compareWithFile()));
+
+    fastOpenAction = new QAction(tr("&Fast Open"), this);
+    fastOpenAction->setStatusTip(tr(
+      "Open without schema full checking; validate in the background"));
+    fastOpenAction->setCheckable(true);
+    fastOpenAction->setChecked(false);
+
     QAction * exitAct = new QAction(tr("E&xit"), this);
     exitAct->setShortcut(tr("Ctrl+Q"));
     exitAct->setStatusTip(tr("Exit the application"));
@@ -150,10 +185,30 @@ void ConfigWindow::buildFileMenu()
     fileMenu->addAction(openAct);
     fileMenu->addAction(saveAct);
     fileMenu->addAction(saveAsAct);
+    fileMenu->addAction(compareAct);
+    fileMenu->addSeparator();
+    fileMenu->addAction(fastOpenAction);
+    fileMenu->addSeparator();
     fileMenu->addAction(exitAct);
 }
 
 
+void ConfigWindow::buildEditMenu()
+{
+    // each open Document brings its own undo stack to the group
+    _undoGroup = new QUndoGroup(this);
+
+    QAction * undoAct = _undoGroup->createUndoAction(this, tr("&Undo"));
+    undoAct->setShortcuts(QKeySequence::Undo);
+
+    QAction * redoAct = _undoGroup->createRedoAction(this, tr("&Redo"));
+    redoAct->setShortcuts(QKeySequence::Redo);
+
+    QMenu * menu = menuBar()->addMenu(tr("&Edit"));
+    menu->addAction(undoAct);
+    menu->addAction(redoAct);
+}
+
 void ConfigWindow::buildProjectMenu()
 {
     QMenu * menu = menuBar()->addMenu(tr("&Project"));
@@ -187,6 +242,138 @@ void ConfigWindow::buildWindowMenu()
     act->setChecked(false);
     connect(act, SIGNAL(toggled(bool)), this, SLOT(toggleErrorsWindow(bool)));
     menu->addAction(act);
+
+    act = _diffDock->toggleViewAction();
+    act->setText(tr("&Differences"));
+    act->setStatusTip(tr("Toggle differences window"));
+    menu->addAction(act);
+
+    act = _lintDock->toggleViewAction();
+    act->setText(tr("&Problems"));
+    act->setStatusTip(tr("Toggle problems window"));
+    menu->addAction(act);
+}
+
+/**
+ * The "Differences" pane: changes found by File->Compare With...,
+ * one row each, docked below the tree and table.
+ */
+void ConfigWindow::setupDiffPane()
+{
+    _diffTree = new QTreeWidget();
+    _diffTree->setColumnCount(5);
+    _diffTree->setHeaderLabels(QStringList() << tr("Change") << tr("Where")
+                               << tr("Attribute") << tr("Before")
+                               << tr("After"));
+    _diffTree->setRootIsDecorated(false);
+    _diffTree->setAlternatingRowColors(true);
+
+    _diffDock = new QDockWidget(tr("Differences"), this);
+    _diffDock->setObjectName("differences");
+    _diffDock->setWidget(_diffTree);
+    addDockWidget(Qt::BottomDockWidgetArea, _diffDock);
+    _diffDock->hide();
+}
+
+/**
+ * The "Problems" pane: what the lint rules find wrong with the open
+ * configuration, kept current as it is edited.
+ */
+void ConfigWindow::setupLintPane()
+{
+    _lintTree = new QTreeWidget();
+    _lintTree->setColumnCount(4);
+    _lintTree->setHeaderLabels(QStringList() << tr("Severity") << tr("Rule")
+                               << tr("Where") << tr("Message"));
+    _lintTree->setRootIsDecorated(false);
+    _lintTree->setAlternatingRowColors(true);
+
+    _lintDock = new QDockWidget(tr("Problems"), this);
+    _lintDock->setObjectName("problems");
+    _lintDock->setWidget(_lintTree);
+    addDockWidget(Qt::BottomDockWidgetArea, _lintDock);
+    _lintDock->hide();
+}
+
+/**
+ * The open Document's LintEngine has run rules again: list what it has.
+ */
+void ConfigWindow::lintProblemsChanged()
+{
+    if (!_doc) return;
+
+    static const char *severities[] = { "Error", "Warning" };
+    _lintTree->clear();
+    std::vector<LintProblem> problems = _doc->getLintEngine()->getProblems();
+    for (size_t i = 0; i < problems.size(); i++) {
+        const LintProblem & p = problems[i];
+        QTreeWidgetItem *row = new QTreeWidgetItem(_lintTree);
+        row->setText(0, severities[p.severity]);
+        row->setText(1, QString::fromStdString(p.rule));
+        row->setText(2, QString::fromStdString(p.where));
+        row->setText(3, QString::fromStdString(p.message));
+    }
+    for (int col = 0; col < _lintTree->columnCount(); col++)
+        _lintTree->resizeColumnToContents(col);
+
+    _lintDock->setWindowTitle(tr("Problems (%1)").arg(problems.size()));
+}
+
+/**
+ * Compare the configuration being edited, unsaved changes and all, with
+ * a file (by default one of the copies saveFileCopy() keeps) and list
+ * the differences in the Differences pane.
+ */
+void ConfigWindow::compareWithFile()
+{
+    if (!_doc || !_doc->getDomDocument()) {
+        _errorMessage->setText("No configuration open to compare with.");
+        _errorMessage->exec();
+        return;
+    }
+
+    QString copyDir = QFileInfo(_filename).path() + "/.confedit";
+    if (!QFileInfo(copyDir).isDir()) copyDir = QFileInfo(_filename).path();
+
+    QString other = QFileDialog::getOpenFileName(this,
+                _defaultCaption + " Compare with...", copyDir);
+    if (other.isEmpty()) return;
+
+    xercesc::DOMDocument *otherDoc = 0;
+    try {
+        otherDoc = GrammarCache::getInstance()->parse(other.toStdString(),
+                                                      false);
+    } catch (const nidas::util::Exception & e) {
+        _errorMessage->setText(QString::fromStdString(
+                    "Could not read " + other.toStdString() + ": " +
+                    e.what()));
+        _errorMessage->exec();
+        return;
+    }
+
+    ConfigDiff diff;
+    diff.compare(otherDoc, _doc->getDomDocument());
+    otherDoc->release();
+
+    static const char *kinds[] = { "Added", "Removed", "Changed" };
+    _diffTree->clear();
+    const std::vector<ConfigDiff::Change> & changes = diff.changes();
+    for (size_t i = 0; i < changes.size(); i++) {
+        const ConfigDiff::Change & c = changes[i];
+        QTreeWidgetItem *row = new QTreeWidgetItem(_diffTree);
+        row->setText(0, kinds[c.kind]);
+        row->setText(1, QString::fromStdString(c.path));
+        row->setText(2, QString::fromStdString(c.attribute));
+        row->setText(3, QString::fromStdString(c.before));
+        row->setText(4, QString::fromStdString(c.after));
+    }
+    for (int col = 0; col < _diffTree->columnCount(); col++)
+        _diffTree->resizeColumnToContents(col);
+
+    _diffDock->setWindowTitle(tr("Differences from %1 (%2)")
+                              .arg(QFileInfo(other).fileName())
+                              .arg(changes.size()));
+    _diffDock->show();
 }
 
 
@@ -199,6 +386,8 @@ void ConfigWindow::buildSensorMenu()
     sensorMenu->addAction(addSensorAction);
     sensorMenu->addAction(editSensorAction);
     sensorMenu->addAction(deleteSensorAction);
+    sensorMenu->addSeparator();
+    sensorMenu->addAction(moveSensorsAction);
     sensorMenu->setEnabled(false);
 }
 
@@ -221,6 +410,8 @@ void ConfigWindow::buildA2DVariableMenu()
     a2dVariableMenu->addAction(addA2DVariableAction);
     a2dVariableMenu->addAction(editA2DVariableAction);
     a2dVariableMenu->addAction(deleteA2DVariableAction);
+    a2dVariableMenu->addSeparator();
+    a2dVariableMenu->addAction(setA2DVariableRatesAction);
     a2dVariableMenu->setEnabled(false);
 }
 
@@ -246,6 +437,10 @@ void ConfigWindow::buildSensorActions()
     deleteSensorAction = new QAction(tr("&Delete Sensor"), this);
     connect(deleteSensorAction, SIGNAL(triggered()), this,
             SLOT(deleteSensor()));
+
+    moveSensorsAction = new QAction(tr("&Move Sensors to DSM..."), this);
+    connect(moveSensorsAction, SIGNAL(triggered()), this,
+            SLOT(moveSensors()));
 }
 
 void ConfigWindow::buildDSMActions()
@@ -273,6 +468,10 @@ void ConfigWindow::buildA2DVariableActions()
     deleteA2DVariableAction = new QAction(tr("&Delete A2DVariable"), this);
     connect(deleteA2DVariableAction, SIGNAL(triggered()), this,
             SLOT(deleteA2DVariable()));
+
+    setA2DVariableRatesAction = new QAction(tr("Set Sample &Rate..."), this);
+    connect(setA2DVariableRatesAction, SIGNAL(triggered()), this,
+            SLOT(setA2DVariableRates()));
 }
 
 void ConfigWindow::buildVariableActions()
@@ -316,10 +515,8 @@ void ConfigWindow::editSensorCombo()
 
 void ConfigWindow::deleteSensor()
 {
-  model->removeIndexes(tableview->selectionModel()->selectedIndexes());
-  cerr << "ConfigWindow::deleteSensor after removeIndexes\n";
-  _doc->setIsChangedBig(true);
-  tableview->resizeColumnsToContents();
+  deleteSelected();
+  cerr << "ConfigWindow::deleteSensor after removeItems\n";
 }
 
 void ConfigWindow::addDSMCombo()
@@ -350,10 +547,8 @@ void ConfigWindow::editDSMCombo()
 
 void ConfigWindow::deleteDSM()
 {
-  model->removeIndexes(tableview->selectionModel()->selectedIndexes());
-  cerr << "ConfigWindow::deleteDSM after removeIndexes\n";
-  _doc->setIsChangedBig(true);
-  tableview->resizeColumnsToContents();
+  deleteSelected();
+  cerr << "ConfigWindow::deleteDSM after removeItems\n";
 }
 
 void ConfigWindow::addA2DVariableCombo()
@@ -385,9 +580,106 @@ void ConfigWindow::editA2DVariableCombo()
 
 void ConfigWindow::deleteA2DVariable()
 {
-  model->removeIndexes(tableview->selectionModel()->selectedIndexes());
-  _doc->setIsChangedBig(true);
-  cerr << "ConfigWindow::deleteA2DVariable after removeIndexes\n";
+  deleteSelected();
+  cerr << "ConfigWindow::deleteA2DVariable after removeItems\n";
+}
+
+/*!
+ * \brief Delete the selected rows as one (undoable) edit.
+ */
+void ConfigWindow::deleteSelected()
+{
+  try {
+    _doc->removeItems(selectedItems());
+  } catch (InternalProcessingException &e) {
+    QMessageBox::warning(this, tr("Delete"),
+         QString::fromStdString("Bad internal error. Get help! " + e.toString()));
+  }
+  tableview->resizeColumnsToContents();
+}
+
+/*!
+ * \brief Move the selected sensors to a DSM the user picks, as one edit.
+ */
+void ConfigWindow::moveSensors()
+{
+  QList<SensorItem*> sensorItems;
+  QList<NidasItem*> items = selectedItems();
+  for (int i = 0; i < items.size(); i++) {
+    SensorItem *sensorItem = dynamic_cast<SensorItem*>(items[i]);
+    if (sensorItem) sensorItems.append(sensorItem);
+  }
+  if (sensorItems.isEmpty()) return;
+
+  // offer every DSM in the project but the one they're on now
+  NidasItem *fromItem = sensorItems[0]->getParentItem();
+  NidasItem *projItem = fromItem->getParentItem()->getParentItem();
+  QList<DSMItem*> dsmItems;
+  QStringList dsmNames;
+  for (int i = 0; i < projItem->childCount(); i++) {
+    SiteItem *siteItem = dynamic_cast<SiteItem*>(projItem->child(i));
+    if (!siteItem) continue;
+    for (int j = 0; j < siteItem->childCount(); j++) {
+      DSMItem *dsmItem = dynamic_cast<DSMItem*>(siteItem->child(j));
+      if (!dsmItem || dsmItem == fromItem) continue;
+      dsmItems.append(dsmItem);
+      dsmNames.append(dsmItem->name());
+    }
+  }
+  if (dsmItems.isEmpty()) return;
+
+  bool ok;
+  QString dsmName = QInputDialog::getItem(this, tr("Move Sensors"),
+          tr("Move %1 sensor(s) to DSM:").arg(sensorItems.size()),
+          dsmNames, 0, false, &ok);
+  if (!ok) return;
+
+  try {
+    _doc->moveSensors(sensorItems, dsmItems[dsmNames.indexOf(dsmName)]);
+  } catch (InternalProcessingException &e) {
+    QMessageBox::warning(this, tr("Move Sensors"),
+         QString::fromStdString("Bad internal error. Get help! " + e.toString()));
+  } catch (nidas::util::InvalidParameterException &e) {
+    QMessageBox::warning(this, tr("Move Sensors"),
+         QString::fromStdString("Invalid parameter: " + e.toString()));
+  }
+  tableview->resizeColumnsToContents();
+}
+
+/*!
+ * \brief Give all the selected A2D variables the sample rate the user
+ *        picks, as one edit.
+ */
+void ConfigWindow::setA2DVariableRates()
+{
+  SensorItem *sensorItem =
+              dynamic_cast<SensorItem*>(model->getCurrentRootItem());
+  QList<A2DVariableItem*> varItems;
+  QList<NidasItem*> items = selectedItems();
+  for (int i = 0; i < items.size(); i++) {
+    A2DVariableItem *a2dvItem = dynamic_cast<A2DVariableItem*>(items[i]);
+    if (a2dvItem) varItems.append(a2dvItem);
+  }
+  if (!sensorItem || varItems.isEmpty()) return;
+
+  // same choices as AddA2DVariableComboDialog
+  QStringList rates;
+  rates << "10" << "100" << "500";
+  bool ok;
+  QString rate = QInputDialog::getItem(this, tr("Set Sample Rate"),
+          tr("Sample rate for %1 variable(s):").arg(varItems.size()),
+          rates, 0, false, &ok);
+  if (!ok) return;
+
+  try {
+    _doc->setA2DVariableRates(sensorItem, varItems, rate.toStdString());
+  } catch (InternalProcessingException &e) {
+    QMessageBox::warning(this, tr("Set Sample Rate"),
+         QString::fromStdString("Bad internal error. Get help! " + e.toString()));
+  } catch (nidas::util::InvalidParameterException &e) {
+    QMessageBox::warning(this, tr("Set Sample Rate"),
+         QString::fromStdString("Invalid parameter: " + e.toString()));
+  }
   tableview->resizeColumnsToContents();
 }
 
@@ -528,6 +820,7 @@ void ConfigWindow::getFile()
 
 void ConfigWindow::openFile()
 {
+    ProfileScope profile("ConfigWindow::openFile");
     QString winTitle("configedit:  ");
 
     if (_filename.isNull() || _filename.isEmpty()) {
@@ -548,6 +841,7 @@ void ConfigWindow::openFile()
         if (_doc) delete(_doc);
         _doc = new Document(_projDir+_engCalDirRoot, this);
         _doc->setFilename(_filename.toStdString());
+        _doc->setFastOpen(fastOpenAction->isChecked());
         try {
             _doc->parseFile();
         }
@@ -616,6 +910,11 @@ cerr<<"printSiteNames\n";
             a2dVariableComboDialog->setDocument(_doc);
             variableComboDialog->setDocument(_doc);
             setupModelView(mainSplitter);
+            _undoGroup->addStack(_doc->getUndoStack());
+            _undoGroup->setActiveStack(_doc->getUndoStack());
+            connect(_doc->getLintEngine(), SIGNAL(problemsChanged()), this,
+                    SLOT(lintProblemsChanged()));
+            _doc->getLintEngine()->runAll();
 
             setCentralWidget(mainSplitter);
 
@@ -624,6 +923,19 @@ cerr<<"printSiteNames\n";
             winTitle.append(_filename);
             setWindowTitle(winTitle);
 
+            // pick up cal files dropped in while we're open
+            _engCalWatcher->clear();
+            _engCalWatcher->addDirectory(_doc->getEngCalDir());
+
+            // fast opened or from a snapshot: do the checking parseFile
+            // skipped off to the side
+            if (_doc->isFastOpen() || _doc->isFromSnapshot()) {
+                cerr << "validating " << _filename.toStdString()
+                     << " in the background\n";
+                _validatingFile = _filename;
+                _validationWatcher->setFuture(QtConcurrent::run(
+                        Document::validateFile, _filename.toStdString()));
+            }
         }
         catch (const CancelProcessingException & cpe) {
             // stop processing, show blank window
@@ -773,7 +1085,7 @@ bool ConfigWindow::saveFile(string origFile)
       return false;
     }
     if (_doc) { // confirm user has loaded a config file
-      if (!saveFileCopy(origFile)) {
+      if (!_doc->saveFileCopy(origFile)) {
         _errorMessage->setText("FAILED to write copy of file.\n No backups");
         _errorMessage->exec();
       }
@@ -794,26 +1106,6 @@ for (size_t i=0; i<missingEngCalFiles.size(); i++) {
   cerr << missingEngCalFiles[i].toStdString();
   cerr << "\n";
 }
-    // Now clean up xercesc's bizzare comment formatting
-    std::string syscmd;
-    std::string filename = _doc->getFilename();
-    std::string tmpfilename = filename + ".tmp";
-    // remove all blank lines
-    syscmd = "sed '/^ *$/d' " + filename + " > " + tmpfilename;
-    system(syscmd.c_str());
-    syscmd.clear();
-    // move all start xml comments to first column
-    syscmd = "sed 's/^ *<\\!/<\\!/' " + tmpfilename + " > " + filename;
-    system(syscmd.c_str());
-    syscmd.clear();
-    // insert a blank line ahead of xml comments
-    syscmd = "sed '/^ *<\\!/{x;p;x;}' " + filename + " > " + tmpfilename;
-    system(syscmd.c_str());
-    syscmd.clear();
-    // final step in cleanup
-    syscmd = "mv -f " + tmpfilename + " " + filename;
-    system(syscmd.c_str());
-
     _doc->setIsChanged(false);
     _doc->setIsChangedBig(false);
 
@@ -870,85 +1162,61 @@ bool ConfigWindow::saveAsFile()
     }
 }
 
-bool ConfigWindow::saveFileCopy(string origFile)
+/**
+ * Report the result of the background validation of a fast opened file.
+ */
+void ConfigWindow::validationDone()
 {
-  std::string saveFileName = _doc->getFilename();
-  size_t fn = saveFileName.rfind("/");
-  std::string saveFname = saveFileName.substr(fn+1);
-  std::string saveDir = saveFileName.substr(0, fn+1);
-  std::string copyDir = saveDir + ".confedit";
-  std::string copyFname;
-  std::string copyFile;
-  std::string fromFile;
-
-  // Make copy directory if it doesn't already exist
-  umask(0);
-  struct stat st;
-  if (stat(copyDir.c_str(), &st) != 0) { // create copy dir
-    if (mkdir(copyDir.c_str(), S_IRWXU|S_IRWXG|S_IROTH|S_IXOTH) == -1) {
-      cerr << "Could not create directory " << copyDir << " to save copies\n";
-      return false;
-    }
-  }
-
-  // set up the copy filename
-  time_t now;
-  char dateTime[64];
-  dateTime[0] = '\0';
-  now = time(NULL);
-  if (now != -1)
-    strftime(dateTime, 64, "%Y%m%d-%H%M%S", gmtime(&now));
-  else
-    cerr << "couldn't get timestamp for copy filename\n";
-  copyFname = saveFname+"."+std::string(dateTime);
-  copyFile = copyDir + "/" +copyFname;
-
-  if (origFile.length() == 0)
-    fromFile = saveFileName;
-  else
-    fromFile = origFile;
-
-  ifstream src(fromFile.c_str(), ifstream::in);
-  if (!src) {
-    // see if a .xml was added by configwindow
-    size_t found;
-    found = fromFile.rfind(".xml");
-    if (found!=string::npos) {
-      string::iterator it;
-      it = fromFile.begin()+found;
-      fromFile.erase(it,fromFile.end());
+    std::string error = _validationWatcher->result();
+    std::string where = "Validation of " + _validatingFile.toStdString();
+    if (error.empty()) {
+        cerr << where << ": no errors\n";
+        return;
     }
-    else
-      return false;
+    exceptionHandler->display(where, error);
+}
 
-    src.open(fromFile.c_str(), ifstream::in);
-    if (!src) {
-      cerr << "Could not open source file : " << fromFile << "\n";
-      return false;
-    }
-  }
-  ofstream dest(copyFile.c_str(), ifstream::out);
-  if (!dest) {
-    cerr << "Could not open destination file: " << copyFile << "\n";
-    return false;
-  }
+/*!
+ * \brief Engineering cal file \a path appeared: variables added from now
+ *        on can use it, and rows that showed it missing look again.
+ */
+void ConfigWindow::engCalFileAdded(const QString & path)
+{
+    if (!_doc || !_fileOpen) return;
+    cerr << "Engineering cal file added: " << path.toStdString() << "\n";
+    _doc->getEngCalFiles().add(QFileInfo(path).fileName().toStdString());
+    model->calFileChanged(path.toStdString());
+}
 
-  dest << src.rdbuf();
-  if (!dest)
-  {
-     cerr << "Error while copying from: \n" << fromFile <<
-             "\n to: \n" << copyFile << "\n";
-     return false;
-  }
+void ConfigWindow::engCalFileChanged(const QString & path)
+{
+    if (!_doc || !_fileOpen) return;
+    model->calFileChanged(path.toStdString());
+}
 
-  cerr << "copied from: \n" << fromFile <<
-          "\n to: \n" << copyFile << "\n";
+void ConfigWindow::engCalFileRemoved(const QString & path)
+{
+    if (!_doc || !_fileOpen) return;
+    cerr << "Engineering cal file removed: " << path.toStdString() << "\n";
+    _doc->getEngCalFiles().remove(QFileInfo(path).fileName().toStdString());
+    model->calFileChanged(path.toStdString());
+}
 
-  return true;
+/*!
+ * \brief The watcher lost track of changes to \a dir, so read it again
+ *        and have the model forget every calibration it has shown.
+ */
+void ConfigWindow::engCalDirStale(const QString & dir)
+{
+    if (!_doc || !_fileOpen) return;
+    _doc->getEngCalFiles().scan(dir.toStdString());
+    model->calFilesChanged();
 }
 
 void ConfigWindow::setupModelView(QSplitter *splitter)
 {
+  ProfileScope profile("ConfigWindow::setupModelView");
+
   model = new NidasModel(Project::getInstance(), _doc->getDomDocument(), this);
 
   treeview = new QTreeView(splitter);
@@ -959,24 +1227,43 @@ void ConfigWindow::setupModelView(QSplitter *splitter)
   tableview->setModel( model );
   tableview->setSelectionModel( treeview->selectionModel() );  /* common selection model */
   tableview->setSelectionBehavior( QAbstractItemView::SelectRows );
-  tableview->setSelectionMode( QAbstractItemView::SingleSelection );
+  tableview->setSelectionMode( QAbstractItemView::ExtendedSelection );
 
   //connect(treeview, SIGNAL(pressed(const QModelIndex &)), this, SLOT(changeToIndex(const QModelIndex &)));
   connect(treeview->selectionModel(), SIGNAL(selectionChanged(const QItemSelection&, const QItemSelection&)), this, SLOT(changeToIndex(const QItemSelection &)));
 
+  // rows are built as the views ask for them; the first has to be there
+  // now to be made current
+  model->fetchMore(treeview->rootIndex());
   treeview->setCurrentIndex(treeview->rootIndex().child(0,0));
 
   splitter->addWidget(treeview);
   splitter->addWidget(tableview);
 }
 
+/*!
+ * \brief The NidasItems for the rows selected in the table.
+ */
+QList<NidasItem*> ConfigWindow::selectedItems()
+{
+  QList<NidasItem*> items;
+  QModelIndexList indexList = tableview->selectionModel()->selectedIndexes();
+  for (int i=0; i<indexList.size(); i++) {
+    // the NidasItem for the selected row resides in column 0
+    if (indexList[i].column() != 0 || !indexList[i].isValid()) continue;
+    items.append(model->getItem(indexList[i]));
+  }
+  return items;
+}
+
 
 /*!
  * \brief Display and setup the correct actions for the index in \a selections.
  *
  * This version is for selectionModel's selectionChanged signal.
- * We use only the first element of \a selections,
- * expecting that the view(s) allow only one selection at a time.
+ * We use only the first element of \a selections: the table allows
+ * several rows to be selected, but only among the children of one item.
+ * Nothing newly selected (e.g. a row ctrl-clicked off) changes nothing.
  */
 void ConfigWindow::changeToIndex(const QItemSelection & selections)
 {
@@ -985,8 +1272,6 @@ void ConfigWindow::changeToIndex(const QItemSelection & selections)
     changeToIndex(il.at(0));
     tableview->resizeColumnsToContents ();
   }
-  else throw InternalProcessingException("selectionChanged signal provided no"
-                                         " selections");
 }
 
 
@@ -1027,6 +1312,7 @@ void ConfigWindow::changeToIndex(const QModelIndex & index)
       a2dVariableMenu->setEnabled(true);
       editA2DVariableAction->setEnabled(false);
       deleteA2DVariableAction->setEnabled(false);
+      setA2DVariableRatesAction->setEnabled(false);
     } else
       a2dVariableMenu->setEnabled(false);
     variableMenu->setEnabled(false);
@@ -1044,6 +1330,7 @@ void ConfigWindow::changeToIndex(const QModelIndex & index)
     a2dVariableMenu->setEnabled(true);
     editA2DVariableAction->setEnabled(true);
     deleteA2DVariableAction->setEnabled(true);
+    setA2DVariableRatesAction->setEnabled(true);
     variableMenu->setEnabled(false);
     tableview->setSortingEnabled(true);
     tableview->sortByColumn(0, Qt::AscendingOrder);
@@ -1056,6 +1343,7 @@ void ConfigWindow::changeToIndex(const QModelIndex & index)
     a2dVariableMenu->setEnabled(true);
     editA2DVariableAction->setEnabled(true);
     deleteA2DVariableAction->setEnabled(true);
+    setA2DVariableRatesAction->setEnabled(false);
     variableMenu->setEnabled(false);
     tableview->setSortingEnabled(true);
     tableview->sortByColumn(0, Qt::AscendingOrder);
@@ -1076,13 +1364,18 @@ void ConfigWindow::changeToIndex(const QModelIndex & index)
 /**
  * Construct the Sensor Catalog drop-down
  *
- * Pulls the devicename and suffix from the sensor line as well.
+ * Sensor names come from the Document's sensor catalog index, which also
+ * holds the devicename and suffix the dialog fills in for each.
  */
 void ConfigWindow::buildSensorCatalog()
 {
-Project *project = Project::getInstance();
+    const SensorCatalogIndex & catalog = _doc->getSensorCatalogIndex();
 
-    if(!project->getSensorCatalog()) {
+    // the dialog looks up each sensor's suffix and devicename in the
+    // Document's catalog index as sensors are selected
+    sensorComboDialog->setDocument(_doc);
+
+    if(catalog.empty()) {
         cerr<<"Configuration file doesn't contain a Sensor catalog!!"<<endl;
         return;
     }
@@ -1092,30 +1385,13 @@ Project *project = Project::getInstance();
     sensorComboDialog->SensorBox->clear();
     sensorComboDialog->SensorBox->addItem("ANALOG_DMMAT");
     sensorComboDialog->SensorBox->addItem("ANALOG_NCAR");
-    sensorComboDialog->clearSfxMap();
-    sensorComboDialog->clearDevMap();
-
-    xercesc::DOMElement* sensorElem;
-    map<string,xercesc::DOMElement*>::const_iterator mi;
-    const map<std::string,xercesc::DOMElement*>& scMap = 
-                                        project->getSensorCatalog()->getMap();
-    for (mi = scMap.begin(); mi != scMap.end(); mi++) {
-        cerr<<"   - adding sensor:"<<(*mi).first<<endl;
-        sensorComboDialog->SensorBox->addItem(QString::fromStdString(mi->first));
-
-        sensorElem = mi->second;
-        XDOMElement xnode((DOMElement *) sensorElem);
-
-        const std::string& sSfxName = xnode.getAttributeValue("suffix");
-        sensorComboDialog->addSensorSfx(QString::fromStdString(mi->first),
-                                        QString::fromStdString(sSfxName));
-
-        const std::string& sDevName = xnode.getAttributeValue("devicename");
-        sensorComboDialog->addSensorDev(QString::fromStdString(mi->first),
-                                        QString::fromStdString(sDevName));
+
+    const vector<std::string> & names = catalog.getSensorNames();
+    for (size_t i = 0; i < names.size(); i++) {
+        cerr<<"   - adding sensor:"<<names[i]<<endl;
+        sensorComboDialog->SensorBox->addItem(QString::fromStdString(names[i]));
     }
 
-    sensorComboDialog->setDocument(_doc);
     return;
 }
 
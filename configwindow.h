@@ -49,6 +49,7 @@
 #include "AddA2DVariableComboDialog.h"
 #include "VariableComboDialog.h"
 #include "NewProjectDialog.h"
+#include "CalDirWatcher.h"
 #include "exceptions/UserFriendlyExceptionHandler.h"
 
 #include "nidas_qmv/NidasModel.h"
@@ -56,6 +57,7 @@
 #include <QTreeView>
 #include <QTableView>
 #include <QSplitter>
+#include <QFutureWatcher>
 
 #include <iostream>
 #include <fstream>
@@ -71,6 +73,9 @@ class QAction;
 class QActionGroup;
 class QLabel;
 class QMenu;
+class QUndoGroup;
+class QDockWidget;
+class QTreeWidget;
 
 class ConfigWindow : public QMainWindow
 {
@@ -111,15 +116,25 @@ public slots:
     void addA2DVariableCombo();
     void editVariableCombo();
     void deleteA2DVariable();
+    void moveSensors();
+    void setA2DVariableRates();
+    void compareWithFile();
     void quit();
     void changeToIndex(const QModelIndex&);
     void changeToIndex(const QItemSelection&);
     void setFilename(QString filename) { _filename = filename; return; }
     void writeProjectName(QString projName);
+    void validationDone();
+    void lintProblemsChanged();
+    void engCalFileAdded(const QString & path);
+    void engCalFileChanged(const QString & path);
+    void engCalFileRemoved(const QString & path);
+    void engCalDirStale(const QString & dir);
 
 private:
     void buildMenus();
     void buildFileMenu();
+    void buildEditMenu();
     void buildWindowMenu();
     void buildAddMenu();
     void buildSensorCatalog();
@@ -133,6 +148,8 @@ private:
     void buildA2DVariableMenu();
     void buildA2DVariableActions();
     void buildProjectMenu();
+    void setupDiffPane();
+    void setupLintPane();
 
     UserFriendlyExceptionHandler * exceptionHandler;
     AddSensorComboDialog *sensorComboDialog;
@@ -160,19 +177,31 @@ private:
     bool fileExists(QString filename);
     QString _filename;
     bool _fileOpen;
-    bool saveFileCopy(std::string origFile);
     bool askSaveFileAndContinue();
 
     void setupModelView(QSplitter *splitter);
+    QList<NidasItem*> selectedItems();
+    void deleteSelected();
     NidasModel *model;
     QTreeView *treeview;
     QTableView *tableview;
     QSplitter *mainSplitter;
 
+    QAction *fastOpenAction;
+    QUndoGroup *_undoGroup;
+    QFutureWatcher<std::string> *_validationWatcher;
+    QString _validatingFile;
+    CalDirWatcher *_engCalWatcher;
+    QDockWidget *_diffDock;
+    QTreeWidget *_diffTree;
+    QDockWidget *_lintDock;
+    QTreeWidget *_lintTree;
+
     QMenu   *sensorMenu;
     QAction *addSensorAction;
     QAction *editSensorAction;
     QAction *deleteSensorAction;
+    QAction *moveSensorsAction;
     QMenu   *dsmMenu;
     QAction *addDSMAction;
     QAction *editDSMAction;
@@ -184,6 +213,7 @@ private:
     QAction *editA2DVariableAction;
     QAction *addA2DVariableAction;
     QAction *deleteA2DVariableAction;
+    QAction *setA2DVariableRatesAction;
 
 };
 #endif
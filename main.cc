@@ -30,13 +30,79 @@
  */
 
 #include <QApplication>
+#include <QCoreApplication>
 #include <iostream>
 #include <fstream>
+#include <string>
+#include <vector>
 
 #include "configwindow.h"
+#include "BatchEditor.h"
+#include "ConfigDiff.h"
+#include "ConfigMerge.h"
+#include "LintEngine.h"
+#include "ProjectScanner.h"
+#include "Profiler.h"
 
 int main(int argc, char *argv[])
 {
+    // set up profiling (CONFEDIT_PROFILE, CONFEDIT_TRACE) before any
+    // threads that might be timed are started
+    Profiler::getInstance();
+
+    // configedit --batch <script> applies the script's edits without
+    // bringing up any windows (see BatchEditor.h for the script format)
+    if (argc > 1 && std::string(argv[1]) == "--batch") {
+        if (argc != 3) {
+            std::cerr << "Usage: " << argv[0] << " --batch <script>\n";
+            return 1;
+        }
+        QCoreApplication app(argc, argv);
+        BatchEditor batch;
+        return batch.run(argv[2]);
+    }
+
+    // configedit --diff <a.xml> <b.xml> [<c.xml>...] prints what changed
+    // from each file to the next (see ConfigDiff.h)
+    if (argc > 1 && std::string(argv[1]) == "--diff") {
+        if (argc < 4) {
+            std::cerr << "Usage: " << argv[0]
+                      << " --diff <old.xml> <new.xml> [<newer.xml>...]\n";
+            return 2;
+        }
+        return ConfigDiff::run(std::vector<std::string>(argv+2, argv+argc));
+    }
+
+    // configedit --merge <base> <ours> <theirs> <output> merges without
+    // the GUI, e.g. as a git mergetool (see ConfigMerge.h)
+    if (argc > 1 && std::string(argv[1]) == "--merge") {
+        if (argc != 6) {
+            std::cerr << "Usage: " << argv[0]
+                      << " --merge <base.xml> <ours.xml> <theirs.xml>"
+                         " <output.xml>\n";
+            return 2;
+        }
+        return ConfigMerge::run(argv[2], argv[3], argv[4], argv[5]);
+    }
+
+    // configedit --scan [-j <threads>] [<dir>] checks every project's
+    // configurations under $PROJ_DIR (see ProjectScanner.h)
+    if (argc > 1 && std::string(argv[1]) == "--scan") {
+        QCoreApplication app(argc, argv);
+        return ProjectScanner::run(std::vector<std::string>(argv+2, argv+argc));
+    }
+
+    // configedit --lint <file.xml> prints what the lint rules find wrong
+    // with a configuration (see LintEngine.h)
+    if (argc > 1 && std::string(argv[1]) == "--lint") {
+        if (argc != 3) {
+            std::cerr << "Usage: " << argv[0] << " --lint <file.xml>\n";
+            return 2;
+        }
+        QCoreApplication app(argc, argv);
+        return LintEngine::run(argv[2]);
+    }
+
     QApplication app(argc, argv);
     ConfigWindow * configWin = new ConfigWindow();
     configWin->show();
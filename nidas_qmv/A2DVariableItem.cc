@@ -26,6 +26,7 @@
 
 #include "A2DVariableItem.h"
 #include "A2DSensorItem.h"
+#include "CalibrationCache.h"
 
 #include <exceptions/InternalProcessingException.h>
 
@@ -86,6 +87,17 @@ for (int i=0; i<children().size(); i++) {
   }
 }
 
+bool A2DVariableItem::forgetCalibration(const std::string & calFileName)
+{
+  VariableConverter * varConverter = _variable->getConverter();
+  if (!varConverter ||
+      !CalibrationCache::isFileNamed(varConverter->getCalFile(), calFileName))
+    return false;
+  _gotCalDate = _gotCalVals = false;
+  _calDate = _calVals = "";
+  return true;
+}
+
 QString A2DVariableItem::dataField(int column)
 {
   if (column == 0) return name();
@@ -113,34 +125,25 @@ QString A2DVariableItem::dataField(int column)
        if (calFile) {
           std::string calFileName = calFile->getFile();
           if (!_gotCalVals) {
-             nidas::util::UTime curTime, calTime;
-             nidas::core::Polynomial * poly =  new nidas::core::Polynomial();
-             try {
-                poly->setCalFile(calFile);
-                curTime = nidas::util::UTime();
-                curTime.format(true, "%Y%m%d:%H:%M:%S");
-                calTime = calFile->search(curTime);
-                calTime.format(true, "%Y%m%d:%H:%M:%S");
-                poly->readCalFile(calTime.toUsecs());
-                calString.append(QString::fromStdString(poly->toString()));
-                int lastQ = calString.lastIndexOf(QString::fromStdString("\""));
-                calString.insert(lastQ, QString::fromStdString(
-                                                 varConverter->getUnits()));
-                calString.remove("poly ");
-                _calVals = calString.toStdString();
-                _gotCalVals = true;
-                _calDate = calTime.format(true, "%m/%d/%Y");
-                _gotCalDate = true;
-             } catch (nidas::util::IOException &e) {
-                std::cerr<<__func__<<":ERROR: "<< e.toString()<<"\n";
-                return QString("ERROR: File is Missing");
-             } catch (nidas::util::ParseException &e) {
-                std::cerr<<__func__<<":ERROR: "<< e.toString()<<"\n";
-                return QString("ERROR: Parse Failed");
-             } catch (...) {
-                std::cerr<<__func__<<":ERROR: Unexpected Cal access error\n";
-                return QString("ERROR: Cal Access");
+             CalibrationCache::CalInfo cal;
+             if (!model->getCalibration(calFile, this, cal))
+               return NidasModel::CalLoadingText;
+             switch (cal.status) {
+               case CalibrationCache::CAL_OK:
+                 break;
+               case CalibrationCache::CAL_MISSING:
+                 return QString("ERROR: File is Missing");
+               case CalibrationCache::CAL_PARSE_FAILED:
+                 return QString("ERROR: Parse Failed");
+               default:
+                 return QString("ERROR: Cal Access");
              }
+             _calVals = CalibrationCache::calValuesString(cal,
+                                                   varConverter->getUnits());
+             _gotCalVals = true;
+             _calDate = cal.calDate;
+             _gotCalDate = true;
+             calString = QString::fromStdString(_calVals);
           } else {
              calString = QString::fromStdString(_calVals);
           }
@@ -171,23 +174,20 @@ QString A2DVariableItem::dataField(int column)
       CalFile * calFile = varConverter->getCalFile();
       if (calFile) {
         if (!_gotCalDate) {
-           nidas::util::UTime curTime, calTime;
-           nidas::core::Polynomial * poly =  new nidas::core::Polynomial();
-           try {
-             poly->setCalFile(calFile);
-             curTime = nidas::util::UTime();
-             curTime.format(true, "%Y%m%d:%H:%M:%S");
-             calTime = calFile->search(curTime);
-             _calDate = calTime.format(true, "%m/%d/%Y");
-             _gotCalDate = true;
-             return QString::fromStdString(calTime.format(true, "%m/%d/%Y"));
-           } catch (nidas::util::IOException &e) {
-             std::cerr<<__func__<<":ERROR: "<< e.toString()<<"\n";
-             return QString("ERROR: File is Missing");
-           } catch (nidas::util::ParseException &e) {
-             std::cerr<<__func__<<":ERROR: "<< e.toString()<<"\n";
-             return QString("ERROR: Parse Failed");
+           CalibrationCache::CalInfo cal;
+           if (!model->getCalibration(calFile, this, cal))
+             return NidasModel::CalLoadingText;
+           switch (cal.status) {
+             case CalibrationCache::CAL_OK:
+               break;
+             case CalibrationCache::CAL_MISSING:
+               return QString("ERROR: File is Missing");
+             default:
+               return QString("ERROR: Parse Failed");
            }
+           _calDate = cal.calDate;
+           _gotCalDate = true;
+           return QString::fromStdString(_calDate);
          } else
             return QString::fromStdString(_calDate);
       } else
@@ -208,32 +208,12 @@ QString A2DVariableItem::name()
 DOMNode* A2DVariableItem::findSampleDOMNode()
 {
 std::cerr<<"A2DVariableItem::findSampleDOMNode()\n";
-  DOMDocument *domdoc = model->getDOMDocument();
-  if (!domdoc) return(0);
-
-  // Get the DOM Node of the Sensor to which I belong
+  // Get the Sensor to which I belong
   SensorItem * sensorItem = dynamic_cast<SensorItem*>(parent());
   if (!sensorItem) return(0);
-  DOMNode * sensorNode = sensorItem->getDOMNode();
-
-  DOMNodeList * sampleNodes = sensorNode->getChildNodes();
 
-  DOMNode * sampleNode = 0;
-  unsigned int sampleId = _sampleTag->getSampleId();
-
-  for (XMLSize_t i = 0; i < sampleNodes->getLength(); i++)
-  {
-     DOMNode * sensorChild = sampleNodes->item(i);
-     if ( ((std::string)XMLStringConverter(sensorChild->getNodeName()))
-                 .find("sample") == std::string::npos ) continue;
-
-     XDOMElement xnode((DOMElement *)sampleNodes->item(i));
-     const std::string& sSampleId = xnode.getAttributeValue("id");
-     if ((unsigned int)atoi(sSampleId.c_str()) == sampleId) {
-       sampleNode = sampleNodes->item(i);
-       break;
-     }
-  }
+  DOMNode * sampleNode =
+                 sensorItem->findSampleDOMNode(_sampleTag->getSampleId());
 
   _sampleDOMNode = sampleNode;
   return(sampleNode);
@@ -392,36 +372,13 @@ std::string A2DVariableItem::getVarNameSfx()
 
 DOMNode* A2DVariableItem::findVariableDOMNode(QString name)
 {
-  DOMNode * sampleNode = getSampleDOMNode();
-std::cerr<<"A2DVariableItem::findVariableDOMNode - sampleNode = "
-         << sampleNode << "\n";
-
-if (!sampleNode) std::cerr<<"Did not find sample node in a2d variable item\n";
-
-  DOMNodeList * variableNodes = sampleNode->getChildNodes();
-  if (variableNodes == 0) {
-    std::cerr << "getChildNodes returns 0 \n";
-    throw InternalProcessingException("A2DVariableItem::findVariableDOMNode - getChildNodes return 0!");
-  }
+  // Get the Sensor to which I belong
+  SensorItem * sensorItem = dynamic_cast<SensorItem*>(parent());
+  if (!sensorItem) return(0);
 
-  DOMNode * variableNode = 0;
-  std::string variableName = name.toStdString();
-std::cerr<< "in A2DVariableItem::findVariableDOMNode - variable name = " << variableName <<"\n";
-std::cerr<< "found: "<<variableNodes->getLength()<<" variable nodes\n";
-
-  for (XMLSize_t i = 0; i < variableNodes->getLength(); i++)
-  {
-     DOMNode * variableChild = variableNodes->item(i);
-     if (((std::string)XMLStringConverter(variableChild->getNodeName())).find("variable")
-            == std::string::npos ) continue;
-
-     XDOMElement xnode((DOMElement *)variableNodes->item(i));
-     const std::string& sVariableName = xnode.getAttributeValue("name");
-     if (sVariableName.c_str() == variableName) {
-       variableNode = variableNodes->item(i);
-       break;
-     }
-  }
+  DOMNode * variableNode = sensorItem->findVariableDOMNode(
+                               _sampleTag->getSampleId(), name.toStdString());
+if (!variableNode) std::cerr<<"A2DVariableItem::findVariableDOMNode - did not find variable node for "<<name.toStdString()<<"\n";
 
   _variableDOMNode = variableNode;
   return(variableNode);
@@ -58,6 +58,8 @@ public:
 
     QString dataField(int column);
 
+    bool forgetCalibration(const std::string & calFileName);
+
     QString name();
     SampleTag *getSampleTag() const { return _sampleTag; }
     xercesc::DOMNode* getSampleDOMNode() {
@@ -0,0 +1,210 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2010, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+
+#include "CalibrationCache.h"
+#include "../Profiler.h"
+
+#include <nidas/core/DSMConfig.h>
+#include <nidas/core/VariableConverter.h>
+#include <nidas/util/Process.h>
+#include <nidas/util/IOException.h>
+#include <nidas/util/ParseException.h>
+
+#include <sys/stat.h>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+namespace n_u = nidas::util;
+
+static const long long USECS_PER_DAY_LL = 86400LL * 1000000LL;
+
+
+CalibrationCache * CalibrationCache::getInstance()
+{
+    // function static so that rows being filled in from worker threads
+    // can't race to create it
+    static CalibrationCache instance;
+    return &instance;
+}
+
+/*!
+ * \brief Find the file \a calFile would open: the first directory in its
+ *        (DSM and environment expanded, colon separated) path holding the
+ *        file.
+ *
+ * \return the full path, or just the file name if it can't be found.
+ */
+std::string CalibrationCache::resolvePath(const CalFile * calFile)
+{
+    std::string file = calFile->getFile();
+    std::string paths = calFile->getPath();
+    const DSMConfig * dsm = calFile->getDSMConfig();
+
+    istringstream ist(paths);
+    std::string dir;
+    while (getline(ist, dir, ':')) {
+        if (dsm) dir = dsm->expandString(dir);
+        dir = n_u::Process::expandEnvVars(dir);
+        if (dir.empty()) continue;
+        std::string path = dir;
+        if (path[path.size()-1] != '/') path += '/';
+        path += file;
+        struct stat st;
+        if (::stat(path.c_str(), &st) == 0) return path;
+    }
+    return file;
+}
+
+CalibrationCache::Key
+CalibrationCache::makeKey(const std::string & path, const n_u::UTime & t)
+{
+    Key key;
+    key.path = path;
+    struct stat st;
+    key.mtime = (::stat(key.path.c_str(), &st) == 0) ? st.st_mtime : 0;
+    key.day = t.toUsecs() / USECS_PER_DAY_LL;
+    return key;
+}
+
+bool CalibrationCache::find(const std::string & path, CalInfo & cal,
+                            const n_u::UTime & t)
+{
+    Key key = makeKey(path, t);
+
+    QMutexLocker locker(&_mutex);
+    std::map<Key, CalInfo>::const_iterator mi = _cache.find(key);
+    if (mi == _cache.end()) return false;
+    cal = mi->second;
+    return true;
+}
+
+CalibrationCache::CalInfo
+CalibrationCache::lookup(const std::string & path, const n_u::UTime & t)
+{
+    Key key = makeKey(path, t);
+
+    {
+        QMutexLocker locker(&_mutex);
+        std::map<Key, CalInfo>::const_iterator mi = _cache.find(key);
+        if (mi != _cache.end()) return mi->second;
+    }
+    Profiler::getInstance()->count("cal files read");
+
+    // Read outside the lock - two threads may occasionally both read the
+    // same file, but neither holds up rows for other files meanwhile.
+    CalInfo cal = readCal(path, t);
+
+    QMutexLocker locker(&_mutex);
+    // Anything else for this path is for an older mtime or day
+    Key first;
+    first.path = key.path;
+    first.mtime = -1;
+    first.day = -1;
+    std::map<Key, CalInfo>::iterator mi = _cache.lower_bound(first);
+    while (mi != _cache.end() && mi->first.path == key.path)
+        _cache.erase(mi++);
+    _cache[key] = cal;
+
+    return cal;
+}
+
+CalibrationCache::CalInfo
+CalibrationCache::readCal(const std::string & path, const n_u::UTime & t)
+{
+    ProfileScope ps("CalibrationCache::readCal");
+    CalInfo cal;
+
+    // A CalFile of our own for the resolved path, with no DSMConfig so
+    // nothing of the Project tree is touched off the GUI thread.  The
+    // Polynomial owns (and deletes) the CalFile it is given.
+    CalFile * cf = new CalFile();
+    size_t slash = path.rfind('/');
+    if (slash != std::string::npos) {
+        cf->setPath(path.substr(0, slash));
+        cf->setFile(path.substr(slash+1));
+    }
+    else cf->setFile(path);
+
+    nidas::core::Polynomial poly;
+    poly.setCalFile(cf);
+    try {
+        n_u::UTime calTime = cf->search(t);
+        poly.readCalFile(calTime.toUsecs());
+        cal.coefs = poly.toString();
+        cal.calDate = calTime.format(true, "%m/%d/%Y");
+        cal.status = CAL_OK;
+    } catch (n_u::IOException &e) {
+        std::cerr<<__func__<<":ERROR: "<< e.toString()<<"\n";
+        cal.status = CAL_MISSING;
+    } catch (n_u::ParseException &e) {
+        std::cerr<<__func__<<":ERROR: "<< e.toString()<<"\n";
+        cal.status = CAL_PARSE_FAILED;
+    } catch (...) {
+        std::cerr<<__func__<<":ERROR: Unexpected Cal access error\n";
+        cal.status = CAL_ERROR;
+    }
+    return cal;
+}
+
+std::string CalibrationCache::calValuesString(const CalInfo & cal,
+                                              const std::string & units)
+{
+    std::string calString = cal.coefs;
+    size_t lastQ = calString.rfind('"');
+    if (lastQ != std::string::npos) calString.insert(lastQ, units);
+    size_t poly = calString.find("poly ");
+    if (poly != std::string::npos) calString.erase(poly, 5);
+    return calString;
+}
+
+bool CalibrationCache::isFileNamed(const CalFile * calFile,
+                                   const std::string & calFileName)
+{
+    if (!calFile) return false;
+    if (calFileName.empty()) return true;
+    std::string file = calFile->getFile();
+    size_t slash = file.rfind('/');
+    if (slash != std::string::npos) file.erase(0, slash+1);
+    return file == calFileName;
+}
+
+void CalibrationCache::invalidate(const std::string & path)
+{
+    QMutexLocker locker(&_mutex);
+    std::map<Key, CalInfo>::iterator mi = _cache.begin();
+    while (mi != _cache.end()) {
+        if (mi->first.path == path) _cache.erase(mi++);
+        else ++mi;
+    }
+}
+
+void CalibrationCache::clear()
+{
+    QMutexLocker locker(&_mutex);
+    _cache.clear();
+}
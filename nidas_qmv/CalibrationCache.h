@@ -0,0 +1,134 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2010, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+
+#ifndef _CALIBRATION_CACHE_H
+#define _CALIBRATION_CACHE_H
+
+#include <nidas/core/CalFile.h>
+#include <nidas/util/UTime.h>
+
+#include <QMutex>
+
+#include <map>
+#include <string>
+
+using namespace nidas::core;
+
+
+/*!
+ * \brief Process wide cache of engineering calibrations read from cal files.
+ *
+ * Every VariableItem/A2DVariableItem that shows calibration columns needs
+ * the coefficients and date from its cal file at the current time.  Many
+ * variables share a cal file, so rather than each row searching and
+ * parsing the .dat file itself, rows ask here and each file is read once.
+ *
+ * Entries are keyed on the resolved file path, the file's modification
+ * time and the (UTC) day being looked up, so a cal file edited on disk
+ * is simply read again the next time it is asked for.
+ */
+class CalibrationCache
+{
+
+public:
+
+    static CalibrationCache * getInstance();
+
+    enum CalStatus { CAL_OK, CAL_MISSING, CAL_PARSE_FAILED, CAL_ERROR };
+
+    struct CalInfo {
+        CalInfo() : status(CAL_ERROR) {}
+        CalStatus status;
+        std::string coefs;      // Polynomial::toString() of the cal record
+        std::string calDate;    // "%m/%d/%Y" of the cal record
+    };
+
+    /*!
+     * \brief Calibration in effect at time \a t in the cal file at \a path,
+     *        as resolvePath() gives it.
+     *
+     * Only \a path is used, with no CalFile or DSMConfig of the Project
+     * tree, so this may be called on any thread.
+     */
+    CalInfo lookup(const std::string & path,
+                   const nidas::util::UTime & t = nidas::util::UTime());
+
+    /*!
+     * \brief Like lookup() but never reads the cal file.
+     *
+     * \return false, leaving \a cal alone, if the calibration isn't
+     *         already cached.
+     */
+    bool find(const std::string & path, CalInfo & cal,
+              const nidas::util::UTime & t = nidas::util::UTime());
+
+    /*!
+     * \brief The calibration coefficients as the variable tables show them,
+     *        i.e. with \a units inserted and without the leading "poly ".
+     */
+    static std::string calValuesString(const CalInfo & cal,
+                                       const std::string & units);
+
+    // Whether \a calFile reads the file named \a calFileName (no directory),
+    // or reads any file if \a calFileName is empty.
+    static bool isFileNamed(const CalFile * calFile,
+                            const std::string & calFileName);
+
+    // Drop cached entries for one resolved file path, or everything.
+    void invalidate(const std::string & path);
+    void clear();
+
+    /*!
+     * \brief The file \a calFile would open, expanded through its DSMConfig
+     *        and the environment.  Reads the Project tree, so call it on
+     *        the GUI thread only.
+     */
+    static std::string resolvePath(const CalFile * calFile);
+
+private:
+
+    CalibrationCache() {}
+
+    CalInfo readCal(const std::string & path, const nidas::util::UTime & t);
+
+    struct Key {
+        std::string path;
+        long mtime;
+        long long day;
+        bool operator<(const Key & k) const {
+            if (path != k.path) return path < k.path;
+            if (mtime != k.mtime) return mtime < k.mtime;
+            return day < k.day;
+        }
+    };
+
+    static Key makeKey(const std::string & path, const nidas::util::UTime & t);
+
+    std::map<Key, CalInfo> _cache;
+    QMutex _mutex;
+};
+
+#endif
@@ -0,0 +1,359 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2010, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+
+#include "DOMIndex.h"
+#include "../Profiler.h"
+
+#include <nidas/core/XDOM.h>
+
+#include <xercesc/util/XMLUniDefs.hpp>
+
+#include <sstream>
+#include <cstdlib>
+
+using namespace xercesc;
+using namespace std;
+
+using nidas::core::XDOMElement;
+using nidas::core::XMLStringConverter;
+
+// separates the parts of a key; not expected in site or variable names
+static const char KEY_SEP = '\x1f';
+
+// user data of the elements in an index, the element itself
+static const XMLCh USER_DATA_KEY[] = {
+  chLatin_D, chLatin_O, chLatin_M, chLatin_I, chLatin_n, chLatin_d,
+  chLatin_e, chLatin_x, chNull
+};
+
+
+DOMIndex::DOMIndex(DOMDocument *doc) : _doc(doc)
+{
+  rebuild();
+}
+
+DOMIndex::~DOMIndex()
+{
+  map<const DOMElement*, pair<Level, string> >::iterator ki;
+  for (ki = _keys.begin(); ki != _keys.end(); ++ki)
+    const_cast<DOMElement*>(ki->first)->setUserData(USER_DATA_KEY, 0, 0);
+}
+
+void DOMIndex::rebuild()
+{
+  for (int l = 0; l < NLEVELS; l++)
+    while (!_index[l].empty()) drop((Level)l, _index[l].begin());
+  if (!_doc) return;
+
+  ProfileScope ps("DOMIndex::rebuild");
+
+  indexSites();
+  for (map<string, DOMElement*>::iterator mi = _index[SITE].begin();
+       mi != _index[SITE].end(); ++mi)
+    indexChildren(DSM, mi->second, mi->first, true);
+}
+
+bool DOMIndex::isLevel(const DOMNode *node, Level level)
+{
+  if (node->getNodeType() != DOMNode::ELEMENT_NODE) return false;
+  string name = (string)XMLStringConverter(node->getNodeName());
+  switch (level) {
+    case SITE:     return name == "site";   // XXX also check "aircraft"
+    case DSM:      return name == "dsm";
+    case SENSOR:   return name.find("ensor") != string::npos;
+    case SAMPLE:   return name.find("sample") != string::npos;
+    case VARIABLE: return name.find("variable") != string::npos;
+    default:       return false;
+  }
+}
+
+/*
+ * The key part for one element: names are used as is, ids in decimal.
+ * Sample ids are read as SampleTag does, so 0 prefixed values are octal
+ * and 0x prefixed ones hex.
+ */
+string DOMIndex::keyOf(const DOMElement *elem, Level level)
+{
+  XDOMElement xnode(elem);
+  switch (level) {
+    case SITE:
+    case VARIABLE:
+      return xnode.getAttributeValue("name");
+    case SAMPLE: {
+      istringstream ist(xnode.getAttributeValue("id"));
+      unsigned int val = 0;
+      ist.unsetf(ios::dec);
+      ist >> val;
+      return idKey(val);
+    }
+    default:
+      return idKey(atoi(xnode.getAttributeValue("id").c_str()));
+  }
+}
+
+string DOMIndex::childKey(const string & parentKey, const string & key)
+{
+  return parentKey + KEY_SEP + key;
+}
+
+string DOMIndex::idKey(unsigned int id)
+{
+  ostringstream ost;
+  ost << id;
+  return ost.str();
+}
+
+/*
+ * Is elem still where the index says it is: a child of parent (or, for
+ * sites, in the document) with the key attribute it was indexed under?
+ */
+bool DOMIndex::isCurrent(const DOMElement *elem, Level level,
+                         const DOMElement *parent, const string & key) const
+{
+  if (level == SITE) {
+    const DOMNode *node = elem;
+    while (node->getParentNode()) node = node->getParentNode();
+    if (node != _doc) return false;
+  }
+  else if (elem->getParentNode() != parent) return false;
+
+  return keyOf(elem, level) == key;
+}
+
+/*
+ * Index elem under fullKey, replacing what was there and wherever elem
+ * was indexed before.
+ */
+void DOMIndex::put(Level level, const string & fullKey, DOMElement *elem)
+{
+  map<const DOMElement*, pair<Level, string> >::iterator ki = _keys.find(elem);
+  if (ki != _keys.end()) {
+    if (ki->second.first == level && ki->second.second == fullKey) return;
+    map<string, DOMElement*> & old = _index[ki->second.first];
+    map<string, DOMElement*>::iterator mi = old.find(ki->second.second);
+    if (mi != old.end() && mi->second == elem) old.erase(mi);
+  }
+
+  map<string, DOMElement*>::iterator mi = _index[level].find(fullKey);
+  if (mi != _index[level].end()) drop(level, mi);
+
+  _index[level][fullKey] = elem;
+  _keys[elem] = make_pair(level, fullKey);
+  elem->setUserData(USER_DATA_KEY, elem, this);
+}
+
+void DOMIndex::drop(Level level, map<string, DOMElement*>::iterator mi)
+{
+  DOMElement *elem = mi->second;
+  string fullKey = mi->first;
+  _index[level].erase(mi);
+
+  map<const DOMElement*, pair<Level, string> >::iterator ki = _keys.find(elem);
+  if (ki != _keys.end() && ki->second.first == level &&
+      ki->second.second == fullKey) {
+    _keys.erase(ki);
+    elem->setUserData(USER_DATA_KEY, 0, 0);
+  }
+}
+
+/// Drop the entry for fullKey at level and everything under it.
+void DOMIndex::dropUnder(Level level, const string & fullKey)
+{
+  map<string, DOMElement*>::iterator mi = _index[level].find(fullKey);
+  if (mi != _index[level].end()) drop(level, mi);
+
+  string prefix = fullKey + KEY_SEP;
+  for (int l = level + 1; l < NLEVELS; l++) {
+    map<string, DOMElement*> & index = _index[l];
+    mi = index.lower_bound(prefix);
+    while (mi != index.end() &&
+           mi->first.compare(0, prefix.size(), prefix) == 0)
+      drop((Level)l, mi++);
+  }
+}
+
+void DOMIndex::remove(const DOMElement *elem)
+{
+  map<const DOMElement*, pair<Level, string> >::iterator ki = _keys.find(elem);
+  if (ki == _keys.end()) return;
+  Level level = ki->second.first;
+  string fullKey = ki->second.second;
+  dropUnder(level, fullKey);
+}
+
+void DOMIndex::add(DOMElement *elem)
+{
+  if (isLevel(elem, SITE)) {
+    indexSites();
+    string key = keyOf(elem, SITE);
+    map<string, DOMElement*>::iterator mi = _index[SITE].find(key);
+    if (mi != _index[SITE].end() && mi->second == elem)
+      indexChildren(DSM, elem, key, true);
+    return;
+  }
+
+  // under an indexed parent: index the parent's children at elem's level
+  DOMNode *parent = elem->getParentNode();
+  map<const DOMElement*, pair<Level, string> >::iterator ki =
+      _keys.find((const DOMElement *) parent);
+  if (!parent || ki == _keys.end() || ki->second.first + 1 >= NLEVELS)
+    return;
+  Level level = (Level)(ki->second.first + 1);
+  if (!isLevel(elem, level)) return;
+  string parentKey = ki->second.second;
+  indexChildren(level, (DOMElement *) parent, parentKey, true);
+}
+
+/*
+ * An indexed element is being release()d: forget it.  Its children,
+ * being released too, are forgotten by their own calls.
+ */
+#if XERCES_VERSION_MAJOR < 3
+void DOMIndex::handle(DOMOperationType operation, const XMLCh * const,
+                      void *data, const DOMNode *, const DOMNode *)
+#else
+void DOMIndex::handle(DOMOperationType operation, const XMLCh * const,
+                      void *data, const DOMNode *, DOMNode *)
+#endif
+{
+  if (operation != NODE_DELETED) return;
+
+  const DOMElement *elem = (const DOMElement *) data;
+  map<const DOMElement*, pair<Level, string> >::iterator ki = _keys.find(elem);
+  if (ki == _keys.end()) return;
+  map<string, DOMElement*> & index = _index[ki->second.first];
+  map<string, DOMElement*>::iterator mi = index.find(ki->second.second);
+  if (mi != index.end() && mi->second == elem) index.erase(mi);
+  _keys.erase(ki);
+  Profiler::getInstance()->count("DOMIndex released elements");
+}
+
+void DOMIndex::indexSites()
+{
+  while (!_index[SITE].empty()) drop(SITE, _index[SITE].begin());
+  DOMNodeList * siteNodes =
+      _doc->getElementsByTagName((const XMLCh*)XMLStringConverter("site"));
+  for (XMLSize_t i = 0; i < siteNodes->getLength(); i++) {
+    DOMElement * siteElem = (DOMElement *)siteNodes->item(i);
+    string key = keyOf(siteElem, SITE);
+    if (_index[SITE].find(key) == _index[SITE].end())
+      put(SITE, key, siteElem);
+  }
+}
+
+/*
+ * (Re)index the level children of parent, whose own key is parentKey.
+ * Existing entries under parentKey at that level are dropped first; with
+ * recurse the grandchildren and below are indexed as well.
+ */
+void DOMIndex::indexChildren(Level level, DOMElement *parent,
+                             const string & parentKey, bool recurse)
+{
+  map<string, DOMElement*> & index = _index[level];
+  string prefix = parentKey + KEY_SEP;
+  map<string, DOMElement*>::iterator mi = index.lower_bound(prefix);
+  while (mi != index.end() && mi->first.compare(0, prefix.size(), prefix) == 0)
+    drop(level, mi++);
+
+  // Sites, DSMs and sensors go by the first definition, samples and
+  // variables by the last, as in Nidas.
+  bool keepFirst = (level == DSM || level == SENSOR);
+
+  for (DOMNode * child = parent->getFirstChild(); child;
+       child = child->getNextSibling())
+  {
+    if (!isLevel(child, level)) continue;
+    DOMElement * elem = (DOMElement *)child;
+    string key = childKey(parentKey, keyOf(elem, level));
+    if (keepFirst && index.find(key) != index.end()) continue;
+    put(level, key, elem);
+  }
+
+  if (!recurse || level == VARIABLE) return;
+
+  Level next = (Level)(level + 1);
+  for (mi = index.lower_bound(prefix);
+       mi != index.end() && mi->first.compare(0, prefix.size(), prefix) == 0;
+       ++mi)
+    indexChildren(next, mi->second, mi->first, true);
+}
+
+DOMElement *DOMIndex::lookup(Level level, DOMElement *parent,
+                             const string & parentKey, const string & key)
+{
+  if (level != SITE && !parent) return 0;
+
+  string fullKey = (level == SITE) ? key : childKey(parentKey, key);
+  map<string, DOMElement*>::iterator mi = _index[level].find(fullKey);
+  if (mi != _index[level].end() &&
+      isCurrent(mi->second, level, parent, key))
+    return mi->second;
+
+  // Not there or out of date: look at this parent's children again
+  Profiler::getInstance()->count("DOMIndex reindexes");
+  if (level == SITE) indexSites();
+  else indexChildren(level, parent, parentKey, false);
+
+  mi = _index[level].find(fullKey);
+  if (mi == _index[level].end()) return 0;
+  return mi->second;
+}
+
+DOMElement *DOMIndex::site(const string & siteName)
+{
+  return lookup(SITE, 0, string(), siteName);
+}
+
+DOMElement *DOMIndex::dsm(const string & siteName, unsigned int dsmId)
+{
+  return lookup(DSM, site(siteName), siteName, idKey(dsmId));
+}
+
+DOMElement *DOMIndex::sensor(const string & siteName, unsigned int dsmId,
+                             unsigned int sensorId)
+{
+  string dsmKey = childKey(siteName, idKey(dsmId));
+  return lookup(SENSOR, dsm(siteName, dsmId), dsmKey, idKey(sensorId));
+}
+
+DOMElement *DOMIndex::sample(const string & siteName, unsigned int dsmId,
+                             unsigned int sensorId, unsigned int sampleId)
+{
+  string sensorKey = childKey(childKey(siteName, idKey(dsmId)),
+                              idKey(sensorId));
+  return lookup(SAMPLE, sensor(siteName, dsmId, sensorId), sensorKey,
+                idKey(sampleId));
+}
+
+DOMElement *DOMIndex::variable(const string & siteName, unsigned int dsmId,
+                               unsigned int sensorId, unsigned int sampleId,
+                               const string & varName)
+{
+  string sampleKey = childKey(childKey(childKey(siteName, idKey(dsmId)),
+                                       idKey(sensorId)), idKey(sampleId));
+  return lookup(VARIABLE, sample(siteName, dsmId, sensorId, sampleId),
+                sampleKey, varName);
+}
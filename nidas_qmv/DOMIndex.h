@@ -0,0 +1,141 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2010, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+
+#ifndef _DOM_INDEX_H
+#define _DOM_INDEX_H
+
+#include <xercesc/dom/DOMDocument.hpp>
+#include <xercesc/dom/DOMElement.hpp>
+#include <xercesc/dom/DOMUserDataHandler.hpp>
+#include <xercesc/util/XercesVersion.hpp>
+
+#include <map>
+#include <string>
+#include <utility>
+
+
+/*!
+ * \brief Index of the site, dsm, sensor, sample and variable elements
+ *        of a configuration DOM document.
+ *
+ * Maps (site name[, dsm id[, sensor id[, sample id[, variable name]]]])
+ * to the DOMElement defining that object so the NidasItems find their
+ * DOM nodes without scanning the tree.  Sites, DSMs and sensors resolve
+ * to the first matching element, samples and variables to the last one
+ * since that is the definition Nidas uses.
+ *
+ * Code that removes or puts back whole sites, DSMs or sensors tells the
+ * index with remove() and add().  Beyond that the index repairs itself:
+ * a cached element is checked against its parent and key attribute on
+ * every lookup, and a miss or stale entry causes just that parent's
+ * children to be indexed again, so samples and variables added or
+ * renumbered by Document edits are picked up too.  Indexed elements
+ * carry user data that drops their entry when they are release()d,
+ * so a lookup never reads an element Xerces has taken back.
+ *
+ * Delete the index before releasing its document.
+ */
+class DOMIndex : private xercesc::DOMUserDataHandler
+{
+
+public:
+
+    DOMIndex(xercesc::DOMDocument *doc);
+    ~DOMIndex();
+
+    /// Index the whole document, discarding what was there.
+    void rebuild();
+
+    /// \a elem and what's in it are about to be removed from the document.
+    void remove(const xercesc::DOMElement *elem);
+
+    /// \a elem (a site, dsm, sensor ...) was put in the document.
+    void add(xercesc::DOMElement *elem);
+
+    xercesc::DOMElement *site(const std::string & siteName);
+    xercesc::DOMElement *dsm(const std::string & siteName, unsigned int dsmId);
+    xercesc::DOMElement *sensor(const std::string & siteName,
+                                unsigned int dsmId, unsigned int sensorId);
+    xercesc::DOMElement *sample(const std::string & siteName,
+                                unsigned int dsmId, unsigned int sensorId,
+                                unsigned int sampleId);
+    xercesc::DOMElement *variable(const std::string & siteName,
+                                  unsigned int dsmId, unsigned int sensorId,
+                                  unsigned int sampleId,
+                                  const std::string & varName);
+
+private:
+
+    enum Level { SITE, DSM, SENSOR, SAMPLE, VARIABLE, NLEVELS };
+
+    static bool isLevel(const xercesc::DOMNode *node, Level level);
+    static std::string keyOf(const xercesc::DOMElement *elem, Level level);
+    static std::string childKey(const std::string & parentKey,
+                                const std::string & key);
+    static std::string idKey(unsigned int id);
+
+    xercesc::DOMElement *lookup(Level level, xercesc::DOMElement *parent,
+                                const std::string & parentKey,
+                                const std::string & key);
+
+    bool isCurrent(const xercesc::DOMElement *elem, Level level,
+                   const xercesc::DOMElement *parent,
+                   const std::string & key) const;
+
+    void put(Level level, const std::string & fullKey,
+             xercesc::DOMElement *elem);
+    void drop(Level level,
+              std::map<std::string, xercesc::DOMElement*>::iterator mi);
+    void dropUnder(Level level, const std::string & fullKey);
+
+#if XERCES_VERSION_MAJOR < 3
+    void handle(DOMOperationType operation, const XMLCh * const key,
+                void *data, const xercesc::DOMNode *src,
+                const xercesc::DOMNode *dst);
+#else
+    void handle(DOMOperationType operation, const XMLCh * const key,
+                void *data, const xercesc::DOMNode *src,
+                xercesc::DOMNode *dst);
+#endif
+
+    void indexSites();
+    void indexChildren(Level level, xercesc::DOMElement *parent,
+                       const std::string & parentKey, bool recurse);
+
+    xercesc::DOMDocument *_doc;
+
+    std::map<std::string, xercesc::DOMElement*> _index[NLEVELS];
+
+    // where each indexed element is in _index
+    std::map<const xercesc::DOMElement*, std::pair<Level, std::string> >
+        _keys;
+
+    // No copying
+    DOMIndex(const DOMIndex &);
+    DOMIndex & operator=(const DOMIndex &);
+};
+
+#endif
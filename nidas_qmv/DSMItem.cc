@@ -26,9 +26,7 @@
 
 #include "DSMItem.h"
 #include "SensorItem.h"
-#include "A2DSensorItem.h"
-#include "DSC_A2DSensorItem.h"
-#include "PMSSensorItem.h"
+#include "SensorItemFactory.h"
 #include "NidasModel.h"
 
 #include <iostream>
@@ -74,22 +72,8 @@ NidasItem * DSMItem::child(int i)
     for (j=0, it = _dsm->getSensorIterator(); it.hasNext(); j++) {
         DSMSensor* sensor = it.next();
         if (j<i) continue; // skip old cached items (after it.next())
-//std::cerr << "Creating new SensorItem named : " << sensor->getName() << "\n";
-        NidasItem *childItem;
-        if (sensor->getClassName() == "raf.DSMAnalogSensor")
-          childItem = new A2DSensorItem(dynamic_cast<DSMAnalogSensor*>(sensor), j, model, this);
-        else if (sensor->getClassName() == "DSC_A2DSensor")
-          childItem = new DSC_A2DSensorItem(dynamic_cast<DSC_A2DSensor*>(sensor), j, model, this);
-        else if (sensor->getCatalogName() == "CDP" ||
-                 sensor->getCatalogName() == "Fast2DC" ||
-                 sensor->getCatalogName() == "S100" ||
-                 sensor->getCatalogName() == "S200" ||
-                 sensor->getCatalogName() == "S300" ||
-                 sensor->getCatalogName() == "TwoDP" ||
-                 sensor->getCatalogName() == "UHSAS")
-          childItem = new PMSSensorItem(sensor, j, model, this);
-        else
-          childItem = new SensorItem(sensor, j, model, this);
+        NidasItem *childItem =
+            SensorItemFactory::create(sensor, j, model, this);
         childItems.append( childItem);
         }
 
@@ -101,48 +85,21 @@ NidasItem * DSMItem::child(int i)
     return childItems[i];
 }
 
+bool DSMItem::hasChildItems()
+{
+    if (fetched) return !childItems.empty();
+    return _dsm->getSensorIterator().hasNext();
+}
+
 /// find the DOM node which defines this DSM
 DOMNode *DSMItem::findDOMNode()
 {
   DSMConfig *dsmConfig = getDSMConfig();
   if (dsmConfig == NULL) return(0);
-  DOMDocument *domdoc = model->getDOMDocument();
-  if (!domdoc) return(0);
-
-  DOMNodeList * SiteNodes = domdoc->getElementsByTagName((const XMLCh*)XMLStringConverter("site"));
-  // XXX also check "aircraft"
-
-  DOMNode * SiteNode = 0;
-  for (XMLSize_t i = 0; i < SiteNodes->getLength(); i++)
-  {
-     XDOMElement xnode((DOMElement *)SiteNodes->item(i));
-     const string& sSiteName = xnode.getAttributeValue("name");
-     if (sSiteName == dsmConfig->getSite()->getName()) {
-       cerr<<"getSiteNode - Found SiteNode with name:" << sSiteName << endl;
-       SiteNode = SiteNodes->item(i);
-       break;
-     }
-  }
-
-
-  DOMNodeList * DSMNodes = SiteNode->getChildNodes();
+  if (!model->getDOMDocument()) return(0);
 
-  DOMNode * DSMNode = 0;
-  int dsmId = dsmConfig->getId();
-
-  for (XMLSize_t i = 0; i < DSMNodes->getLength(); i++)
-  {
-     DOMNode * siteChild = DSMNodes->item(i);
-     if ((string)XMLStringConverter(siteChild->getNodeName()) != string("dsm")) continue;
-
-     XDOMElement xnode((DOMElement *)DSMNodes->item(i));
-     const string& sDSMId = xnode.getAttributeValue("id");
-     if (atoi(sDSMId.c_str()) == dsmId) {
-       cerr<<"getDSMNode - Found DSMNode with id:" << sDSMId << endl;
-       DSMNode = DSMNodes->item(i);
-       break;
-     }
-  }
+  DOMNode * DSMNode = model->getDOMIndex()->dsm(
+                          dsmConfig->getSite()->getName(), dsmConfig->getId());
 
   domNode = DSMNode;
   return(DSMNode);
@@ -254,6 +211,7 @@ cerr << " deleting device " << deleteDevice << "\n";
 
           if (device == deleteDevice)
           {
+             model->getDOMIndex()->remove((xercesc::DOMElement*) child);
              xercesc::DOMNode* removableChld = dsmNode->removeChild(child);
              removableChld->release();
           }
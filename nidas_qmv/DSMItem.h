@@ -46,6 +46,7 @@ public:
     ~DSMItem();
 
     NidasItem * child(int i);
+    bool hasChildItems();
 
     void fromDOM();
 
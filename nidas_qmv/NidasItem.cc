@@ -95,12 +95,34 @@ int NidasItem::childCount()
     return(0);
 }
 
+/*!
+ * \brief Put \a item in the children at \a row, its object's place in
+ *        the Project, and number those after it again.
+ */
+void NidasItem::insertChild(int row, NidasItem *item)
+{
+    if (row < 0 || row > childItems.size()) row = childItems.size();
+    childItems.insert(row, item);
+    for (int i = row; i < childItems.size(); i++)
+        childItems[i]->rowNumber = i;
+}
+
+/*!
+ * \brief Delete children \a first through \a last, which removes them
+ *        from the Project and DOM trees (see removeChild()), and number
+ *        the rest again in one pass.
+ */
 bool NidasItem::removeChildren(int first, int last)
 {
-    // XXX check first/last within QList range and/or catch Qt's exception
-    for (; first <= last; last--)
-        delete childItems.takeAt(first);
-    for (; first < childItems.size(); first++)
-        childItems[first]->rowNumber = first;
+    if (first < 0 || last >= childItems.size() || first > last)
+        return false;
+
+    QList<NidasItem*> removed = childItems.mid(first, last-first+1);
+    childItems.erase(childItems.begin()+first, childItems.begin()+last+1);
+    for (int i = first; i < childItems.size(); i++)
+        childItems[i]->rowNumber = i;
+
+    for (int i = 0; i < removed.size(); i++)
+        delete removed[i];
     return true;
 }
@@ -84,8 +84,19 @@ public:
     int row() const { return rowNumber; }
     int childCount();
 
+        /*!
+         * Whether this item has any children, ideally answered from the
+         * nidas object without building the child items (see
+         * NidasModel::hasChildren()).
+         */
+    virtual bool hasChildItems() { return childCount() > 0; }
+
     bool removeChildren(int first, int last);
 
+        // child items built so far (childCount() builds them all)
+    int builtChildCount() const { return childItems.size(); }
+    void insertChild(int row, NidasItem *item);
+
         /*!
          * subclasses implement to remove \a item from Project tree
          * and remove and release from DOM tree
@@ -98,6 +109,17 @@ public:
 
     virtual QString dataField(int column) { return QString(); }
 
+        /*!
+         * Items that show calibrations from cal files implement to drop
+         * what they have shown from cal file \a calFileName (no
+         * directory), so it is looked up again.  An empty \a calFileName
+         * means any cal file.
+         *
+         * \return true if the item uses that file.
+         */
+    virtual bool forgetCalibration(const std::string & calFileName)
+        { return false; }
+
     /*!
      *
      * Asks the model to create an index for this item.
@@ -139,6 +161,13 @@ protected:
         // the Qt Model that owns/"controls" the items
     NidasModel *model;
 
+        // childItems have been shown to the model's views, i.e. fetched
+        // by NidasModel::fetchMore(); until then rowCount() is 0
+    bool fetched;
+
+    NidasItem() : domNode(0), parentItem(0), rowNumber(0), model(0),
+                  fetched(false) {}
+
     static const QVariant _Project_Label;
     static const QVariant _Site_Label;
     static const QVariant _DSM_Label;
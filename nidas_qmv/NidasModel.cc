@@ -36,12 +36,30 @@
 #include "NidasItem.h"
 #include "ProjectItem.h"
 #include "exceptions/InternalProcessingException.h"
+#include "../Profiler.h"
 
+#include <QtConcurrentRun>
+
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <set>
+#include <vector>
 using namespace std;
 
 
+const QString NidasModel::CalLoadingText = QString("Loading...");
+
+/*
+ * Runs on a pool thread.  path was resolved on the GUI thread, so nothing
+ * of the Project tree (which edits, deletes and undo change) is read here.
+ */
+static void loadCalibration(std::string path)
+{
+    CalibrationCache::getInstance()->lookup(path);
+}
+
+
 
 /*!
  * \brief Implements the Qt Model API for Nidas business model (Project tree and DOM tree)
@@ -56,11 +74,13 @@ NidasModel::NidasModel(nidas::core::Project *project, xercesc::DOMDocument *doc,
     //rootItem = new NidasItem(project, 0, this);
     rootItem = new ProjectItem(project, 0, this);
     domDoc = doc;
+    _domIndex = new DOMIndex(doc);
 }
 
 NidasModel::~NidasModel()
 {
     delete rootItem;
+    delete _domIndex;
 }
 
 Qt::ItemFlags NidasModel::flags(const QModelIndex &index) const
@@ -120,6 +140,84 @@ QVariant NidasModel::data(const QModelIndex &index, int role) const
     return item->dataField(index.column());
 }
 
+bool NidasModel::getCalibration(const CalFile *calFile, NidasItem *item,
+                                CalibrationCache::CalInfo & cal)
+{
+    CalibrationCache * cache = CalibrationCache::getInstance();
+    std::string path = CalibrationCache::resolvePath(calFile);
+    if (cache->find(path, cal)) return true;
+
+    QPersistentModelIndex index(item->createIndex());
+    QList<QPersistentModelIndex> & waiting = _calWaiting[path];
+    if (waiting.contains(index)) return false;
+    waiting.append(index);
+    if (waiting.size() > 1) return false;   // already being read
+
+    QFutureWatcher<void> * watcher = new QFutureWatcher<void>(this);
+    _calLoads[watcher] = path;
+    connect(watcher, SIGNAL(finished()), this, SLOT(calibrationLoaded()));
+    watcher->setFuture(QtConcurrent::run(loadCalibration, path));
+
+    return false;
+}
+
+void NidasModel::calibrationLoaded()
+{
+    QFutureWatcher<void> * watcher =
+                           static_cast<QFutureWatcher<void>*>(sender());
+    std::string path = _calLoads.take(watcher);
+    watcher->deleteLater();
+
+    QList<QPersistentModelIndex> waiting = _calWaiting[path];
+    _calWaiting.erase(path);
+
+    for (int i = 0; i < waiting.size(); i++) {
+        // rows deleted while the file was being read are no longer valid
+        if (!waiting[i].isValid()) continue;
+        QModelIndex first = waiting[i];
+        int lastCol = columnCount(first.parent()) - 1;
+        emit dataChanged(first, first.sibling(first.row(), lastCol));
+    }
+}
+
+void NidasModel::calFileChanged(const std::string & path)
+{
+    CalibrationCache * cache = CalibrationCache::getInstance();
+    size_t slash = path.rfind('/');
+    std::string calFileName =
+        (slash == std::string::npos) ? path : path.substr(slash+1);
+
+    cache->invalidate(path);
+    // looked up while it was missing, the file was keyed on its name
+    cache->invalidate(calFileName);
+
+    forgetCalibration(rootItem, calFileName);
+}
+
+void NidasModel::calFilesChanged()
+{
+    CalibrationCache::getInstance()->clear();
+    forgetCalibration(rootItem, std::string());
+}
+
+/*!
+ * \brief Have the items under \a item that have been built (i.e. Qt has
+ *        asked for) forget calibrations from \a calFileName.
+ */
+void NidasModel::forgetCalibration(NidasItem *item,
+                                   const std::string & calFileName)
+{
+    for (int i = 0; i < item->childItems.size(); i++) {
+        NidasItem *child = item->childItems[i];
+        if (child->forgetCalibration(calFileName) && item->fetched) {
+            QModelIndex first = child->createIndex();
+            int lastCol = columnCount(first.parent()) - 1;
+            emit dataChanged(first, first.sibling(first.row(), lastCol));
+        }
+        forgetCalibration(child, calFileName);
+    }
+}
+
 int NidasModel::rowCount(const QModelIndex &parent) const
 {
     if (parent.column() > 0)
@@ -127,7 +225,49 @@ int NidasModel::rowCount(const QModelIndex &parent) const
 
     NidasItem *parentItem = getItem(parent);
 
-    return parentItem->childCount();
+    // rows appear once fetched, see fetchMore()
+    if (!parentItem->fetched) return 0;
+    return parentItem->childItems.size();
+}
+
+bool NidasModel::hasChildren(const QModelIndex &parent) const
+{
+    if (parent.column() > 0)
+        return false;
+
+    return getItem(parent)->hasChildItems();
+}
+
+bool NidasModel::canFetchMore(const QModelIndex &parent) const
+{
+    if (parent.column() > 0)
+        return false;
+
+    return !getItem(parent)->fetched;
+}
+
+/*!
+ * \brief Build \a parent's child items, if nobody has yet, and show them.
+ *
+ * All of an item's children are made in one pass over its nidas object
+ * and inserted as one block of rows, the first time a view needs them.
+ */
+void NidasModel::fetchMore(const QModelIndex &parent)
+{
+    NidasItem *parentItem = getItem(parent);
+    if (parentItem->fetched) return;
+
+    ProfileScope ps("NidasModel::fetchMore");
+
+    int count = parentItem->childCount();   // builds the child items
+    if (count == 0) {
+        parentItem->fetched = true;
+        return;
+    }
+    beginInsertRows(parent, 0, count-1);
+    parentItem->fetched = true;
+    endInsertRows();
+    Profiler::getInstance()->count("rows fetched", count);
 }
 
 NidasItem *NidasModel::getItem(const QModelIndex &index) const
@@ -196,11 +336,16 @@ bool NidasModel::insertRows(int row, int count, const QModelIndex &parent)
 {
 if (!parent.isValid()) return false; // rather than default to root, which is a valid parent
 
+    NidasItem *parentItem = getItem(parent);
+
+    // Nothing shown yet: the new item is built along with the rest when
+    // the rows are fetched.
+    if (!parentItem->fetched) return true;
+
     beginInsertRows(parent, row, row+count-1);
 
     // insertion into actual model here
     // (already done by Document::addSensor() for old implementation -- move to here?)
-    NidasItem *parentItem = getItem(parent);
     if (!parentItem->child(row)) // force NidasItem update
         throw InternalProcessingException("Error inserting new item. Qt and Nidas models are out of sync. (NidasItem::child() returned NULL in NidasModel::insertRows)");
     for (int i = 0; i < parentItem->childCount(); i++) {
@@ -214,14 +359,19 @@ if (!parent.isValid()) return false; // rather than default to root, which is a
 
 bool NidasModel::removeRows(int row, int count, const QModelIndex &parent)
 {
-    beginRemoveRows(parent, row, row+count-1);
-
-    // removeIndexes() deletes the item
+    // removeChildren() deletes the items
     NidasItem *parentItem = getItem(parent);
-    parentItem->removeChildren(row,row+count-1);
+    if (count < 1 || row < 0 || row+count > parentItem->childItems.size())
+        return false;
+
+    // rows never fetched aren't in any view to be told about
+    if (!parentItem->fetched)
+        return parentItem->removeChildren(row,row+count-1);
 
+    beginRemoveRows(parent, row, row+count-1);
+    bool ok = parentItem->removeChildren(row,row+count-1);
     endRemoveRows();
-    return true;
+    return ok;
 }
 
 /*!
@@ -249,51 +399,125 @@ return dsmItem;
  */
 bool NidasModel::appendChild(NidasItem *parentItem)
 {
+   return appendChildren(parentItem, 1);
+}
+
+/*!
+ * \brief Add \a count children to \a parentItem (already added to
+ *        Project by e.g. Document::moveSensors()) with one insertRows().
+ *
+ * \sa appendChild()
+ */
+bool NidasModel::appendChildren(NidasItem *parentItem, int count)
+{
+   if (count < 1) return true;
    QModelIndex parentIndex = parentItem->createIndex();
+   if (!parentItem->fetched) {
+       // not shown yet, but bring any child items already built (e.g. by
+       // Document) up to date
+       int built = parentItem->childItems.size();
+       if (built) parentItem->child(built);
+       return true;
+   }
    int newRow = rowCount(parentIndex);
-   return insertRows(newRow,1,parentIndex);
+   return insertRows(newRow,count,parentIndex);
+}
+
+/*!
+ * \brief Show \a item, whose object was put at \a row among \a parentItem's
+ *        in the Project (e.g. by EditJournal::restoreDSM()), as that row.
+ *
+ * \a row must not be past parentItem->builtChildCount(); later rows are
+ * built from the Project when they are asked for.
+ */
+void NidasModel::insertChild(NidasItem *parentItem, int row, NidasItem *item)
+{
+   bool shown = parentItem->fetched;
+   if (shown) beginInsertRows(parentItem->createIndex(), row, row);
+   parentItem->insertChild(row, item);
+   if (shown) endInsertRows();
 }
 
 /*!
  * \brief Remove children for the \a selectedRows from the \a parentItem.
  *
- *        Hard work done in removeRows()
+ *        Hard work done in removeRowSet()
  *
- * \sa removeRows()
+ * \sa removeRowSet()
  */
 bool NidasModel::removeChildren(std::list <int> & selectedRows, NidasItem *parentItem)
 {
- QModelIndex parentIndex = parentItem->createIndex();
- std::list <int>::iterator iit;
- for (iit=selectedRows.begin(); iit!=selectedRows.end(); iit++)
-    if (!removeRows((*iit),1,parentIndex))
-        return false;
-return true;
+ std::vector<int> rows(selectedRows.begin(), selectedRows.end());
+ return removeRowSet(parentItem, rows);
 }
 
+/*!
+ * \brief Remove the items for the selected rows in \a indexList.
+ *
+ * Rows are grouped by parent and each run of adjacent rows is removed
+ * with one removeRows(), so deleting a block of variables or sensors
+ * is one pass over the parent's children rather than one per row.
+ * Rows under another row that is being removed go with it.
+ */
 bool NidasModel::removeIndexes(QModelIndexList indexList)
 {
-for (int i=0; i<indexList.size(); i++) {
-    QModelIndex index = indexList[i];
-    cerr << "removeIndexes i=" << i << " row=" << index.row() << " col=" << index.column() << "\n";
+    std::set<NidasItem*> items;
+    for (int i=0; i<indexList.size(); i++) {
+        QModelIndex index = indexList[i];
 
-        // the NidasItem for the selected row resides in column 0
-    if (index.column() != 0) continue;
+            // the NidasItem for the selected row resides in column 0
+        if (index.column() != 0) continue;
 
-    if (!index.isValid()) continue; // XXX where/how to destroy the rootItem (Project)
+        if (!index.isValid()) continue; // XXX where/how to destroy the rootItem (Project)
 
-    NidasItem *item = getItem(index);
+        items.insert(getItem(index));
+    }
 
-    if (!removeRows(item->row(),1,item->parent()->createIndex()))
-        return false;
+    std::map<NidasItem*, std::vector<int> > rowsByParent;
+    for (std::set<NidasItem*>::iterator it = items.begin();
+         it != items.end(); ++it) {
+        NidasItem *item = *it;
+        bool underRemoved = false;
+        for (NidasItem *p = item->parent(); p && !underRemoved; p = p->parent())
+            underRemoved = items.count(p) != 0;
+        if (!underRemoved)
+            rowsByParent[item->parent()].push_back(item->row());
+    }
 
-    //cerr << "removeIndexes after removeRows before delete item\n";
-    //delete item; // handles deletion of all business model data
-    //cerr << "removeIndexes after  delete item\n";
+    std::map<NidasItem*, std::vector<int> >::iterator pi;
+    for (pi = rowsByParent.begin(); pi != rowsByParent.end(); ++pi)
+        if (!removeRowSet(pi->first, pi->second))
+            return false;
+    return true;
+}
 
-    //item->deleteLater(); // handles deletion of all business model data
+/*!
+ * \brief Remove \a rows (in any order) of \a parentItem, a run of
+ *        adjacent rows at a time.
+ *
+ * The last run goes first, so the rows of the runs before it are still
+ * where they were.
+ */
+bool NidasModel::removeRowSet(NidasItem *parentItem, std::vector<int> rows)
+{
+    if (rows.empty()) return true;
+
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+    ProfileScope ps("NidasModel::removeRowSet");
+
+    QModelIndex parentIndex = parentItem->createIndex();
+    size_t end = rows.size();
+    while (end > 0) {
+        size_t start = end - 1;
+        while (start > 0 && rows[start-1] == rows[start] - 1) start--;
+        if (!removeRows(rows[start], end - start, parentIndex))
+            return false;
+        end = start;
     }
-return true;
+    Profiler::getInstance()->count("rows removed", rows.size());
+    return true;
 }
 
 
@@ -30,12 +30,24 @@
 #include <QAbstractItemModel>
 #include <QModelIndex>
 #include <QVariant>
+#include <QPersistentModelIndex>
+#include <QFutureWatcher>
+#include <QList>
+#include <QMap>
 
 #include <nidas/core/Project.h>
 class NidasItem;
 class ProjectItem;
 #include <xercesc/dom/DOMDocument.hpp>
 
+#include "CalibrationCache.h"
+#include "DOMIndex.h"
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
 
 class NidasModel : public QAbstractItemModel
 {
@@ -55,6 +67,11 @@ public:
     int rowCount(const QModelIndex &parent = QModelIndex()) const;
     int columnCount(const QModelIndex &parent = QModelIndex()) const;
 
+        // child NidasItems are built and shown when a view first asks
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const;
+    bool canFetchMore(const QModelIndex &parent) const;
+    void fetchMore(const QModelIndex &parent);
+
     QVariant headerData(int section, Qt::Orientation orientation, int role) const
        { return headerData(section, orientation, role, _currentRootIndex); }; 
 
@@ -63,14 +80,19 @@ public:
 
 
     bool appendChild(NidasItem *parentItem);
+    bool appendChildren(NidasItem *parentItem, int count);
+    void insertChild(NidasItem *parentItem, int row, NidasItem *item);
     bool insertRows(int row, int count, const QModelIndex &parent);
 
     bool removeIndexes(QModelIndexList indexList);
     bool removeChildren(std::list <int> & selectedRows, NidasItem *parentItem);
     bool removeRows(int row, int count, const QModelIndex &parent);
+    bool removeRowSet(NidasItem *parentItem, std::vector<int> rows);
 
     xercesc::DOMDocument *getDOMDocument() const { return domDoc; }
 
+    DOMIndex *getDOMIndex() const { return _domIndex; }
+
     void setCurrentRootIndex(const QModelIndex &index)
     {
       _currentRootIndex = index;
@@ -82,6 +104,32 @@ public:
 
     NidasItem *getRootItem() const { return rootItem; };
 
+    /*!
+     * \brief Calibration for \a calFile, for display in \a item's row,
+     *        without blocking the GUI on cal file reads.
+     *
+     * If the calibration is not in the CalibrationCache yet, the file is
+     * read on the global thread pool and false is returned; \a item's row
+     * gets a dataChanged() once it is loaded.
+     */
+    bool getCalibration(const CalFile *calFile, NidasItem *item,
+                        CalibrationCache::CalInfo & cal);
+
+    // shown in the calibration columns while the cal file is being read
+    static const QString CalLoadingText;
+
+    /*!
+     * \brief Cal file \a path was written, created or removed on disk:
+     *        drop what is cached from it and refresh the rows showing it.
+     */
+    void calFileChanged(const std::string & path);
+
+    /*!
+     * \brief A cal directory changed in ways that weren't seen:
+     *        drop every cached calibration and refresh the rows using one.
+     */
+    void calFilesChanged();
+
 protected:
 
     //QModelIndex findIndex(void *nidasData, NidasItem *startItem=0) const;
@@ -89,8 +137,18 @@ protected:
 private:
     NidasItem *rootItem;
     xercesc::DOMDocument *domDoc;
+    DOMIndex *_domIndex;
 
     QPersistentModelIndex  _currentRootIndex;
+
+        // cal file reads in flight, and the rows waiting on each file
+    QMap<QFutureWatcher<void>*, std::string> _calLoads;
+    std::map<std::string, QList<QPersistentModelIndex> > _calWaiting;
+
+    void forgetCalibration(NidasItem *item, const std::string & calFileName);
+
+private slots:
+    void calibrationLoaded();
 };
 
 #endif
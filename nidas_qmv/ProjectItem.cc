@@ -86,6 +86,12 @@ std::cerr << "getting next site\n";
 
 }
 
+bool ProjectItem::hasChildItems()
+{
+    if (fetched) return !childItems.empty();
+    return _project->getSiteIterator().hasNext();
+}
+
 
 /// find the DOM node which defines this Project
 DOMNode *ProjectItem::findDOMNode() 
@@ -44,6 +44,7 @@ public:
     ~ProjectItem();
 
     NidasItem * child(int i);
+    bool hasChildItems();
 
     bool removeChild(NidasItem *item);
 
@@ -0,0 +1,169 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2010, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+
+#include "ProjectSync.h"
+#include "../Profiler.h"
+
+#include <nidas/core/XDOM.h>
+
+#include <xercesc/dom/DOMNamedNodeMap.hpp>
+#include <xercesc/util/XMLString.hpp>
+
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+using namespace xercesc;
+using namespace std;
+
+using nidas::core::DSMConfig;
+using nidas::core::DSMSensor;
+using nidas::core::SampleTag;
+using nidas::core::SampleTagIterator;
+using nidas::core::XMLStringConverter;
+
+
+string ProjectSync::attribute(const DOMElement *elem, const string & name)
+{
+  return (string) XMLStringConverter(
+                   elem->getAttribute((const XMLCh*)XMLStringConverter(name)));
+}
+
+/*
+ * Do a and b have the same attributes with the same values, apart from
+ * the one named ignore?  Order doesn't matter: edits remove and re-add
+ * attributes they set.
+ */
+bool ProjectSync::sameAttributes(const DOMElement *a, const DOMElement *b,
+                                 const string & ignore)
+{
+  const DOMNamedNodeMap *aAttrs = a->getAttributes();
+  const DOMNamedNodeMap *bAttrs = b->getAttributes();
+
+  XMLSize_t na = 0, nb = 0;
+  for (XMLSize_t i = 0; i < aAttrs->getLength(); i++) {
+    const DOMNode *attr = aAttrs->item(i);
+    if ((string) XMLStringConverter(attr->getNodeName()) == ignore) continue;
+    na++;
+    if (!b->hasAttribute(attr->getNodeName())) return false;
+    if (!XMLString::equals(attr->getNodeValue(),
+                           b->getAttribute(attr->getNodeName())))
+      return false;
+  }
+  for (XMLSize_t i = 0; i < bAttrs->getLength(); i++)
+    if ((string) XMLStringConverter(bAttrs->item(i)->getNodeName()) != ignore)
+      nb++;
+  return na == nb;
+}
+
+SampleTag *ProjectSync::findSample(DSMSensor *sensor, unsigned int sampleId)
+{
+  for (SampleTagIterator it = sensor->getSampleTagIterator(); it.hasNext(); ) {
+    SampleTag *sampleTag = (SampleTag*)it.next(); // XXX cast from const
+    if (sampleTag->getSampleId() == sampleId) return sampleTag;
+  }
+  return 0;
+}
+
+void ProjectSync::wholeSensor(DSMSensor *sensor, DOMElement *sensorElem)
+{
+  Profiler::getInstance()->count("ProjectSync whole sensor re-reads");
+  sensor->fromDOMElement(sensorElem);
+}
+
+void ProjectSync::sensor(DSMSensor *sensor, const DOMElement *before,
+                         DOMElement *after)
+{
+  ProfileScope ps("ProjectSync::sensor");
+
+  if (!before || !sameAttributes(before, after, "devicename")) {
+    wholeSensor(sensor, after);
+    return;
+  }
+
+  // Pair up the child elements: only changed samples can be re-read on
+  // their own
+  vector<pair<SampleTag*, DOMElement*> > samples;
+  const DOMNode *b = before->getFirstChild();
+  DOMNode *a = after->getFirstChild();
+  for (;;) {
+    while (b && b->getNodeType() != DOMNode::ELEMENT_NODE)
+      b = b->getNextSibling();
+    while (a && a->getNodeType() != DOMNode::ELEMENT_NODE)
+      a = a->getNextSibling();
+    if (!a || !b) break;
+
+    if (!a->isEqualNode(b)) {
+      DOMElement *aElem = (DOMElement*) a;
+      const DOMElement *bElem = (const DOMElement*) b;
+      SampleTag *sampleTag = 0;
+      if ((string) XMLStringConverter(a->getNodeName()) == "sample" &&
+          XMLString::equals(a->getNodeName(), b->getNodeName()) &&
+          attribute(aElem, "id") == attribute(bElem, "id"))
+        sampleTag = findSample(sensor,
+                         strtoul(attribute(aElem, "id").c_str(), 0, 0));
+      if (!sampleTag) {
+        wholeSensor(sensor, after);
+        return;
+      }
+      samples.push_back(make_pair(sampleTag, aElem));
+    }
+    a = a->getNextSibling();
+    b = b->getNextSibling();
+  }
+  if (a || b) {         // an element was added or removed
+    wholeSensor(sensor, after);
+    return;
+  }
+
+  string device = attribute(after, "devicename");
+  if (device != sensor->getDeviceName()) sensor->setDeviceName(device);
+
+  for (size_t i = 0; i < samples.size(); i++)
+    sample(samples[i].first, samples[i].second);
+}
+
+void ProjectSync::sample(SampleTag *sampleTag, DOMElement *sampleElem)
+{
+  Profiler::getInstance()->count("ProjectSync sample re-reads");
+  sampleTag->fromDOMElement(sampleElem);
+}
+
+void ProjectSync::dsm(DSMConfig *dsm, DOMElement *dsmElem)
+{
+  ProfileScope ps("ProjectSync::dsm");
+
+  // a new DSM id goes into every sensor's and sample's ids
+  unsigned long id = strtoul(attribute(dsmElem, "id").c_str(), 0, 0);
+  if (id != dsm->getId()) {
+    Profiler::getInstance()->count("ProjectSync whole DSM re-reads");
+    dsm->fromDOMElement(dsmElem);
+    return;
+  }
+
+  dsm->setName(attribute(dsmElem, "name"));
+  dsm->setLocation(attribute(dsmElem, "location"));
+}
@@ -0,0 +1,87 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2010, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+
+#ifndef _PROJECT_SYNC_H
+#define _PROJECT_SYNC_H
+
+#include <xercesc/dom/DOMElement.hpp>
+
+#include <nidas/core/DSMConfig.h>
+#include <nidas/core/DSMSensor.h>
+#include <nidas/core/SampleTag.h>
+
+#include <string>
+
+
+/*!
+ * \brief Brings the nidas Project tree up to date with DOM edits by
+ *        re-reading only what the edit changed.
+ *
+ * After an edit, Document used to run fromDOMElement() on the whole
+ * DSMConfig or DSMSensor (sometimes both, and more than once), re-reading
+ * every sample and variable under it.  Given the element as it was
+ * before the edit and as it is now, ProjectSync works out which samples
+ * changed and re-reads just those SampleTags (and so their Variables),
+ * and applies attribute-only changes with setters.
+ *
+ * Changes it can't apply piecemeal - a new or removed sample, a changed
+ * sensor id or suffix, sensor parameters or cal files - fall back to
+ * re-reading the whole object, as before.
+ */
+class ProjectSync
+{
+
+public:
+
+    /// Re-read whatever differs between \a before and \a after (the
+    /// sensor's element now) into \a sensor.
+    static void sensor(nidas::core::DSMSensor *sensor,
+                       const xercesc::DOMElement *before,
+                       xercesc::DOMElement *after);
+
+    /// Re-read the one sample \a sampleElem defines into \a sampleTag.
+    static void sample(nidas::core::SampleTag *sampleTag,
+                       xercesc::DOMElement *sampleElem);
+
+    /// Bring \a dsm's name and location up to date with \a dsmElem,
+    /// re-reading the whole DSM only if its id changed.
+    static void dsm(nidas::core::DSMConfig *dsm,
+                    xercesc::DOMElement *dsmElem);
+
+private:
+
+    static std::string attribute(const xercesc::DOMElement *elem,
+                                 const std::string & name);
+    static bool sameAttributes(const xercesc::DOMElement *a,
+                               const xercesc::DOMElement *b,
+                               const std::string & ignore);
+    static nidas::core::SampleTag *findSample(nidas::core::DSMSensor *sensor,
+                                              unsigned int sampleId);
+    static void wholeSensor(nidas::core::DSMSensor *sensor,
+                            xercesc::DOMElement *sensorElem);
+};
+
+#endif
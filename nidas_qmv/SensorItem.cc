@@ -118,6 +118,16 @@ NidasItem * SensorItem::child(int i)
     return childItems[i];
 }
 
+bool SensorItem::hasChildItems()
+{
+    if (fetched) return !childItems.empty();
+    for (SampleTagIterator it = _sensor->getSampleTagIterator(); it.hasNext();) {
+        SampleTag* sample = (SampleTag*)it.next(); // XXX cast from const
+        if (sample->getVariableIterator().hasNext()) return true;
+    }
+    return false;
+}
+
 void SensorItem::refreshChildItems()
 {
   while (!childItems.empty()) childItems.pop_front();
@@ -197,50 +207,16 @@ QString SensorItem::viewName()
 DOMNode * SensorItem::findDOMNode()
 {
 cerr<<"SensorItem::findDOMNode\n";
-  //DSMConfig *dsmConfig = getDSMConfig();
-  //if (dsmConfig == NULL) return(0);
-  DOMDocument *domdoc = model->getDOMDocument();
-  if (!domdoc) return(0);
-
-  //DOMNodeList * SiteNodes = domdoc->getElementsByTagName((const XMLCh*)XMLStringConverter("site"));
-  // XXX also check "aircraft"
+  if (!model->getDOMDocument()) return(0);
 
-  // Get the DOM Node of the DSM to which I belong
+  // Get the DSM to which I belong
   DSMItem * dsmItem = dynamic_cast<DSMItem*>(parent());
   if (!dsmItem) return(0);
-  DOMNode * DSMNode = dsmItem->getDOMNode();
+  DSMConfig * dsmConfig = dsmItem->getDSMConfig();
 
-  //for (XMLSize_t i = 0; i < SiteNodes->getLength(); i++)
-  //{
-     //XDOMElement xnode((DOMElement *)SiteNodes->item(i));
-     //const string& sSiteName = xnode.getAttributeValue("name");
-     //if (sSiteName == dsmConfig->getSite()->getName()) {
-       //cerr<<"getSiteNode - Found SiteNode with name:" << sSiteName << endl;
-       //SiteNode = SiteNodes->item(i);
-       //break;
-     //}
-  //}
-
-
-cerr<< "getting a list of sensors for DSM\n";
-  DOMNodeList * SensorNodes = DSMNode->getChildNodes();
-
-  DOMNode * SensorNode = 0;
-  int sensorId = _sensor->getSensorId();
-
-  for (XMLSize_t i = 0; i < SensorNodes->getLength(); i++)
-  {
-     DOMNode * dsmChild = SensorNodes->item(i);
-     if ( ((string)XMLStringConverter(dsmChild->getNodeName())).find("ensor") == string::npos ) continue;
-
-     XDOMElement xnode((DOMElement *)SensorNodes->item(i));
-     const string& sSensorId = xnode.getAttributeValue("id");
-     if (atoi(sSensorId.c_str()) == sensorId) {
-       cerr<<"getSensorNode - Found SensorNode with id:" << sSensorId << "\n";
-       SensorNode = SensorNodes->item(i);
-       break;
-     }
-  }
+  DOMNode * SensorNode = model->getDOMIndex()->sensor(
+                             dsmConfig->getSite()->getName(),
+                             dsmConfig->getId(), _sensor->getSensorId());
 
   domNode = SensorNode;
   return(SensorNode);
@@ -249,40 +225,42 @@ cerr<< "getting a list of sensors for DSM\n";
 /*!
  * \brief find the DOM node for the given sample tag
  *
- *  Search through the Sensor DOM Node children looking for nodes with
- *  the name sample and for every one found, see if the id attribute of
- *  that node is equal to the sampleId passed in.  Note that we search
- *  through all children of the sensor node because we want the last such
- *  node.  Nidas allows multiple definitions, using the last one as the
- *  'final' say so.
+ *  Looks up the sample node among this Sensor DOM Node's children in the
+ *  model's DOMIndex.  Note that we want the last such node: Nidas allows
+ *  multiple definitions, using the last one as the 'final' say so.
  */
 DOMNode * SensorItem::findSampleDOMNode(unsigned int sampleId)
 {
 cerr << "SensorItem::findSampleDOMNode\n";
 
-  DOMDocument *domdoc = model->getDOMDocument();
-  if (!domdoc) return(0);
+  if (!model->getDOMDocument()) return(0);
 
-  // Sample is part of this Sensor's DOM node
-  DOMNode * sensorNode = getDOMNode();
-  DOMNodeList * sampleNodes = sensorNode->getChildNodes();
-  DOMNode * sampleNode = 0;
+  DSMItem * dsmItem = dynamic_cast<DSMItem*>(parent());
+  if (!dsmItem) return(0);
+  DSMConfig * dsmConfig = dsmItem->getDSMConfig();
 
-  // Search through sample nodes to find our node
-  for (XMLSize_t i = 0; i < sampleNodes->getLength(); i++)
-  {
-     DOMNode * sensorChild = sampleNodes->item(i);
-     if ( ((string)XMLStringConverter(sensorChild->getNodeName())).find("sample") == string::npos ) continue;
-
-     XDOMElement xnode((DOMElement *)sampleNodes->item(i));
-     const string& sSampleId = xnode.getAttributeValue("id");
-     if ((unsigned int)atoi(sSampleId.c_str()) == sampleId) {
-       sampleNode = sampleNodes->item(i);
-       //break;  // We actually want the last node so no break!
-     }
-  }
+  return(model->getDOMIndex()->sample(dsmConfig->getSite()->getName(),
+                                      dsmConfig->getId(),
+                                      _sensor->getSensorId(), sampleId));
+}
+
+/*!
+ * \brief find the DOM node of the variable named \a varName in the sample
+ *  with id \a sampleId.  As with samples, the last such node is returned.
+ */
+DOMNode * SensorItem::findVariableDOMNode(unsigned int sampleId,
+                                          const std::string & varName)
+{
+  if (!model->getDOMDocument()) return(0);
+
+  DSMItem * dsmItem = dynamic_cast<DSMItem*>(parent());
+  if (!dsmItem) return(0);
+  DSMConfig * dsmConfig = dsmItem->getDSMConfig();
 
-  return(sampleNode);
+  return(model->getDOMIndex()->variable(dsmConfig->getSite()->getName(),
+                                        dsmConfig->getId(),
+                                        _sensor->getSensorId(), sampleId,
+                                        varName));
 }
 
 /*!
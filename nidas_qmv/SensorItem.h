@@ -49,6 +49,7 @@ public:
     ~SensorItem();
 
     NidasItem * child(int i);
+    bool hasChildItems();
     void refreshChildItems();
 
     void fromDOM();
@@ -86,6 +87,8 @@ public:
     DSMSensor *getDSMSensor() const { return _sensor; }
     //xercesc::DOMNode * findSampleDOMNode(SampleTag * sampleTag);
     xercesc::DOMNode * findSampleDOMNode(unsigned int sampleId);
+    xercesc::DOMNode * findVariableDOMNode(unsigned int sampleId,
+                                           const std::string & varName);
 
     // Subclass needs to set this, otherwise it's null string
     virtual std::string getSerialNumberString() { return(std::string()); }
@@ -0,0 +1,82 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+
+#include "SensorItemFactory.h"
+#include "SensorItem.h"
+#include "A2DSensorItem.h"
+#include "DSC_A2DSensorItem.h"
+#include "PMSSensorItem.h"
+
+
+SensorItemFactory::SensorItemFactory()
+{
+    _byClassName["raf.DSMAnalogSensor"] = A2D_SENSOR;
+    _byClassName["DSC_A2DSensor"] = DSC_A2D_SENSOR;
+
+    const char * pmsProbes[] =
+        { "CDP", "Fast2DC", "S100", "S200", "S300", "TwoDP", "UHSAS" };
+    for (size_t i = 0; i < sizeof(pmsProbes)/sizeof(pmsProbes[0]); i++)
+        _byCatalogName[pmsProbes[i]] = PMS_SENSOR;
+}
+
+const SensorItemFactory & SensorItemFactory::instance()
+{
+    static SensorItemFactory factory;
+    return factory;
+}
+
+SensorItemFactory::Kind SensorItemFactory::kindOf(const DSMSensor *sensor)
+                                                  const
+{
+    std::unordered_map<std::string, Kind>::const_iterator ki =
+        _byClassName.find(sensor->getClassName());
+    if (ki != _byClassName.end()) return ki->second;
+
+    ki = _byCatalogName.find(sensor->getCatalogName());
+    if (ki != _byCatalogName.end()) return ki->second;
+
+    return SENSOR;
+}
+
+/*!
+ * \brief A new item for \a sensor at \a row under the DSMItem \a parent.
+ */
+NidasItem * SensorItemFactory::create(DSMSensor *sensor, int row,
+                                      NidasModel *model, NidasItem *parent)
+{
+    switch (instance().kindOf(sensor)) {
+      case A2D_SENSOR:
+        return new A2DSensorItem(dynamic_cast<DSMAnalogSensor*>(sensor),
+                                 row, model, parent);
+      case DSC_A2D_SENSOR:
+        return new DSC_A2DSensorItem(dynamic_cast<DSC_A2DSensor*>(sensor),
+                                     row, model, parent);
+      case PMS_SENSOR:
+        return new PMSSensorItem(sensor, row, model, parent);
+      default:
+        return new SensorItem(sensor, row, model, parent);
+    }
+}
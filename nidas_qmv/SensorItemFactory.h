@@ -0,0 +1,70 @@
+/* -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*- */
+/* vim: set shiftwidth=4 softtabstop=4 expandtab: */
+/*
+ ********************************************************************
+ ** NIDAS: NCAR In-situ Data Acquistion Software
+ **
+ ** 2009, Copyright University Corporation for Atmospheric Research
+ **
+ ** This program is free software; you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** The LICENSE.txt file accompanying this software contains
+ ** a copy of the GNU General Public License. If it is not found,
+ ** write to the Free Software Foundation, Inc.,
+ ** 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ **
+ ********************************************************************
+*/
+
+#ifndef _SENSOR_ITEM_FACTORY_H
+#define _SENSOR_ITEM_FACTORY_H
+
+#include <nidas/core/DSMSensor.h>
+
+#include <string>
+#include <unordered_map>
+
+class NidasItem;
+class NidasModel;
+
+using namespace nidas::core;
+
+
+/*!
+ * \brief Makes the NidasItem of the right kind for a DSM's sensor.
+ *
+ * A2D cards are told apart by nidas class name and PMS probes by
+ * catalog name.  Both are looked up in tables built once, rather than
+ * comparing each sensor's names against every kind in turn.
+ */
+class SensorItemFactory
+{
+
+public:
+
+    static NidasItem * create(DSMSensor *sensor, int row,
+                              NidasModel *model, NidasItem *parent);
+
+private:
+
+    enum Kind { SENSOR, A2D_SENSOR, DSC_A2D_SENSOR, PMS_SENSOR };
+
+    SensorItemFactory();
+
+    static const SensorItemFactory & instance();
+
+    Kind kindOf(const DSMSensor *sensor) const;
+
+    std::unordered_map<std::string, Kind> _byClassName;
+    std::unordered_map<std::string, Kind> _byCatalogName;
+};
+
+#endif
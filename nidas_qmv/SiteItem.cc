@@ -86,6 +86,12 @@ NidasItem * SiteItem::child(int i)
     return childItems[i];
 }
 
+bool SiteItem::hasChildItems()
+{
+    if (fetched) return !childItems.empty();
+    return _site->getDSMConfigIterator().hasNext();
+}
+
 QString SiteItem::dataField(int column)
 {
   if (column == 0) return name();
@@ -110,25 +116,9 @@ DOMNode *SiteItem::findDOMNode() const
 {
 Site *site = getSite();
 if (site == NULL) return(0);
-DOMDocument *domdoc = model->getDOMDocument();
-if (!domdoc) return(0);
-
-  DOMNodeList * SiteNodes = domdoc->getElementsByTagName((const XMLCh*)XMLStringConverter("site"));
-  // XXX also check "aircraft"
-
-  DOMNode * SiteNode = 0;
-  for (XMLSize_t i = 0; i < SiteNodes->getLength(); i++) 
-  {
-     XDOMElement xnode((DOMElement *)SiteNodes->item(i));
-     const string& sSiteName = xnode.getAttributeValue("name");
-     if (sSiteName == _site->getName()) { 
-       cerr<<"getSiteNode - Found SiteNode with name:" << sSiteName << endl;
-       SiteNode = SiteNodes->item(i);
-       break;
-     }
-  }
+if (!model->getDOMDocument()) return(0);
 
-return(SiteNode);
+return(model->getDOMIndex()->site(site->getName()));
 }
 
 
@@ -190,6 +180,7 @@ cerr << " deleting DSM " << deleteDSM << " with id " << deleteDSMId <<"\n";
           if (dsmName == deleteDSM && dsmId == deleteDSMId) 
           {
              cerr <<  "   removing node with DSM name " << dsmName << "\n";
+             model->getDOMIndex()->remove((xercesc::DOMElement*) child);
              xercesc::DOMNode* removableChld = siteNode->removeChild(child);
              removableChld->release();
           }
@@ -44,6 +44,7 @@ public:
     ~SiteItem();
 
     NidasItem * child(int i);
+    bool hasChildItems();
 
     bool removeChild(NidasItem *item);
 
@@ -25,6 +25,7 @@
 */
 
 #include "VariableItem.h"
+#include "CalibrationCache.h"
 
 #include <exceptions/InternalProcessingException.h>
 
@@ -276,36 +277,13 @@ std::cerr<<"\n";
 
 DOMNode* VariableItem::findVariableDOMNode(QString name)
 {
-  DOMNode * sampleNode = getSampleDOMNode();
-std::cerr<<"VariableItem::findVariableDOMNode - sampleNode = " << sampleNode << "\n";
+  // Get the Sensor to which I belong
+  SensorItem * sensorItem = dynamic_cast<SensorItem*>(parent());
+  if (!sensorItem) return(0);
 
-if (!sampleNode) std::cerr<<"Did not find sample node in variable item";
-
-  DOMNodeList * variableNodes = sampleNode->getChildNodes();
-  if (variableNodes == 0) {
-    std::cerr << "getChildNodes returns 0 \n";
-    throw InternalProcessingException("A2DVariableItem::findVariableDOMNode - getChildNodes return 0!");     
-  }
-
-  DOMNode * variableNode = 0;
-  std::string variableName = name.toStdString();
-  std::cerr<< "in A2DVariableItem::findVariableDOMNode - variable name = " 
-         << variableName <<"\n";
-  std::cerr<< "found: "<<variableNodes->getLength()<<" variable nodes\n";
-
-  for (XMLSize_t i = 0; i < variableNodes->getLength(); i++)
-  {
-     DOMNode * variableChild = variableNodes->item(i);
-     if (((std::string)XMLStringConverter(variableChild->getNodeName())).
-            find("variable") == std::string::npos ) continue;
-
-     XDOMElement xnode((DOMElement *)variableNodes->item(i));
-     const std::string& sVariableName = xnode.getAttributeValue("name");
-     if (sVariableName.c_str() == variableName) {
-       variableNode = variableNodes->item(i);
-       //break;
-     }
-  }
+  DOMNode * variableNode = sensorItem->findVariableDOMNode(
+                               _sampleTag->getSampleId(), name.toStdString());
+if (!variableNode) std::cerr<<"VariableItem::findVariableDOMNode - did not find variable node for "<<name.toStdString()<<"\n";
 
   _variableDOMNode = variableNode;
   return(variableNode);
@@ -313,39 +291,13 @@ if (!sampleNode) std::cerr<<"Did not find sample node in variable item";
 
 DOMNode* VariableItem::findSampleDOMNode()
 {
-  std::cerr<<__func__<<"\n";
-  DOMDocument *domdoc = model->getDOMDocument();
-  if (!domdoc) return(0);
-
-  // Get the DOM Node of the Sensor to which I belong
+std::cerr<<"VariableItem::findSampleDOMNode()\n";
+  // Get the Sensor to which I belong
   SensorItem * sensorItem = dynamic_cast<SensorItem*>(parent());
   if (!sensorItem) return(0);
-  DOMNode * sensorNode = sensorItem->getDOMNode();
-
-  DOMNodeList * sampleNodes = sensorNode->getChildNodes();
-
-  DOMNode * sampleNode = 0;
-  unsigned int sampleId = _sampleTag->getSampleId();
-
-  for (XMLSize_t i = 0; i < sampleNodes->getLength(); i++)
-  {
-     DOMNode * sensorChild = sampleNodes->item(i);
-     if ( ((std::string)XMLStringConverter(sensorChild->getNodeName())).
-                        find("sample") == std::string::npos ) continue;
-
-     XDOMElement xnode((DOMElement *)sampleNodes->item(i));
-     const std::string& sSampleId = xnode.getAttributeValue("id");
-     // Here we must treat the sample id as does the SampleTag class
-     // i.e. treating 0 prefixed values as octal and 0x prefixed as hex
-     std::istringstream ist(sSampleId);
-     unsigned int val;
-     ist.unsetf(ios::dec);
-     ist >> val;
-     if (val == sampleId) {
-       sampleNode = sampleNodes->item(i);
-       break;
-     }
-  }
+
+  DOMNode * sampleNode =
+                 sensorItem->findSampleDOMNode(_sampleTag->getSampleId());
 
   _sampleDOMNode = sampleNode;
   return(sampleNode);
@@ -429,6 +381,14 @@ void VariableItem::fromDOM()
   return;
 }
 
+bool VariableItem::forgetCalibration(const std::string & calFileName)
+{
+  if (!CalibrationCache::isFileNamed(_calFile, calFileName)) return false;
+  _gotCalDate = _gotCalVals = false;
+  _calDate = _calVals = "";
+  return true;
+}
+
 QString VariableItem::getCalValues()
 {
   QString calString, noCalString;
@@ -436,40 +396,27 @@ QString VariableItem::getCalValues()
   if (_varConverter) {
      if (_calFile) {
         if (!_gotCalVals) {
-           nidas::util::UTime curTime, calTime;
-           nidas::core::Polynomial * poly =  new nidas::core::Polynomial();
-           try {
 std::cerr<<"VarItem: getting cals: from file: "<<_calFileName<<"\n";
-              poly->setCalFile(_calFile);
-              curTime = nidas::util::UTime();
-              curTime.format(true, "%Y%m%d:%H:%M:%S");
-              calTime = _calFile->search(curTime);
-              calTime.format(true, "%Y%m%d:%H:%M:%S");
-std::cerr<<"Varitem:";
-std::cerr<<name().toStdString();
-std::cerr<<" getting cals: curTime:"<<curTime.format(true, "%m/%d/%Y")<<"  calTime:"<<calTime.format(true, "%m/%d/%Y")<<"\n";
-              poly->readCalFile(calTime.toUsecs());
-              calString.append(QString::fromStdString(poly->toString()));
-              int lastQ = calString.lastIndexOf(QString::fromStdString("\""));
-              calString.insert(lastQ, QString::fromStdString(
-                                               _varConverter->getUnits()));
-              calString.remove("poly ");
-              _calVals = calString.toStdString();
-              _gotCalVals = true;
-              _calDate = calTime.format(true, "%m/%d/%Y");
-              _gotCalDate = true;
-           } catch (nidas::util::IOException &e) {
-              std::cerr<<__func__<<":ERROR: "<< e.toString()<<"\n";
-              _calVals = "ERROR: File is Missing";
-              _gotCalVals = true;
-              return QString::fromStdString(_calVals);
-           } catch (nidas::util::ParseException &e) {
-              std::cerr<<__func__<<":ERROR: "<< e.toString()<<"\n";
-              return QString("ERROR: Parse Failed");
+           CalibrationCache::CalInfo cal;
+           if (!model->getCalibration(_calFile, this, cal))
+             return NidasModel::CalLoadingText;
+           switch (cal.status) {
+             case CalibrationCache::CAL_OK:
+               _calVals = CalibrationCache::calValuesString(cal,
+                                                  _varConverter->getUnits());
+               _gotCalVals = true;
+               _calDate = cal.calDate;
+               _gotCalDate = true;
+               break;
+             case CalibrationCache::CAL_MISSING:
+               _calVals = "ERROR: File is Missing";
+               _gotCalVals = true;
+               break;
+             default:
+               return QString("ERROR: Parse Failed");
            }
-        } else {
-           calString = QString::fromStdString(_calVals);
         }
+        calString = QString::fromStdString(_calVals);
      } else {
         if (!_gotCalVals) {
 std::cerr<<"About to call calString.append on Varitem: "<<name().toStdString()<<"\n";
@@ -500,27 +447,22 @@ QString VariableItem::getCalDate()
   if (_varConverter) {
     if (_calFile) {
       if (!_gotCalDate) {
-         nidas::util::UTime curTime, calTime;
-         nidas::core::Polynomial * poly =  new nidas::core::Polynomial();
-         try {
-           poly->setCalFile(_calFile);
-           curTime = nidas::util::UTime();
-           curTime.format(true, "%Y%m%d:%H:%M:%S");
-           calTime = _calFile->search(curTime);
-           _calDate = calTime.format(true, "%m/%d/%Y");
-           _gotCalDate = true;
-           return QString::fromStdString(calTime.format(true, "%m/%d/%Y"));
-         } catch (nidas::util::IOException &e) {
-           std::cerr<<__func__<<":ERROR: "<< e.toString()<<"\n";
-           _calDate = "ERROR: File is Missing";
-           _gotCalDate = true;
-           return QString::fromStdString(_calDate);
-         } catch (nidas::util::ParseException &e) {
-           std::cerr<<__func__<<":ERROR: "<< e.toString()<<"\n";
-           return QString("ERROR: Parse Failed");
+         CalibrationCache::CalInfo cal;
+         if (!model->getCalibration(_calFile, this, cal))
+           return NidasModel::CalLoadingText;
+         switch (cal.status) {
+           case CalibrationCache::CAL_OK:
+             _calDate = cal.calDate;
+             break;
+           case CalibrationCache::CAL_MISSING:
+             _calDate = "ERROR: File is Missing";
+             break;
+           default:
+             return QString("ERROR: Parse Failed");
          }
-       } else
-          return QString::fromStdString(_calDate);
+         _gotCalDate = true;
+      }
+      return QString::fromStdString(_calDate);
     } else
       return QString();
   }
@@ -53,6 +53,8 @@ public:
 
     QString dataField(int column);
 
+    bool forgetCalibration(const std::string & calFileName);
+
     QString name();
     QString getLongName() 
             { return QString::fromStdString(_variable->getLongName()); }
@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+
+#include "ConfigMerge.h"
+#include "ConfigDiff.h"
+
+#include <xercesc/dom/DOMImplementation.hpp>
+#include <xercesc/dom/DOMImplementationLS.hpp>
+#include <xercesc/dom/DOMImplementationRegistry.hpp>
+#include <xercesc/dom/DOMLSParser.hpp>
+#include <xercesc/framework/MemBufInputSource.hpp>
+#include <xercesc/framework/Wrapper4InputSource.hpp>
+#include <xercesc/util/PlatformUtils.hpp>
+#include <xercesc/util/XMLUniDefs.hpp>
+
+#include <string>
+
+using namespace xercesc;
+
+class ConfigMergeTest : public ::testing::Test
+{
+protected:
+  static void SetUpTestCase() { XMLPlatformUtils::Initialize(); }
+  static void TearDownTestCase() { XMLPlatformUtils::Terminate(); }
+
+  void SetUp()
+  {
+    XMLCh ls[] = { chLatin_L, chLatin_S, chNull };
+    DOMImplementationLS *impl = (DOMImplementationLS *)
+      DOMImplementationRegistry::getDOMImplementation(ls);
+    _parser = impl->createLSParser(DOMImplementationLS::MODE_SYNCHRONOUS, 0);
+  }
+
+  void TearDown() { _parser->release(); }
+
+  // the parser owns the documents, released along with it
+  DOMDocument *parse(const std::string & xml)
+  {
+    MemBufInputSource *source = new MemBufInputSource(
+      (const XMLByte *) xml.data(), xml.size(), "test", false);
+    Wrapper4InputSource input(source);
+    return _parser->parse(&input);
+  }
+
+  static std::string dsmAttribute(DOMDocument *doc, const char *name)
+  {
+    static const XMLCh dsmTag[] = { chLatin_d, chLatin_s, chLatin_m, chNull };
+    DOMElement *dsm = (DOMElement *)
+      doc->getElementsByTagName(dsmTag)->item(0);
+    return dsm ? ConfigDiff::value(dsm, name) : std::string("(no dsm)");
+  }
+
+  DOMLSParser *_parser;
+};
+
+// Both sides add DSM 5, so there is no base DSM to merge against, and
+// only one of them gives it a location.
+TEST_F (ConfigMergeTest, AddedInBothWithAttributeOnOneSide)
+{
+  DOMDocument *base = parse(
+    "<project><site name=\"s\"></site></project>");
+  DOMDocument *ours = parse(
+    "<project><site name=\"s\"><dsm id=\"5\" location=\"nose\"/></site>"
+    "</project>");
+  DOMDocument *theirs = parse(
+    "<project><site name=\"s\"><dsm id=\"5\"/></site></project>");
+
+  ConfigMerge merge;
+  EXPECT_TRUE(merge.merge(base, ours, theirs).empty());
+  EXPECT_EQ("nose", dsmAttribute(ours, "location"));
+}
+
+TEST_F (ConfigMergeTest, AddedInBothWithDifferentValues)
+{
+  DOMDocument *base = parse(
+    "<project><site name=\"s\"></site></project>");
+  DOMDocument *ours = parse(
+    "<project><site name=\"s\"><dsm id=\"5\" location=\"nose\"/></site>"
+    "</project>");
+  DOMDocument *theirs = parse(
+    "<project><site name=\"s\"><dsm id=\"5\" location=\"tail\"/></site>"
+    "</project>");
+
+  ConfigMerge merge;
+  ASSERT_EQ(1u, merge.merge(base, ours, theirs).size());
+  EXPECT_EQ("location", merge.conflicts()[0].attribute);
+  EXPECT_EQ("added in both", merge.conflicts()[0].reason);
+  EXPECT_EQ("nose", dsmAttribute(ours, "location"));
+}
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+
+#include "IdAllocator.h"
+
+TEST (IdAllocatorTest, NextIsTheLowestFreeId)
+{
+  IdAllocator ids;
+  EXPECT_EQ(1u, ids.next(1, 99));
+  EXPECT_TRUE(ids.reserve(1));
+  EXPECT_TRUE(ids.reserve(2));
+  EXPECT_TRUE(ids.reserve(3));
+  EXPECT_FALSE(ids.reserve(2));
+  EXPECT_EQ(4u, ids.next(1, 99));
+
+  ids.release(2);
+  EXPECT_FALSE(ids.isUsed(2));
+  EXPECT_EQ(2u, ids.next(1, 99));
+}
+
+TEST (IdAllocatorTest, WordBoundaries)
+{
+  IdAllocator ids;
+  for (unsigned int i = 0; i < 64; i++) ids.reserve(i);
+  EXPECT_EQ(64u, ids.next(0, 1000));
+
+  for (unsigned int i = 64; i < 128; i++) ids.reserve(i);
+  EXPECT_EQ(128u, ids.next(0, 1000));
+  EXPECT_EQ(128u, ids.next(100, 1000));
+
+  ids.release(63);
+  EXPECT_EQ(63u, ids.next(0, 1000));
+  EXPECT_EQ(128u, ids.next(64, 1000));
+
+  ids.release(64);
+  EXPECT_EQ(64u, ids.next(64, 1000));
+}
+
+TEST (IdAllocatorTest, NextStopsAtEnd)
+{
+  IdAllocator ids;
+  for (unsigned int i = 0; i < 10; i++) ids.reserve(i);
+  // 10 is free, but not below the end
+  EXPECT_EQ(10u, ids.next(0, 10));
+  EXPECT_EQ(10u, ids.next(0, 11));
+  EXPECT_EQ(5u, ids.next(5, 5));
+}
+
+// Document::insertA2DVariable() hands out sample ids 1 to 98 and reports
+// the sensor full when next() gives 99.
+TEST (IdAllocatorTest, SampleIdsRunOut)
+{
+  IdAllocator ids;
+  for (unsigned int i = 1; i < 99; i++) EXPECT_TRUE(ids.reserve(i));
+  EXPECT_EQ(99u, ids.next(1, 99));
+
+  ids.release(50);
+  EXPECT_EQ(50u, ids.next(1, 99));
+  ids.reserve(50);
+  EXPECT_EQ(99u, ids.next(1, 99));
+}
+
+TEST (IdAllocatorTest, StrideBlocks)
+{
+  IdAllocator ids(200);
+  EXPECT_EQ(200u, ids.next(200, 65536));
+  EXPECT_EQ(200u, ids.next(1, 65536));     // rounded up to a block
+
+  ids.reserve(200);
+  EXPECT_EQ(0u, ids.next(0, 65536));
+  EXPECT_EQ(400u, ids.next(200, 65536));
+
+  // any id in a block makes it used
+  ids.reserve(405);
+  EXPECT_EQ(600u, ids.next(200, 65536));
+  ids.release(405);
+  EXPECT_EQ(400u, ids.next(200, 65536));
+
+  ids.release(200);
+  EXPECT_EQ(200u, ids.next(200, 65536));
+}
+
+TEST (IdAllocatorTest, StrideWithEndNotAMultiple)
+{
+  IdAllocator ids(200);
+  for (unsigned int i = 0; i < 1000; i += 200) ids.reserve(i);
+  EXPECT_EQ(1000u, ids.next(0, 1000));
+  EXPECT_EQ(1000u, ids.next(0, 1001));
+  EXPECT_EQ(1000u, ids.next(0, 1050));
+  EXPECT_EQ(1050u, ids.next(1001, 1050));
+}
+
+TEST (IdAllocatorTest, ReleaseOfUnusedIdsIsIgnored)
+{
+  IdAllocator ids(200);
+  ids.release(5);                   // nothing there at all
+  EXPECT_EQ(0u, ids.next(0, 65536));
+
+  ids.reserve(5);
+  ids.reserve(6);
+  ids.release(5);
+  ids.release(5);                   // mustn't empty the block twice
+  EXPECT_TRUE(ids.isUsed(6));
+  EXPECT_EQ(200u, ids.next(0, 65536));
+
+  ids.release(6);
+  EXPECT_EQ(0u, ids.next(0, 65536));
+}
+
+TEST (IdAllocatorTest, ClearFreesEverything)
+{
+  IdAllocator ids(200);
+  ids.reserve(0);
+  ids.reserve(200);
+  ids.clear();
+  EXPECT_FALSE(ids.isUsed(0));
+  EXPECT_EQ(0u, ids.next(0, 65536));
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+
+#include "SessionSnapshot.h"
+#include "CalFileCatalog.h"
+
+#include <xercesc/dom/DOMElement.hpp>
+#include <xercesc/dom/DOMImplementation.hpp>
+#include <xercesc/dom/DOMImplementationLS.hpp>
+#include <xercesc/dom/DOMImplementationRegistry.hpp>
+#include <xercesc/dom/DOMLSParser.hpp>
+#include <xercesc/util/PlatformUtils.hpp>
+#include <xercesc/util/XMLString.hpp>
+#include <xercesc/util/XMLUniDefs.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+using namespace xercesc;
+
+class SessionSnapshotTest : public ::testing::Test
+{
+protected:
+  static void SetUpTestCase() { XMLPlatformUtils::Initialize(); }
+  static void TearDownTestCase() { XMLPlatformUtils::Terminate(); }
+
+  void SetUp()
+  {
+    unsetenv("CONFEDIT_NO_SNAPSHOT");
+    char tmpl[] = "/tmp/snapshot_test.XXXXXX";
+    ASSERT_TRUE(mkdtemp(tmpl) != 0);
+    _dir = tmpl;
+    _file = _dir + "/config.xml";
+
+    XMLCh ls[] = { chLatin_L, chLatin_S, chNull };
+    DOMImplementationLS *impl = (DOMImplementationLS *)
+      DOMImplementationRegistry::getDOMImplementation(ls);
+    _parser = impl->createLSParser(DOMImplementationLS::MODE_SYNCHRONOUS, 0);
+  }
+
+  void TearDown()
+  {
+    _parser->release();
+    unlink(_file.c_str());
+    unlink((_dir + "/.confedit/config.xml.snapshot").c_str());
+    rmdir((_dir + "/.confedit").c_str());
+    rmdir(_dir.c_str());
+  }
+
+  // the parser owns the document, released along with it
+  DOMDocument *parseFile(const std::string & xml)
+  {
+    std::ofstream out(_file.c_str());
+    out << xml;
+    out.close();
+    XMLCh *uri = XMLString::transcode(_file.c_str());
+    DOMDocument *doc = _parser->parseURI(uri);
+    XMLString::release(&uri);
+    return doc;
+  }
+
+  std::string _dir;
+  std::string _file;
+  DOMLSParser *_parser;
+};
+
+TEST_F (SessionSnapshotTest, ReopenGivesTheParsedDocument)
+{
+  DOMDocument *parsed = parseFile(
+    "<?xml version=\"1.0\"?>\n"
+    "<!-- a comment -->\n"
+    "<project name=\"p\">\n"
+    "  <site name=\"s\">\n"
+    "    <dsm id=\"5\" location=\"nose\"><![CDATA[x < y]]></dsm>\n"
+    "  </site>\n"
+    "</project>\n");
+  ASSERT_TRUE(parsed != 0);
+
+  SessionSnapshot(_file).save(parsed, CalFileCatalog());
+
+  SessionSnapshot snapshot(_file);
+  ASSERT_TRUE(snapshot.load());
+  DOMDocument *restored = snapshot.takeDocument();
+  EXPECT_TRUE(restored->getDocumentElement()->isEqualNode(
+                parsed->getDocumentElement()));
+  restored->release();
+}
+
+// Defaults would come back as specified attributes, or not at all, so
+// such a configuration must be parsed every time.
+TEST_F (SessionSnapshotTest, DefaultAttributesAreNotSnapshotted)
+{
+  DOMDocument *parsed = parseFile(
+    "<?xml version=\"1.0\"?>\n"
+    "<!DOCTYPE project [\n"
+    "  <!ATTLIST dsm rate CDATA \"1\">\n"
+    "]>\n"
+    "<project><site name=\"s\"><dsm id=\"5\"/></site></project>\n");
+  ASSERT_TRUE(parsed != 0);
+
+  SessionSnapshot(_file).save(parsed, CalFileCatalog());
+
+  SessionSnapshot snapshot(_file);
+  EXPECT_FALSE(snapshot.load());
+}
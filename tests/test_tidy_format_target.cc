@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+
+#include "TidyFileFormatTarget.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+// Expected output is what the sed passes TidyFileFormatTarget replaced
+//   sed '/^ *$/d' | sed 's/^ *<\!/<\!/' | sed '/^ *<\!/{x;p;x;}'
+// gave for the same input.
+class TidyFileFormatTargetTest : public ::testing::Test
+{
+protected:
+  void SetUp()
+  {
+    char tmpl[] = "/tmp/tidy_test.XXXXXX";
+    ASSERT_TRUE(mkdtemp(tmpl) != 0);
+    _dir = tmpl;
+    _file = _dir + "/config.xml";
+  }
+
+  void TearDown()
+  {
+    unlink(_file.c_str());
+    rmdir(_dir.c_str());
+  }
+
+  // Feed \a xml through in pieces of \a chunk bytes, as the serializer
+  // does, and return what commit() wrote.
+  std::string tidy(const std::string & xml, size_t chunk)
+  {
+    TidyFileFormatTarget target(_file);
+    for (size_t i = 0; i < xml.size(); i += chunk) {
+      std::string piece = xml.substr(i, chunk);
+      target.writeChars((const XMLByte *) piece.data(), piece.size(), 0);
+    }
+    EXPECT_TRUE(target.commit());
+
+    std::ifstream in(_file.c_str());
+    std::ostringstream out;
+    out << in.rdbuf();
+    return out.str();
+  }
+
+  std::string _dir;
+  std::string _file;
+};
+
+TEST_F (TidyFileFormatTargetTest, MatchesSedLayout)
+{
+  const std::string xml =
+    "<?xml version=\"1.0\"?>\n"
+    "<!-- top -->\n"
+    "<project name=\"p\">\n"
+    "\n"
+    "   \n"
+    "  <site name=\"s\">\n"
+    "    <!-- dsm 5 -->\n"
+    "    <dsm id=\"5\"/>\n"
+    "  \t\n"
+    "    <!--\n"
+    "      a long comment\n"
+    "    -->\n"
+    "  </site>\n"
+    "  </project>";
+  const std::string expected =
+    "<?xml version=\"1.0\"?>\n"
+    "\n"
+    "<!-- top -->\n"
+    "<project name=\"p\">\n"
+    "  <site name=\"s\">\n"
+    "\n"
+    "<!-- dsm 5 -->\n"
+    "    <dsm id=\"5\"/>\n"
+    "  \t\n"
+    "\n"
+    "<!--\n"
+    "      a long comment\n"
+    "    -->\n"
+    "  </site>\n"
+    "  </project>";
+
+  EXPECT_EQ(expected, tidy(xml, xml.size()));
+  EXPECT_EQ(expected, tidy(xml, 7));
+  EXPECT_EQ(expected, tidy(xml, 1));
+}
+
+TEST_F (TidyFileFormatTargetTest, LastLineWithoutNewline)
+{
+  EXPECT_EQ("<project>\n\n<!-- last -->",
+            tidy("<project>\n  <!-- last -->", 5));
+  EXPECT_EQ("<project/>\n", tidy("<project/>\n   ", 5));
+}